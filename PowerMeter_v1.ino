@@ -8,7 +8,19 @@
 // 虚拟功率计配置
 powermeter_config PWRconfig = 
 {
-  250  // profileUpdateCycle - ANT+数据发送间隔(ms)
+  NULL,           // p_power_profile - 由PowerMeter内部创建；ANT+数据在每次EVENT_TX时发送最新样本
+  PWR_PERIOD_4HZ, // periodMode - ANT+广播频率，可用串口命令 "period 8|4|2" 运行时切换
+  1,              // meterCount - 同时桥接的功率计数量，>1为网关模式 (每台一个ANT+通道)
+  0,              // baseDeviceNumber - 0使用默认设备号，第i路为 baseDeviceNumber + i
+  NULL,           // allowlist - 已知喜德盛地址 (如 {"AA:BB:CC:DD:EE:FF"})，NULL则接受任何带Mesh Proxy服务的设备
+  0,              // allowlistCount - allowlist条目数
+  CONN_POLICY_LOW_LATENCY, // connPolicy - BLE连接参数：最短间隔、从机延迟0，"conn power" 切换为低功耗
+  0,              // powerSmoothing - ANT+瞬时功率：0原始值，3/10为滚动平均秒数 ("smooth" 命令)
+  false,          // recordSession - 启动即记录BLE/ANT+帧到内部闪存 (/rec)，也可用 "rec on|off" 切换
+  NULL,           // workout - 未连接时的虚拟训练步骤表 (workout_step_t)，NULL使用默认的热身/间歇/冲刺/放松
+  0,              // workoutStepCount - workout条目数
+  1,              // workoutSeed - 虚拟训练随机种子，相同种子产生相同的功率/踏频序列 ("workout" 命令)
+  CRANK_PIN_NONE  // hallPin - 曲柄霍尔传感器引脚 (磁铁经过时拉低)，设置后ANT+发送实测踏频
 };
 
 PowerMeter power(&PWRconfig);
@@ -30,7 +42,7 @@ void setup(void)
   
   newmessage = millis() + 1000;
   Serial.println("PowerMeter setup is finished!");
-  Serial.println("Will use BLE data if connected, otherwise virtual data (~100W, ~70RPM)...");
+  Serial.println("Will use BLE data if connected, otherwise a virtual workout (reference 100W, 70RPM)...");
 }
 
 void loop(void)
@@ -38,50 +50,7 @@ void loop(void)
   // 更新虚拟功率计数据
   power.update();
   
-  // 简单的串口命令处理（可选）
-  if (Serial.available()) {
-    String command = Serial.readStringUntil('\n');
-    command.trim();
-    
-    if (command.startsWith("power:")) {
-      int newPower = command.substring(6).toInt();
-      if (newPower > 0 && newPower < 1000) {
-        Serial.printf("Base power changed to: %dW\n", newPower);
-        // 这里可以添加修改基础功率的功能
-      }
-    }
-    else if (command.startsWith("cadence:")) {
-      int newCadence = command.substring(8).toInt();
-      if (newCadence > 0 && newCadence < 200) {
-        Serial.printf("Base cadence changed to: %dRPM\n", newCadence);
-        // 这里可以添加修改基础踏频的功能
-      }
-    }
-    else if (command == "status") {
-      Serial.println("PowerMeter Status:");
-      Serial.println("- ANT+ broadcasting active");
-      if (power.getConnectionStatus()) {
-        Serial.println("- Connected to BLE power meter");
-        Serial.println("- Using real power/cadence data");
-      } else {
-        Serial.println("- Not connected to BLE power meter");
-        Serial.println("- Generating virtual power around 100W");
-        Serial.println("- Generating virtual cadence around 70RPM");
-      }
-    }
-    else if (command == "scan") {
-      Serial.println("Starting BLE scan...");
-      power.startScanning();
-    }
-    else if (command == "help") {
-      Serial.println("Available commands:");
-      Serial.println("- status: Show current status");
-      Serial.println("- scan: Start BLE scanning");
-      Serial.println("- power:XXX: Set base power (when not connected)");
-      Serial.println("- cadence:XXX: Set base cadence (when not connected)");
-      Serial.println("- help: Show this help");
-    }
-  }
+  // 串口命令由power.update()统一处理 (输入 help 查看命令列表)
   
   // 小延时避免过度占用CPU
   delay(10);
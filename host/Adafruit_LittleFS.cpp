@@ -0,0 +1,227 @@
+#include "InternalFileSystem.h"
+
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace Adafruit_LittleFS_Namespace;
+
+InternalFileSystem InternalFS;
+
+File::File(Adafruit_LittleFS& fs) : _fs(&fs), _fp(NULL), _dir(NULL)
+{
+   _path[0] = '\0';
+   _name[0] = '\0';
+}
+
+File::File(char const* filename, uint8_t mode, Adafruit_LittleFS& fs) : _fs(&fs), _fp(NULL), _dir(NULL)
+{
+   _path[0] = '\0';
+   _name[0] = '\0';
+   open(filename, mode);
+}
+
+bool File::open(char const* filename, uint8_t mode)
+{
+   close();
+   char path[256];
+   _fs->hostPath(path, sizeof(path), filename);
+   struct stat st;
+   if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+   {
+      _dir = opendir(path);
+   }
+   else
+   {
+      _fp = fopen(path, mode == FILE_O_WRITE ? "a+b" : "rb");
+   }
+   if (!_fp && !_dir) return false;
+
+   snprintf(_path, sizeof(_path), "%s", filename);
+   const char* slash = strrchr(filename, '/');
+   snprintf(_name, sizeof(_name), "%s", slash ? slash + 1 : filename);
+   return true;
+}
+
+size_t File::write(uint8_t ch)
+{
+   return write(&ch, 1);
+}
+
+size_t File::write(uint8_t const* buf, size_t size)
+{
+   if (!_fp) return 0;
+   fflush(_fp);                            // so the capacity check sees this file's size
+   uint32_t room = _fs->hostFreeBytes();
+   return fwrite(buf, 1, size < room ? size : room, _fp);
+}
+
+int File::read(void)
+{
+   uint8_t ch;
+   return read(&ch, 1) == 1 ? ch : -1;
+}
+
+int File::read(void* buf, uint16_t nbyte)
+{
+   return _fp ? (int)fread(buf, 1, nbyte, _fp) : -1;
+}
+
+int File::available(void)
+{
+   return _fp ? (int)(size() - position()) : 0;
+}
+
+void File::flush(void)
+{
+   if (_fp) fflush(_fp);
+}
+
+bool File::seek(uint32_t pos)
+{
+   return _fp && fseek(_fp, (long)pos, SEEK_SET) == 0;
+}
+
+uint32_t File::position(void)
+{
+   return _fp ? (uint32_t)ftell(_fp) : 0;
+}
+
+uint32_t File::size(void)
+{
+   if (!_fp) return 0;
+   fflush(_fp);
+   struct stat st;
+   return fstat(fileno(_fp), &st) == 0 ? (uint32_t)st.st_size : 0;
+}
+
+void File::close(void)
+{
+   if (_fp) fclose(_fp);
+   if (_dir) closedir((DIR*)_dir);
+   _fp = NULL;
+   _dir = NULL;
+}
+
+File::operator bool(void)
+{
+   return _fp != NULL || _dir != NULL;
+}
+
+char const* File::name(void)
+{
+   return _name;
+}
+
+bool File::isDirectory(void)
+{
+   return _dir != NULL;
+}
+
+File File::openNextFile(uint8_t mode)
+{
+   File next(*_fs);
+   if (!_dir) return next;
+   struct dirent* entry;
+   while ((entry = readdir((DIR*)_dir)) != NULL)
+   {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+      char path[sizeof(_path) + sizeof(entry->d_name) + 1];
+      snprintf(path, sizeof(path), "%s/%s", _path, entry->d_name);
+      next.open(path, mode);
+      break;
+   }
+   return next;
+}
+
+Adafruit_LittleFS::Adafruit_LittleFS() : _capacity(0)
+{
+   setHostRoot("build/fs");
+}
+
+static uint64_t DirectoryBytes(const char* path)
+{
+   uint64_t total = 0;
+   DIR* dir = opendir(path);
+   if (!dir) return 0;
+   struct dirent* entry;
+   while ((entry = readdir(dir)) != NULL)
+   {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+      char child[512];
+      snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+      struct stat st;
+      if (stat(child, &st) != 0) continue;
+      total += S_ISDIR(st.st_mode) ? DirectoryBytes(child) : (uint64_t)st.st_size;
+   }
+   closedir(dir);
+   return total;
+}
+
+uint32_t Adafruit_LittleFS::hostFreeBytes(void)
+{
+   if (_capacity == 0) return UINT32_MAX;
+   uint64_t used = DirectoryBytes(_root);
+   return used < _capacity ? (uint32_t)(_capacity - used) : 0;
+}
+
+void Adafruit_LittleFS::setHostRoot(const char* dir)
+{
+   snprintf(_root, sizeof(_root), "%s", dir);
+}
+
+void Adafruit_LittleFS::hostPath(char* buf, size_t size, char const* filepath)
+{
+   snprintf(buf, size, "%s%s%s", _root, filepath[0] == '/' ? "" : "/", filepath);
+}
+
+bool Adafruit_LittleFS::begin(void)
+{
+   // Creates the root and its parents, as formatting a blank flash would.
+   char path[sizeof(_root)];
+   snprintf(path, sizeof(path), "%s", _root);
+   for (char* p = path + 1; *p; p++)
+   {
+      if (*p != '/') continue;
+      *p = '\0';
+      ::mkdir(path, 0755);
+      *p = '/';
+   }
+   return ::mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+File Adafruit_LittleFS::open(char const* filepath, uint8_t mode)
+{
+   return File(filepath, mode, *this);
+}
+
+bool Adafruit_LittleFS::exists(char const* filepath)
+{
+   char path[sizeof(_root) + 64];
+   hostPath(path, sizeof(path), filepath);
+   struct stat st;
+   return stat(path, &st) == 0;
+}
+
+bool Adafruit_LittleFS::mkdir(char const* filepath)
+{
+   char path[sizeof(_root) + 64];
+   hostPath(path, sizeof(path), filepath);
+   return ::mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+bool Adafruit_LittleFS::remove(char const* filepath)
+{
+   char path[sizeof(_root) + 64];
+   hostPath(path, sizeof(path), filepath);
+   return ::unlink(path) == 0;
+}
+
+bool Adafruit_LittleFS::rmdir(char const* filepath)
+{
+   char path[sizeof(_root) + 64];
+   hostPath(path, sizeof(path), filepath);
+   return ::rmdir(path) == 0;
+}
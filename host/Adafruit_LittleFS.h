@@ -0,0 +1,82 @@
+/*
+ Host stand-in for the Adafruit LittleFS library. Paths map onto a
+ directory of the host file system (build/fs unless setHostRoot() is
+ called), so recordings survive the run and can be inspected. With a
+ capacity set, writes past it come back short as LFS_ERR_NOSPC would.
+*/
+#ifndef HOST_ADAFRUIT_LITTLEFS_H
+#define HOST_ADAFRUIT_LITTLEFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+class Adafruit_LittleFS;
+
+namespace Adafruit_LittleFS_Namespace
+{
+   enum
+   {
+      FILE_O_READ = 0,
+      FILE_O_WRITE = 1,    // Created if missing, writes append.
+   };
+
+   // Copyable handle; like the library, it is closed only by close().
+   class File
+   {
+   public:
+      explicit File(Adafruit_LittleFS& fs);
+      File(char const* filename, uint8_t mode, Adafruit_LittleFS& fs);
+
+      bool open(char const* filename, uint8_t mode);
+      size_t write(uint8_t ch);
+      size_t write(uint8_t const* buf, size_t size);
+      int read(void);
+      int read(void* buf, uint16_t nbyte);
+      int available(void);
+      void flush(void);
+      bool seek(uint32_t pos);
+      uint32_t position(void);
+      uint32_t size(void);
+      void close(void);
+      operator bool(void);
+
+      char const* name(void);
+      bool isDirectory(void);
+      File openNextFile(uint8_t mode = FILE_O_READ);
+
+   private:
+      Adafruit_LittleFS* _fs;
+      FILE* _fp;
+      void* _dir;
+      char _path[128];
+      char _name[64];
+   };
+}
+
+class Adafruit_LittleFS
+{
+public:
+   Adafruit_LittleFS();
+
+   bool begin(void);
+   Adafruit_LittleFS_Namespace::File open(char const* filepath, uint8_t mode = Adafruit_LittleFS_Namespace::FILE_O_READ);
+   bool exists(char const* filepath);
+   bool mkdir(char const* filepath);
+   bool remove(char const* filepath);
+   bool rmdir(char const* filepath);
+
+   // Host only: directory that stands for the flash root.
+   void setHostRoot(const char* dir);
+   void hostPath(char* buf, size_t size, char const* filepath);
+   // Host only: bytes the files under the root may hold, 0 for no limit.
+   // Only file contents count, not LittleFS metadata.
+   void setHostCapacity(uint32_t bytes) { _capacity = bytes; }
+   uint32_t hostFreeBytes(void);
+
+private:
+   char _root[128];
+   uint32_t _capacity;
+};
+
+#endif
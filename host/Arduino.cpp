@@ -0,0 +1,79 @@
+#include <Arduino.h>
+#include <ctype.h>
+
+HostSerial Serial;
+
+void String::trim(void)
+{
+  size_t b = 0, e = m_str.size();
+  while (b < e && isspace((unsigned char)m_str[b])) b++;
+  while (e > b && isspace((unsigned char)m_str[e - 1])) e--;
+  m_str = m_str.substr(b, e - b);
+}
+
+void String::toLowerCase(void)
+{
+  for (size_t i = 0; i < m_str.size(); i++) m_str[i] = (char)tolower((unsigned char)m_str[i]);
+}
+
+size_t HostSerial::print(const char* s)
+{
+  if (!m_out) return 0;
+  return (size_t)fputs(s, m_out) >= 0 ? strlen(s) : 0;
+}
+
+size_t HostSerial::printf(const char* format, ...)
+{
+  if (!m_out) return 0;
+  va_list ap;
+  va_start(ap, format);
+  int n = vfprintf(m_out, format, ap);
+  va_end(ap);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+size_t HostSerial::printBufferReverse(uint8_t const* buffer, int size, char delim)
+{
+  size_t n = 0;
+  for (int i = size - 1; i >= 0; i--)
+  {
+    n += printf("%02X", buffer[i]);
+    if (i != 0 && delim) n += printf("%c", delim);
+  }
+  return n;
+}
+
+int HostSerial::available(void) { return (int)m_input.size(); }
+
+int HostSerial::read(void)
+{
+  if (m_input.empty()) return -1;
+  int c = (unsigned char)m_input[0];
+  m_input.erase(0, 1);
+  return c;
+}
+
+String HostSerial::readStringUntil(char terminator)
+{
+  size_t pos = m_input.find(terminator);
+  std::string line = m_input.substr(0, pos);
+  m_input.erase(0, pos == std::string::npos ? std::string::npos : pos + 1);
+  return String(line);
+}
+
+void HostSerial::feed(const char* text) { m_input += text; }
+
+static uint32_t s_random_state = 1;
+
+long random(long howbig)
+{
+  if (howbig <= 0) return 0;
+  s_random_state = s_random_state * 1103515245u + 12345u;
+  return (long)((s_random_state >> 8) % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig) return howsmall;
+  return howsmall + random(howbig - howsmall);
+}
@@ -0,0 +1,94 @@
+/*
+ Host stand-in for the Arduino core used by the nRF52 build.
+ Only the subset touched by the bridge sources is provided.
+*/
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+
+#include "FreeRTOS.h"
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+// The core declares these as uint32_t, which is unsigned long on ARM; use the
+// same type here so printf format checking agrees with the target build.
+// Values still wrap at 32 bits.
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(uint32_t ms);
+void yield(void);
+long random(long howsmall, long howbig);
+long random(long howbig);
+
+// GPIO: only inputs with edge interrupts, driven by HostSim::gpioFallingEdge().
+#define INPUT           0
+#define INPUT_PULLUP    2
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+void pinMode(uint32_t pin, uint32_t mode);
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode);
+void detachInterrupt(uint32_t pin);
+
+class String
+{
+public:
+  String(const char* s = "") : m_str(s ? s : "") {}
+  String(const std::string& s) : m_str(s) {}
+
+  unsigned int length(void) const { return (unsigned int)m_str.size(); }
+  const char* c_str(void) const { return m_str.c_str(); }
+  void trim(void);
+  void toLowerCase(void);
+  bool startsWith(const char* prefix) const { return m_str.compare(0, strlen(prefix), prefix) == 0; }
+  String substring(unsigned int from) const { return from < m_str.size() ? String(m_str.substr(from)) : String(); }
+  long toInt(void) const { return atol(m_str.c_str()); }
+  bool operator==(const char* s) const { return m_str == s; }
+
+private:
+  std::string m_str;
+};
+
+class HostSerial
+{
+public:
+  void begin(uint32_t baud) { (void)baud; }
+  void flush(void) { fflush(m_out); }
+
+  size_t print(const char* s);
+  size_t print(const __FlashStringHelper* s) { return print(reinterpret_cast<const char*>(s)); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned int v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t println(void) { return print("\n"); }
+  template <typename T> size_t println(T v) { size_t n = print(v); return n + print("\n"); }
+  size_t write(uint8_t c) { return m_out && fputc(c, m_out) != EOF ? 1 : 0; }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  size_t printBufferReverse(uint8_t const* buffer, int size, char delim = ' ');
+
+  // Console input injected by the host harness.
+  int available(void);
+  int read(void);
+  String readStringUntil(char terminator);
+  void feed(const char* text);
+
+  // Redirect or silence (out == NULL) the console output.
+  void setOutput(FILE* out) { m_out = out; }
+
+private:
+  FILE* m_out = stdout;
+  std::string m_input;
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ Host stand-in for the FreeRTOS API that the Adafruit nRF52 core exposes
+ through Arduino.h. Tasks are never started on the host.
+*/
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+typedef void* SemaphoreHandle_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+typedef long BaseType_t;
+
+#define pdTRUE            ((BaseType_t)1)
+#define pdFALSE           ((BaseType_t)0)
+#define pdPASS            pdTRUE
+#define portMAX_DELAY     ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1024
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define TASK_PRIO_LOWEST  0
+#define TASK_PRIO_LOW     1
+#define TASK_PRIO_NORMAL  2
+#define TASK_PRIO_HIGH    3
+
+#define taskENTER_CRITICAL()  do {} while (0)
+#define taskEXIT_CRITICAL()   do {} while (0)
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack, void* arg, uint32_t prio, TaskHandle_t* handle);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TickType_t xTaskGetTickCountFromISR(void);
+void* rtos_malloc(size_t size);
+
+#endif
@@ -0,0 +1,437 @@
+#include "HostSim.h"
+
+#include <deque>
+#include <map>
+#include <string.h>
+
+#include <bluefruit.h>
+#include "ant_interface.h"
+#include "../src/sdant.h"
+
+namespace
+{
+   const uint8_t HOST_ANT_MAX_CHANNELS = 8;
+
+   struct AntChannel
+   {
+      bool     assigned;
+      bool     open;
+      bool     master;
+      uint16_t period;
+      uint64_t next_tx_us;
+   };
+
+   struct AntEvent
+   {
+      uint8_t     channel;
+      uint8_t     event;
+      ANT_MESSAGE message;
+   };
+
+   uint64_t s_now_us = 0;
+
+   AntChannel s_channels[HOST_ANT_MAX_CHANNELS];
+   std::deque<AntEvent> s_events;
+   std::vector<HostSim::AntFrame> s_frames;
+   void (*s_frame_sink)(const HostSim::AntFrame& frame) = NULL;
+
+   std::vector<BLEClientCharacteristic*> s_chars;
+   BLEClientService* s_last_service = NULL;
+   uint16_t s_next_conn_handle = 0;
+   uint16_t s_last_conn_handle = BLE_CONN_HANDLE_INVALID;
+   bool s_connect_pending = false;
+
+   const uint8_t HOST_GPIO_PINS = 48;
+   void (*s_gpio_handlers[HOST_GPIO_PINS])(void) = { NULL };
+   uint8_t s_gpio_modes[HOST_GPIO_PINS];
+   std::multimap<uint64_t, uint8_t> s_gpio_edges;     // time_us -> pin
+
+   uint64_t PeriodToMicros(uint16_t period)
+   {
+      return ((uint64_t)period * 1000000ULL) / 32768ULL;
+   }
+}
+
+/*------------------------------------------------------------------*/
+/* Virtual clock
+ *------------------------------------------------------------------*/
+uint64_t HostSim::nowMicros(void) { return s_now_us; }
+void HostSim::setMicros(uint64_t us) { s_now_us = us; }
+void HostSim::advanceMicros(uint64_t us) { s_now_us += us; }
+
+unsigned long millis(void) { return (uint32_t)(s_now_us / 1000); }
+unsigned long micros(void) { return (uint32_t)s_now_us; }
+static void GpioDispatch(void);
+
+// Edge interrupts still fire while the caller sleeps, at their own time.
+void delay(uint32_t ms)
+{
+   uint64_t end_us = s_now_us + (uint64_t)ms * 1000;
+   while (!s_gpio_edges.empty() && s_gpio_edges.begin()->first <= end_us)
+   {
+      if (s_gpio_edges.begin()->first > s_now_us) s_now_us = s_gpio_edges.begin()->first;
+      GpioDispatch();
+   }
+   s_now_us = end_us;
+}
+void yield(void) {}
+
+/*------------------------------------------------------------------*/
+/* FreeRTOS
+ *------------------------------------------------------------------*/
+static uint8_t s_semaphore;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return &s_semaphore; }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) { (void)sem; (void)ticks; return pdTRUE; }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) { (void)sem; return pdTRUE; }
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack, void* arg, uint32_t prio, TaskHandle_t* handle)
+{
+   // Tasks are not started on the host: HostSim drives their work directly.
+   (void)fn; (void)name; (void)stack; (void)arg; (void)prio;
+   if (handle) *handle = NULL;
+   return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) { s_now_us += ((uint64_t)ticks * 1000000ULL) / configTICK_RATE_HZ; }
+TickType_t xTaskGetTickCount(void) { return (TickType_t)((s_now_us * configTICK_RATE_HZ) / 1000000ULL); }
+TickType_t xTaskGetTickCountFromISR(void) { return xTaskGetTickCount(); }
+void* rtos_malloc(size_t size) { return malloc(size); }
+
+/*------------------------------------------------------------------*/
+/* SoftDevice ANT API
+ *------------------------------------------------------------------*/
+uint32_t sd_softdevice_is_enabled(uint8_t* p_softdevice_enabled)
+{
+   *p_softdevice_enabled = 1;
+   return NRF_SUCCESS;
+}
+
+uint32_t sd_ant_enable(ANT_ENABLE* const pstANTEnableConfig)
+{
+   if (pstANTEnableConfig->ucTotalNumberOfChannels > HOST_ANT_MAX_CHANNELS) return NRF_ERROR_INVALID_PARAM;
+   memset(s_channels, 0, sizeof(s_channels));
+   return NRF_SUCCESS;
+}
+
+uint32_t sd_ant_network_address_set(uint8_t ucNetwork, uint8_t const* pucNetworkKey)
+{
+   (void)ucNetwork; (void)pucNetworkKey;
+   return NRF_SUCCESS;
+}
+
+uint32_t sd_ant_channel_assign(uint8_t ucChannel, uint8_t ucChannelType, uint8_t ucNetwork, uint8_t ucExtAssign)
+{
+   (void)ucNetwork; (void)ucExtAssign;
+   if (ucChannel >= HOST_ANT_MAX_CHANNELS) return NRF_ERROR_INVALID_PARAM;
+   s_channels[ucChannel].assigned = true;
+   s_channels[ucChannel].master = (ucChannelType == CHANNEL_TYPE_MASTER);
+   return NRF_SUCCESS;
+}
+
+uint32_t sd_ant_channel_id_set(uint8_t ucChannel, uint16_t usDeviceNumber, uint8_t ucDeviceType, uint8_t ucTransmitType)
+{
+   (void)usDeviceNumber; (void)ucDeviceType; (void)ucTransmitType;
+   return ucChannel < HOST_ANT_MAX_CHANNELS ? NRF_SUCCESS : NRF_ERROR_INVALID_PARAM;
+}
+
+uint32_t sd_ant_channel_radio_freq_set(uint8_t ucChannel, uint8_t ucRFFreq)
+{
+   (void)ucRFFreq;
+   return ucChannel < HOST_ANT_MAX_CHANNELS ? NRF_SUCCESS : NRF_ERROR_INVALID_PARAM;
+}
+
+uint32_t sd_ant_channel_period_set(uint8_t ucChannel, uint16_t usPeriod)
+{
+   if (ucChannel >= HOST_ANT_MAX_CHANNELS) return NRF_ERROR_INVALID_PARAM;
+   s_channels[ucChannel].period = usPeriod;
+   return NRF_SUCCESS;
+}
+
+uint32_t sd_ant_channel_open(uint8_t ucChannel)
+{
+   if (ucChannel >= HOST_ANT_MAX_CHANNELS || !s_channels[ucChannel].assigned) return CHANNEL_IN_WRONG_STATE;
+   if (s_channels[ucChannel].open) return CHANNEL_IN_WRONG_STATE;
+   s_channels[ucChannel].open = true;
+   s_channels[ucChannel].next_tx_us = s_now_us + PeriodToMicros(s_channels[ucChannel].period);
+   return NRF_SUCCESS;
+}
+
+uint32_t sd_ant_channel_close(uint8_t ucChannel)
+{
+   if (ucChannel >= HOST_ANT_MAX_CHANNELS || !s_channels[ucChannel].open) return CHANNEL_IN_WRONG_STATE;
+   s_channels[ucChannel].open = false;
+   HostSim::antInjectEvent(ucChannel, EVENT_CHANNEL_CLOSED);
+   return NRF_SUCCESS;
+}
+
+uint32_t sd_ant_broadcast_message_tx(uint8_t ucChannel, uint8_t ucSize, uint8_t* aucMesg)
+{
+   if (ucChannel >= HOST_ANT_MAX_CHANNELS || !s_channels[ucChannel].assigned) return CHANNEL_IN_WRONG_STATE;
+   HostSim::AntFrame frame;
+   frame.time_us = s_now_us;
+   frame.channel = ucChannel;
+   memset(frame.payload, 0, sizeof(frame.payload));
+   memcpy(frame.payload, aucMesg, ucSize < sizeof(frame.payload) ? ucSize : sizeof(frame.payload));
+   if (s_frame_sink) s_frame_sink(frame);
+   else s_frames.push_back(frame);
+   return NRF_SUCCESS;
+}
+
+uint32_t sd_ant_event_get(uint8_t* pucChannel, uint8_t* pucEvent, uint8_t* aucANTMesg)
+{
+   if (s_events.empty()) return NRF_ERROR_NOT_FOUND;
+   AntEvent const& evt = s_events.front();
+   *pucChannel = evt.channel;
+   *pucEvent = evt.event;
+   memcpy(aucANTMesg, evt.message.aucMessage, sizeof(evt.message.aucMessage));
+   s_events.pop_front();
+   return NRF_SUCCESS;
+}
+
+// The SoftDevice event interrupt: on target it wakes the ANT task, here it
+// runs the same handler synchronously. Deferred events wait for the harness
+// to call ANTplus.ProcessDeferredEvents(), as they wait for the worker task.
+void SD_EVT_IRQHandler(void)
+{
+   ant_evt_t evt;
+   while (sd_ant_event_get(&evt.channel, &evt.event, evt.message.aucMessage) == NRF_SUCCESS)
+   {
+      ANTplus._ant_handler(&evt);
+   }
+}
+
+const std::vector<HostSim::AntFrame>& HostSim::antFrames(void) { return s_frames; }
+void HostSim::antClearFrames(void) { s_frames.clear(); }
+void HostSim::antSetFrameSink(void (*fp)(const AntFrame& frame)) { s_frame_sink = fp; }
+
+void HostSim::antInjectEvent(uint8_t channel, uint8_t event, const uint8_t* payload, uint8_t mesg_id)
+{
+   AntEvent evt;
+   memset(&evt, 0, sizeof(evt));
+   evt.channel = channel;
+   evt.event = event;
+   evt.message.ANT_MESSAGE_ucSize = 1 + ANT_STANDARD_DATA_PAYLOAD_SIZE;
+   evt.message.ANT_MESSAGE_ucMesgID = mesg_id;
+   evt.message.ANT_MESSAGE_ucChannel = channel;
+   if (payload) memcpy(evt.message.ANT_MESSAGE_aucPayload, payload, ANT_STANDARD_DATA_PAYLOAD_SIZE);
+   s_events.push_back(evt);
+}
+
+void HostSim::antDispatch(void) { SD_EVT_IRQHandler(); }
+
+bool HostSim::antChannelOpen(uint8_t channel)
+{
+   return channel < HOST_ANT_MAX_CHANNELS && s_channels[channel].open;
+}
+
+uint16_t HostSim::antChannelPeriod(uint8_t channel)
+{
+   return channel < HOST_ANT_MAX_CHANNELS ? s_channels[channel].period : 0;
+}
+
+/*------------------------------------------------------------------*/
+/* Bluefruit
+ *------------------------------------------------------------------*/
+AdafruitBluefruit Bluefruit;
+
+bool BLEClientService::begin(void)
+{
+   s_last_service = this;
+   return true;
+}
+
+bool BLEClientService::discover(uint16_t conn_handle)
+{
+   _conn_hdl = conn_handle;
+   return true;
+}
+
+bool BLEClientCharacteristic::begin(BLEClientService* parent_svc)
+{
+   _service = parent_svc ? parent_svc : s_last_service;
+   s_chars.push_back(this);
+   return _service != NULL;
+}
+
+bool BLEClientCharacteristic::discover(void)
+{
+   return _service != NULL && _service->connHandle() != BLE_CONN_HANDLE_INVALID;
+}
+
+bool BLECentral::connect(const ble_gap_evt_adv_report_t* adv_report)
+{
+   return connect(&adv_report->peer_addr);
+}
+
+bool BLECentral::connect(const ble_gap_addr_t* peer_addr)
+{
+   (void)peer_addr;
+   s_connect_pending = true;
+   return true;
+}
+
+uint32_t sd_ble_gap_connect_cancel(void)
+{
+   if (!s_connect_pending) return NRF_ERROR_INVALID_STATE;
+   s_connect_pending = false;
+   return NRF_SUCCESS;
+}
+
+bool BLEScanner::checkReportForService(const ble_gap_evt_adv_report_t* report, BLEClientService& svc)
+{
+   (void)svc;
+   return report->data.len > 0;
+}
+
+// The simulated XDS meter accepts any interval down to the 7.5 ms minimum.
+bool BLEConnection::requestConnectionParameter(uint16_t conn_interval, uint16_t slave_latency, uint16_t sup_timeout)
+{
+   if (!_connected || conn_interval < 6) return false;
+   _interval = conn_interval;
+   _latency = slave_latency;
+   _timeout = sup_timeout;
+   return true;
+}
+
+BLEConnection* AdafruitBluefruit::Connection(uint16_t conn_handle)
+{
+   return conn_handle < BLE_MAX_CONNECTION && _conns[conn_handle]._connected ? &_conns[conn_handle] : NULL;
+}
+
+bool AdafruitBluefruit::disconnect(uint16_t conn_handle)
+{
+   HostSim::bleDisconnect(conn_handle, 0x16);
+   return true;
+}
+
+void HostSim::bleAdvertise(const uint8_t addr[6], int8_t rssi, bool has_service)
+{
+   static uint8_t service_data[] = { 0x03, 0x03, 0x28, 0x18 };
+   if (!Bluefruit.Scanner._running || !Bluefruit.Scanner._rx_cb) return;
+   ble_gap_evt_adv_report_t report;
+   memset(&report, 0, sizeof(report));
+   memcpy(report.peer_addr.addr, addr, BLE_GAP_ADDR_LEN);
+   report.rssi = rssi;
+   report.data.p_data = service_data;
+   report.data.len = has_service ? sizeof(service_data) : 0;
+   // The SoftDevice pauses scanning for every report until it is resumed.
+   Bluefruit.Scanner._running = false;
+   Bluefruit.Scanner._rx_cb(&report);
+}
+
+void HostSim::bleNotify(uint16_t conn_handle, const uint8_t* data, uint16_t len)
+{
+   uint8_t buffer[247];
+   if (len > sizeof(buffer)) len = sizeof(buffer);
+   memcpy(buffer, data, len);
+   for (size_t i = 0; i < s_chars.size(); i++)
+   {
+      if (s_chars[i]->connHandle() == conn_handle) s_chars[i]->_notify_host(buffer, len);
+   }
+}
+
+void HostSim::bleDisconnect(uint16_t conn_handle, uint8_t reason)
+{
+   if (conn_handle < BLE_MAX_CONNECTION) Bluefruit._conns[conn_handle]._connected = false;
+   if (Bluefruit.Central._disconnect_cb) Bluefruit.Central._disconnect_cb(conn_handle, reason);
+   if (conn_handle == s_last_conn_handle) s_last_conn_handle = BLE_CONN_HANDLE_INVALID;
+}
+
+uint16_t HostSim::bleLastConnHandle(void) { return s_last_conn_handle; }
+
+void HostSim::bleProcess(void)
+{
+   if (s_connect_pending)
+   {
+      s_connect_pending = false;
+      s_last_conn_handle = s_next_conn_handle++;
+      if (s_last_conn_handle < BLE_MAX_CONNECTION)
+      {
+         BLEConnection& conn = Bluefruit._conns[s_last_conn_handle];
+         conn._connected = true;
+         conn._interval = Bluefruit.Central._conn_max;
+         conn._latency = 0;
+         conn._timeout = Bluefruit.Central._conn_timeout;
+      }
+      if (Bluefruit.Central._connect_cb) Bluefruit.Central._connect_cb(s_last_conn_handle);
+   }
+}
+
+/*------------------------------------------------------------------*/
+/* GPIO
+ *------------------------------------------------------------------*/
+void pinMode(uint32_t pin, uint32_t mode)
+{
+   (void)mode;
+   (void)pin;
+}
+
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode)
+{
+   if (pin >= HOST_GPIO_PINS) return;
+   s_gpio_handlers[pin] = callback;
+   s_gpio_modes[pin] = (uint8_t)mode;
+}
+
+void detachInterrupt(uint32_t pin)
+{
+   if (pin < HOST_GPIO_PINS) s_gpio_handlers[pin] = NULL;
+}
+
+void HostSim::gpioFallingEdge(uint8_t pin, uint64_t at_us)
+{
+   s_gpio_edges.insert(std::make_pair(at_us, pin));
+}
+
+static void GpioDispatch(void)
+{
+   while (!s_gpio_edges.empty() && s_gpio_edges.begin()->first <= s_now_us)
+   {
+      uint8_t pin = s_gpio_edges.begin()->second;
+      s_gpio_edges.erase(s_gpio_edges.begin());
+      if (pin < HOST_GPIO_PINS && s_gpio_handlers[pin] && s_gpio_modes[pin] != RISING) s_gpio_handlers[pin]();
+   }
+}
+
+/*------------------------------------------------------------------*/
+/* Driver
+ *------------------------------------------------------------------*/
+void HostSim::run(uint64_t duration_us, void (*loop_fn)(void), uint32_t loop_period_us)
+{
+   uint64_t end_us = s_now_us + duration_us;
+   uint64_t next_loop_us = s_now_us;
+
+   while (s_now_us < end_us)
+   {
+      uint64_t next_us = next_loop_us;
+      for (uint8_t ch = 0; ch < HOST_ANT_MAX_CHANNELS; ch++)
+      {
+         if (s_channels[ch].open && s_channels[ch].master && s_channels[ch].next_tx_us < next_us)
+            next_us = s_channels[ch].next_tx_us;
+      }
+      if (!s_gpio_edges.empty() && s_gpio_edges.begin()->first < next_us) next_us = s_gpio_edges.begin()->first;
+      if (next_us > end_us) next_us = end_us;
+      if (next_us > s_now_us) s_now_us = next_us;
+
+      GpioDispatch();
+
+      for (uint8_t ch = 0; ch < HOST_ANT_MAX_CHANNELS; ch++)
+      {
+         AntChannel& c = s_channels[ch];
+         if (c.open && c.master && c.next_tx_us <= s_now_us)
+         {
+            c.next_tx_us += PeriodToMicros(c.period);
+            antInjectEvent(ch, EVENT_TX);
+         }
+      }
+      antDispatch();
+      bleProcess();
+
+      if (loop_fn && next_loop_us <= s_now_us)
+      {
+         next_loop_us = s_now_us + loop_period_us;
+         loop_fn();
+      }
+   }
+}
@@ -0,0 +1,60 @@
+/*
+ Host simulation harness for the bridge core.
+
+ Provides the virtual clock behind millis()/micros(), records every frame
+ handed to sd_ant_broadcast_message_tx, generates EVENT_TX at the channel
+ period of each open channel and lets a harness inject ANT events, BLE
+ advertisements, connections, notifications and GPIO edges.
+*/
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "ant_parameters.h"
+
+namespace HostSim
+{
+   typedef struct
+   {
+      uint64_t time_us;
+      uint8_t  channel;
+      uint8_t  payload[ANT_STANDARD_DATA_PAYLOAD_SIZE];
+   } AntFrame;
+
+   /*------------- Virtual clock -------------*/
+   uint64_t nowMicros(void);
+   void setMicros(uint64_t us);
+   void advanceMicros(uint64_t us);
+
+   /*------------- ANT -------------*/
+   const std::vector<AntFrame>& antFrames(void);
+   void antClearFrames(void);
+   void antSetFrameSink(void (*fp)(const AntFrame& frame));
+   void antInjectEvent(uint8_t channel, uint8_t event, const uint8_t* payload = NULL,
+                       uint8_t mesg_id = MESG_BROADCAST_DATA_ID);
+   void antDispatch(void);
+   bool antChannelOpen(uint8_t channel);
+   uint16_t antChannelPeriod(uint8_t channel);
+
+   /*------------- BLE -------------*/
+   void bleAdvertise(const uint8_t addr[6], int8_t rssi, bool has_service);
+   void bleNotify(uint16_t conn_handle, const uint8_t* data, uint16_t len);
+   void bleDisconnect(uint16_t conn_handle, uint8_t reason);
+   uint16_t bleLastConnHandle(void);
+   void bleProcess(void);
+
+   /*------------- GPIO -------------*/
+   // Schedules a falling edge on pin at the absolute virtual time at_us.
+   // run() stops the clock exactly there and calls the pin's
+   // attachInterrupt() handler, so micros() in the handler is the edge time.
+   void gpioFallingEdge(uint8_t pin, uint64_t at_us);
+
+   /*------------- Driver -------------*/
+   // Advances the clock by duration_us, emitting EVENT_TX for open channels
+   // and calling loop_fn every loop_period_us, as loop() runs on target.
+   void run(uint64_t duration_us, void (*loop_fn)(void), uint32_t loop_period_us = 10000);
+}
+
+#endif
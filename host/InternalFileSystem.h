@@ -0,0 +1,19 @@
+/*
+ Host stand-in for the internal-flash LittleFS instance of the nRF52 core.
+*/
+#ifndef HOST_INTERNALFILESYSTEM_H
+#define HOST_INTERNALFILESYSTEM_H
+
+#include "Adafruit_LittleFS.h"
+
+#define LFS_FLASH_TOTAL_SIZE  (7 * 4096)
+
+class InternalFileSystem : public Adafruit_LittleFS
+{
+public:
+   InternalFileSystem() { setHostCapacity(LFS_FLASH_TOTAL_SIZE); }
+};
+
+extern InternalFileSystem InternalFS;
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ Host stand-in for the SoftDevice ANT API. The calls are implemented by
+ HostSim.cpp, which records what the bridge sends and feeds it events.
+*/
+#ifndef HOST_ANT_INTERFACE_H
+#define HOST_ANT_INTERFACE_H
+
+#include <stdint.h>
+#include "ant_parameters.h"
+#include "nrf_error.h"
+
+typedef struct
+{
+   uint8_t  ucTotalNumberOfChannels;
+   uint8_t  ucNumberOfEncryptedChannels;
+   uint16_t usNumberOfEvents;
+   uint8_t* pucMemoryBlockStartLocation;
+   uint16_t usMemoryBlockByteSize;
+} ANT_ENABLE;
+
+#define ANT_ENABLE_GET_REQUIRED_SPACE(num_channels, num_encrypted, burst_size, num_events) \
+   ((uint16_t)(64 * (num_channels) + 32 * (num_encrypted) + (burst_size) + 8 * (num_events)))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t sd_softdevice_is_enabled(uint8_t* p_softdevice_enabled);
+
+uint32_t sd_ant_enable(ANT_ENABLE* const pstANTEnableConfig);
+uint32_t sd_ant_network_address_set(uint8_t ucNetwork, uint8_t const* pucNetworkKey);
+uint32_t sd_ant_channel_assign(uint8_t ucChannel, uint8_t ucChannelType, uint8_t ucNetwork, uint8_t ucExtAssign);
+uint32_t sd_ant_channel_id_set(uint8_t ucChannel, uint16_t usDeviceNumber, uint8_t ucDeviceType, uint8_t ucTransmitType);
+uint32_t sd_ant_channel_radio_freq_set(uint8_t ucChannel, uint8_t ucRFFreq);
+uint32_t sd_ant_channel_period_set(uint8_t ucChannel, uint16_t usPeriod);
+uint32_t sd_ant_channel_open(uint8_t ucChannel);
+uint32_t sd_ant_channel_close(uint8_t ucChannel);
+uint32_t sd_ant_broadcast_message_tx(uint8_t ucChannel, uint8_t ucSize, uint8_t* aucMesg);
+uint32_t sd_ant_event_get(uint8_t* pucChannel, uint8_t* pucEvent, uint8_t* aucANTMesg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ Host stand-in for the SoftDevice ant_parameters.h (values as in S340).
+*/
+#ifndef HOST_ANT_PARAMETERS_H
+#define HOST_ANT_PARAMETERS_H
+
+#include <stdint.h>
+
+#define ANT_STANDARD_DATA_PAYLOAD_SIZE       ((uint8_t)8)
+#define MESG_BUFFER_SIZE                     ((uint8_t)41)
+
+#define MESG_BROADCAST_DATA_ID               ((uint8_t)0x4E)
+#define MESG_ACKNOWLEDGED_DATA_ID            ((uint8_t)0x4F)
+#define MESG_BURST_DATA_ID                   ((uint8_t)0x50)
+
+#define CHANNEL_TYPE_SLAVE                   ((uint8_t)0x00)
+#define CHANNEL_TYPE_MASTER                  ((uint8_t)0x10)
+#define EXT_PARAM_ALWAYS_SEARCH              ((uint8_t)0x01)
+
+#define RESPONSE_NO_ERROR                    ((uint8_t)0x00)
+#define NO_EVENT                             ((uint8_t)0x00)
+#define EVENT_RX_SEARCH_TIMEOUT              ((uint8_t)0x01)
+#define EVENT_RX_FAIL                        ((uint8_t)0x02)
+#define EVENT_TX                             ((uint8_t)0x03)
+#define EVENT_TRANSFER_RX_FAILED             ((uint8_t)0x04)
+#define EVENT_TRANSFER_TX_COMPLETED          ((uint8_t)0x05)
+#define EVENT_TRANSFER_TX_FAILED             ((uint8_t)0x06)
+#define EVENT_CHANNEL_CLOSED                 ((uint8_t)0x07)
+#define EVENT_RX_FAIL_GO_TO_SEARCH           ((uint8_t)0x08)
+#define EVENT_CHANNEL_COLLISION              ((uint8_t)0x09)
+#define EVENT_TRANSFER_TX_START              ((uint8_t)0x0A)
+#define EVENT_RX_DATA_OVERFLOW               ((uint8_t)0x0B)
+#define EVENT_TRANSFER_NEXT_DATA_BLOCK       ((uint8_t)0x11)
+#define CHANNEL_IN_WRONG_STATE               ((uint8_t)0x15)
+#define CHANNEL_NOT_OPENED                   ((uint8_t)0x16)
+#define CHANNEL_ID_NOT_SET                   ((uint8_t)0x18)
+#define CLOSE_ALL_CHANNELS                   ((uint8_t)0x19)
+#define TRANSFER_IN_PROGRESS                 ((uint8_t)0x1F)
+#define TRANSFER_SEQUENCE_NUMBER_ERROR       ((uint8_t)0x20)
+#define TRANSFER_IN_ERROR                    ((uint8_t)0x21)
+#define TRANSFER_BUSY                        ((uint8_t)0x22)
+#define MESSAGE_SIZE_EXCEEDS_LIMIT           ((uint8_t)0x27)
+#define INVALID_MESSAGE                      ((uint8_t)0x28)
+#define INVALID_NETWORK_NUMBER               ((uint8_t)0x29)
+#define INVALID_LIST_ID                      ((uint8_t)0x30)
+#define INVALID_SCAN_TX_CHANNEL              ((uint8_t)0x31)
+#define INVALID_PARAMETER_PROVIDED           ((uint8_t)0x33)
+#define EVENT_QUE_OVERFLOW                   ((uint8_t)0x35)
+#define EVENT_ENCRYPT_NEGOTIATION_SUCCESS    ((uint8_t)0x38)
+#define EVENT_ENCRYPT_NEGOTIATION_FAIL       ((uint8_t)0x39)
+#define EVENT_RFACTIVE_NOTIFICATION          ((uint8_t)0x3A)
+#define EVENT_CONNECTION_START               ((uint8_t)0x3B)
+#define EVENT_CONNECTION_SUCCESS             ((uint8_t)0x3C)
+#define EVENT_CONNECTION_FAIL                ((uint8_t)0x3D)
+#define EVENT_CONNECTION_TIMEOUT             ((uint8_t)0x3E)
+#define EVENT_CONNECTION_UPDATE              ((uint8_t)0x3F)
+#define NO_RESPONSE_MESSAGE                  ((uint8_t)0x50)
+#define EVENT_RX                             ((uint8_t)0x80)
+#define EVENT_BLOCKED                        ((uint8_t)0xFF)
+
+typedef union
+{
+   uint32_t ulForceAlign;
+   uint8_t  aucMessage[MESG_BUFFER_SIZE];
+   struct
+   {
+      uint8_t ucSize;
+      uint8_t ucMesgID;
+      uint8_t ucChannel;
+      uint8_t aucPayload[ANT_STANDARD_DATA_PAYLOAD_SIZE];
+   } stMessage;
+} ANT_MESSAGE;
+
+#define ANT_MESSAGE_ucSize      stMessage.ucSize
+#define ANT_MESSAGE_ucMesgID    stMessage.ucMesgID
+#define ANT_MESSAGE_ucChannel   stMessage.ucChannel
+#define ANT_MESSAGE_aucPayload  stMessage.aucPayload
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#endif
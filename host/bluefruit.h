@@ -0,0 +1,158 @@
+/*
+ Host stand-in for the Adafruit Bluefruit nRF52 library and the FreeRTOS
+ calls the bridge makes. Links are driven by HostSim.
+*/
+#ifndef HOST_BLUEFRUIT_H
+#define HOST_BLUEFRUIT_H
+
+#include <Arduino.h>
+#include "nrf.h"
+#include "nrf_error.h"
+
+/*------------- BLE -------------*/
+#define BLE_MAX_CONNECTION        20
+#define BLE_CONN_HANDLE_INVALID   0xFFFF
+#define BLE_GAP_ADDR_LEN          6
+
+typedef struct
+{
+  uint8_t addr_id_peer : 1;
+  uint8_t addr_type    : 7;
+  uint8_t addr[BLE_GAP_ADDR_LEN];
+} ble_gap_addr_t;
+
+typedef struct
+{
+  uint8_t* p_data;
+  uint16_t len;
+} ble_data_t;
+
+typedef struct
+{
+  ble_gap_addr_t peer_addr;
+  int8_t         rssi;
+  ble_data_t     data;
+} ble_gap_evt_adv_report_t;
+
+uint32_t sd_ble_gap_connect_cancel(void);
+
+class BLEUuid
+{
+public:
+  BLEUuid(uint16_t uuid16 = 0) : _uuid16(uuid16) {}
+  uint16_t _uuid16;
+};
+
+class BLEClientService
+{
+public:
+  BLEClientService(BLEUuid bleuuid) : uuid(bleuuid), _conn_hdl(BLE_CONN_HANDLE_INVALID) {}
+  bool begin(void);
+  bool discover(uint16_t conn_handle);
+  uint16_t connHandle(void) { return _conn_hdl; }
+
+  BLEUuid uuid;
+
+private:
+  uint16_t _conn_hdl;
+};
+
+class BLEClientCharacteristic;
+typedef void (*notify_cb_t)(BLEClientCharacteristic* chr, uint8_t* data, uint16_t len);
+
+class BLEClientCharacteristic
+{
+public:
+  BLEClientCharacteristic(BLEUuid bleuuid) : uuid(bleuuid), _notify_cb(NULL), _service(NULL), _notify(false) {}
+  void setNotifyCallback(notify_cb_t fp) { _notify_cb = fp; }
+  bool begin(BLEClientService* parent_svc = NULL);
+  bool discover(void);
+  bool enableNotify(void) { _notify = true; return true; }
+  bool disableNotify(void) { _notify = false; return true; }
+  uint16_t connHandle(void) { return _service ? _service->connHandle() : BLE_CONN_HANDLE_INVALID; }
+
+  BLEUuid uuid;
+
+  // Called by HostSim to deliver a notification.
+  void _notify_host(uint8_t* data, uint16_t len) { if (_notify && _notify_cb) _notify_cb(this, data, len); }
+
+private:
+  notify_cb_t _notify_cb;
+  BLEClientService* _service;
+  bool _notify;
+};
+
+// Parameters in SoftDevice units: interval 1.25 ms, supervision timeout 10 ms.
+class BLEConnection
+{
+public:
+  bool requestConnectionParameter(uint16_t conn_interval, uint16_t slave_latency, uint16_t sup_timeout);
+  uint16_t getConnectionInterval(void) { return _interval; }
+  uint16_t getSlaveLatency(void) { return _latency; }
+  uint16_t getSupervisionTimeout(void) { return _timeout; }
+
+  bool _connected = false;
+  uint16_t _interval = 0;
+  uint16_t _latency = 0;
+  uint16_t _timeout = 0;
+};
+
+class BLECentral
+{
+public:
+  typedef void (*connect_cb_t)(uint16_t conn_handle);
+  typedef void (*disconnect_cb_t)(uint16_t conn_handle, uint8_t reason);
+
+  void setConnectCallback(connect_cb_t fp) { _connect_cb = fp; }
+  void setDisconnectCallback(disconnect_cb_t fp) { _disconnect_cb = fp; }
+  bool connect(const ble_gap_evt_adv_report_t* adv_report);
+  bool connect(const ble_gap_addr_t* peer_addr);
+  void setConnInterval(uint16_t min, uint16_t max) { _conn_min = min; _conn_max = max; }
+  void setConnSupervisionTimeout(uint16_t timeout) { _conn_timeout = timeout; }
+
+  uint16_t _conn_min = 24;
+  uint16_t _conn_max = 24;
+  uint16_t _conn_timeout = 400;
+  connect_cb_t _connect_cb = NULL;
+  disconnect_cb_t _disconnect_cb = NULL;
+};
+
+class BLEScanner
+{
+public:
+  typedef void (*rx_callback_t)(ble_gap_evt_adv_report_t*);
+
+  void setRxCallback(rx_callback_t fp) { _rx_cb = fp; }
+  void filterUuid(BLEUuid uuid) { (void)uuid; }
+  void setInterval(uint16_t interval, uint16_t window) { _interval = interval; _window = window; }
+  void restartOnDisconnect(bool enable) { (void)enable; }
+  bool start(uint16_t timeout = 0) { (void)timeout; _running = true; return true; }
+  bool stop(void) { _running = false; return true; }
+  bool resume(void) { _running = true; return true; }
+  bool isRunning(void) { return _running; }
+  bool checkReportForService(const ble_gap_evt_adv_report_t* report, BLEClientService& svc);
+
+  rx_callback_t _rx_cb = NULL;
+  bool _running = false;
+  uint16_t _interval = 160;
+  uint16_t _window = 80;
+};
+
+class AdafruitBluefruit
+{
+public:
+  bool begin(uint8_t prph_count = 1, uint8_t central_count = 0) { (void)prph_count; (void)central_count; return true; }
+  void setName(const char* name) { (void)name; }
+  void autoConnLed(bool enabled) { (void)enabled; }
+  void setMultiprotocolSemaphore(SemaphoreHandle_t sem) { (void)sem; }
+  bool disconnect(uint16_t conn_handle);
+  BLEConnection* Connection(uint16_t conn_handle);
+
+  BLECentral Central;
+  BLEScanner Scanner;
+  BLEConnection _conns[BLE_MAX_CONNECTION];
+};
+
+extern AdafruitBluefruit Bluefruit;
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef HOST_COMPILER_ABSTRACTION_H
+#define HOST_COMPILER_ABSTRACTION_H
+
+#ifndef __INLINE
+#define __INLINE inline
+#endif
+
+#ifndef __ALIGN
+#define __ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+#endif
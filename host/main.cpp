@@ -0,0 +1,350 @@
+/*
+ Host entry point: runs the unmodified sketch (setup()/loop()) on the
+ virtual clock and plays a simulated XDS power meter into it.
+
+   host/main [--minutes N] [--watts W] [--period HZ] [--meters N] [--quiet] [--perf]
+             [--drop S] [--stall S]     drop every link / silence every meter for
+                                        20 s at second S to exercise reconnection
+             [--fs DIR] [--record]      record the session under DIR/rec (default build/fs)
+             [--fs-size BYTES]          capacity of the file system (default the 28 KiB
+                                        InternalFS partition, 0 for no limit)
+             [--virtual] [--seed N]     no meter advertises; the bridge rides its virtual
+                                        workout with seed N and prints the ride at the end
+             [--hall RPM]               pedal a hall sensor on HOST_HALL_PIN at RPM, each
+                                        edge followed by a contact bounce
+   host/main [--fs DIR] --dump FILE     decode a recording, e.g. --dump /rec/s00001.bin
+   host/main [--fs DIR] [--period HZ] --replay FILE [--realtime] [--expect DIGEST]
+                                        play a recording's XDS frames through the bridge;
+                                        ANT+ frames on stdout, statistics on stderr; exits
+                                        non-zero unless the fast replay's digest is DIGEST
+   host/main --bench [ITERATIONS]     codec microbenchmarks as CSV
+*/
+#include <Arduino.h>
+#include <time.h>
+#include "HostSim.h"
+#include "../src/PowerMeter/CodecBench.h"
+
+#include "../PowerMeter_v1.ino"
+
+static uint16_t s_sim_watts = 180;
+
+#define HOST_HALL_PIN      7
+#define HOST_HALL_BOUNCE_US 150
+
+// loop() plus the work the idle-priority tasks do on target.
+static void HostLoop(void)
+{
+   loop();
+   ANTplus.ProcessDeferredEvents();
+   DLog.Drain();
+   Recorder.Service();
+}
+
+static void PrintReplayFrame(const trace_frame_t& frame)
+{
+   printf("%10lu ANT %u", (unsigned long)frame.tick, frame.stream);
+   for (uint8_t i = 0; i < ANT_STANDARD_DATA_PAYLOAD_SIZE; i++) printf(" %02X", frame.payload[i]);
+   printf("\n");
+}
+
+// Fast mode replays inside the command; real time runs the simulation until
+// the trace ends, with no simulated meter so the trace is the only source.
+static int ReplayRecording(const char* name, bool realtime, const char* expect)
+{
+   if (realtime && expect)
+   {
+      fprintf(stderr, "--expect needs a fast replay\n");
+      return 1;
+   }
+   char command[96];
+   snprintf(command, sizeof(command), "replay %s%s", name, realtime ? "" : " fast");
+   power.getReplay().setFrameSink(PrintReplayFrame);
+   power.handleSerialCommand(command);
+   if (!realtime)
+   {
+      const TraceReplay& replay = power.getReplay();
+      if (replay.frameCount() == 0) return 1;
+      if (expect && replay.frameDigest() != (uint32_t)strtoul(expect, NULL, 16))
+      {
+         fprintf(stderr, "digest %08lX, expected %s\n", (unsigned long)replay.frameDigest(), expect);
+         return 1;
+      }
+      return 0;
+   }
+
+   uint64_t start_us = HostSim::nowMicros();
+   while (power.getReplay().IsActive()) HostSim::run(100000, HostLoop);
+   // Let the last sample go out.
+   HostSim::run(500000, HostLoop);
+   const std::vector<HostSim::AntFrame>& all = HostSim::antFrames();
+   for (size_t i = 0; i < all.size(); i++)
+   {
+      if (all[i].time_us < start_us) continue;
+      trace_frame_t frame;
+      frame.tick = (uint32_t)((all[i].time_us - start_us) / 1000);
+      frame.stream = all[i].channel;
+      memcpy(frame.payload, all[i].payload, sizeof(frame.payload));
+      PrintReplayFrame(frame);
+   }
+   return 0;
+}
+
+static int DumpRecording(const char* name)
+{
+   Adafruit_LittleFS_Namespace::File file = InternalFS.open(name);
+   if (!file)
+   {
+      fprintf(stderr, "cannot open %s\n", name);
+      return 1;
+   }
+   SessionReader reader(file);
+   if (!reader.IsValid())
+   {
+      fprintf(stderr, "%s is not a session recording\n", name);
+      file.close();
+      return 1;
+   }
+   static const char* const types[] = { "BLE", "ANT", "BLE", "GAP" };
+   session_record_t rec;
+   uint32_t count = 0;
+   while (reader.Next(rec))
+   {
+      printf("%10lu %s %u", (unsigned long)rec.tick, types[rec.type], rec.stream);
+      if (rec.type == SESSION_REC_GAP) printf(" lost %lu", (unsigned long)rec.lost);
+      for (uint8_t i = 0; i < rec.len; i++) printf(" %02X", rec.data[i]);
+      printf("\n");
+      count++;
+   }
+   fprintf(stderr, "%lu records, %lu bytes\n", (unsigned long)count, (unsigned long)file.size());
+   file.close();
+   return 0;
+}
+
+static void SendXdsFrame(uint16_t conn_handle, uint16_t watts, uint16_t cadence)
+{
+   int16_t left = (int16_t)(watts / 2);
+   int16_t right = (int16_t)(watts - left);
+   uint8_t frame[11] =
+   {
+      (uint8_t)(watts & 0xFF), (uint8_t)(watts >> 8),
+      (uint8_t)(left & 0xFF), (uint8_t)((uint16_t)left >> 8),
+      (uint8_t)(right & 0xFF), (uint8_t)((uint16_t)right >> 8),
+      0x00, 0x00,
+      (uint8_t)(cadence & 0xFF), (uint8_t)(cadence >> 8),
+      0x00
+   };
+   HostSim::bleNotify(conn_handle, frame, sizeof(frame));
+}
+
+int main(int argc, char** argv)
+{
+   uint32_t minutes = 1;
+   bool quiet = false;
+   bool perf = false;
+   const char* period = NULL;
+   uint32_t meters = 1;
+   uint32_t bench_iterations = 0;
+   uint32_t drop_at = UINT32_MAX;
+   uint32_t stall_at = UINT32_MAX;
+   bool record = false;
+   const char* dump = NULL;
+   const char* replay = NULL;
+   const char* expect = NULL;
+   bool realtime = false;
+   bool virtual_only = false;
+   uint32_t hall_rpm = 0;
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--minutes") && i + 1 < argc) minutes = (uint32_t)atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--watts") && i + 1 < argc) s_sim_watts = (uint16_t)atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--period") && i + 1 < argc) period = argv[++i];
+      else if (!strcmp(argv[i], "--meters") && i + 1 < argc) meters = (uint32_t)atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--drop") && i + 1 < argc) drop_at = (uint32_t)atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--stall") && i + 1 < argc) stall_at = (uint32_t)atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--fs") && i + 1 < argc) InternalFS.setHostRoot(argv[++i]);
+      else if (!strcmp(argv[i], "--fs-size") && i + 1 < argc) InternalFS.setHostCapacity((uint32_t)atoi(argv[++i]));
+      else if (!strcmp(argv[i], "--dump") && i + 1 < argc) dump = argv[++i];
+      else if (!strcmp(argv[i], "--record")) record = true;
+      else if (!strcmp(argv[i], "--replay") && i + 1 < argc) replay = argv[++i];
+      else if (!strcmp(argv[i], "--realtime")) realtime = true;
+      else if (!strcmp(argv[i], "--expect") && i + 1 < argc) expect = argv[++i];
+      else if (!strcmp(argv[i], "--virtual")) virtual_only = true;
+      else if (!strcmp(argv[i], "--hall") && i + 1 < argc) hall_rpm = (uint32_t)atoi(argv[++i]);
+      else if (!strcmp(argv[i], "--seed") && i + 1 < argc) PWRconfig.workoutSeed = (uint32_t)strtoul(argv[++i], NULL, 0);
+      else if (!strcmp(argv[i], "--quiet")) quiet = true;
+      else if (!strcmp(argv[i], "--perf")) perf = true;
+      else if (!strcmp(argv[i], "--bench"))
+      {
+         bench_iterations = CODEC_BENCH_ITERATIONS;
+         if (i + 1 < argc && argv[i + 1][0] != '-') bench_iterations = (uint32_t)atoi(argv[++i]);
+      }
+   }
+
+   if (dump) return DumpRecording(dump);
+
+   if (bench_iterations)
+   {
+      Serial.setOutput(NULL);
+      setup();
+      Serial.setOutput(stdout);
+      CodecBench::Run(bench_iterations);
+      return 0;
+   }
+
+   if (replay) Serial.setOutput(stderr);
+   if (quiet) Serial.setOutput(NULL);
+   clock_t wall_start = clock();
+   if (meters < 1) meters = 1;
+   if (meters > PM_MAX_METERS) meters = PM_MAX_METERS;
+   PWRconfig.meterCount = (uint8_t)meters;
+   PWRconfig.recordSession = record;
+   if (hall_rpm) PWRconfig.hallPin = HOST_HALL_PIN;
+   setup();
+
+   if (replay)
+   {
+      if (period)
+      {
+         char command[32];
+         snprintf(command, sizeof(command), "period %s", period);
+         power.handleSerialCommand(command);
+      }
+      return ReplayRecording(replay, realtime, expect);
+   }
+
+   // Let each meter advertise once so the bridge connects to all of them.
+   // The scan and connect callbacks only queue events, so loop() has to run
+   // before the scanner resumes for the next meter.
+   for (uint32_t m = 0; m < meters && !virtual_only; m++)
+   {
+      const uint8_t xds_addr[6] = { 0x11, 0x22, 0x33, 0x44, 0x55, (uint8_t)(0x66 + m) };
+      HostSim::bleAdvertise(xds_addr, -50, true);
+      HostSim::run(20000, HostLoop);
+   }
+
+   // Switched on the open channel, the same way the console command does.
+   if (period)
+   {
+      char command[32];
+      snprintf(command, sizeof(command), "period %s", period);
+      power.handleSerialCommand(command);
+   }
+
+   // Crank edges land between loop() calls at exact microseconds.
+   uint64_t hall_period_us = hall_rpm ? 60000000ull / hall_rpm : 0;
+   uint64_t next_edge_us = HostSim::nowMicros() + hall_period_us;
+   for (uint32_t s = 0; s < minutes * 60; s++)
+   {
+      for (; hall_period_us && next_edge_us < HostSim::nowMicros() + 1000000; next_edge_us += hall_period_us)
+      {
+         HostSim::gpioFallingEdge(HOST_HALL_PIN, next_edge_us);
+         HostSim::gpioFallingEdge(HOST_HALL_PIN, next_edge_us + HOST_HALL_BOUNCE_US);
+      }
+      // Supervision timeout on every link; the bridge reconnects by itself.
+      if (s == drop_at)
+      {
+         for (uint8_t m = 0; m < meters; m++)
+         {
+            MeterLink* link = power.getLink(m);
+            if (link->isConnected) HostSim::bleDisconnect(link->connectionHandle, 0x08);
+         }
+      }
+      bool stalled = s >= stall_at && s < stall_at + 20;
+
+      // The XDS meter notifies about twice per second; meter m rides 10*m W harder.
+      // Handles are read back every time since a reconnect assigns a new one.
+      for (int half = 0; half < 2; half++)
+      {
+         for (uint8_t m = 0; m < meters && !stalled; m++)
+         {
+            MeterLink* link = power.getLink(m);
+            if (link->isConnected) SendXdsFrame(link->connectionHandle, (uint16_t)(s_sim_watts + 10 * m), 85);
+         }
+         HostSim::run(500000, HostLoop);
+      }
+   }
+
+   if (record)
+   {
+      Recorder.Stop();
+      Recorder.Service();
+   }
+   double wall_s = (double)(clock() - wall_start) / CLOCKS_PER_SEC;
+   Serial.setOutput(stderr);
+   size_t frames = HostSim::antFrames().size();
+   Serial.printf("simulated %u min in %.3f s, %u ANT frames sent\n", (unsigned)minutes, wall_s, (unsigned)frames);
+   if (meters > 1)
+   {
+      // Per channel: frame count and the instantaneous power of its last page 0x10.
+      for (uint8_t ch = 0; ch < meters; ch++)
+      {
+         unsigned count = 0, watts = 0;
+         const std::vector<HostSim::AntFrame>& all = HostSim::antFrames();
+         for (size_t i = 0; i < all.size(); i++)
+         {
+            if (all[i].channel != ch) continue;
+            count++;
+            if (all[i].payload[0] == 0x10) watts = all[i].payload[6] | (all[i].payload[7] << 8);
+         }
+         Serial.printf("  channel %u: %u frames, %u W\n", (unsigned)ch, count, watts);
+      }
+   }
+   if (record)
+   {
+      session_stats_t st;
+      Recorder.GetStats(&st);
+      Serial.printf("recorded %lu records in %lu bytes (%lu files), %lu lost, %lu write errors, slowest write %lu us\n",
+                    (unsigned long)st.records, (unsigned long)st.bytes, (unsigned long)st.files,
+                    (unsigned long)st.lost, (unsigned long)st.write_errors, (unsigned long)st.max_write_us);
+   }
+   if (hall_rpm)
+   {
+      // Cadence of every page 0x10 once two revolutions are in, against the pedalled RPM.
+      const std::vector<HostSim::AntFrame>& all = HostSim::antFrames();
+      unsigned pages = 0, exact = 0, min_rpm = 255, max_rpm = 0;
+      for (size_t i = 0; i < all.size(); i++)
+      {
+         if (all[i].channel != 0 || all[i].payload[0] != 0x10 || all[i].time_us < 3000000) continue;
+         unsigned rpm = all[i].payload[3];
+         pages++;
+         if (rpm == hall_rpm) exact++;
+         if (rpm < min_rpm) min_rpm = rpm;
+         if (rpm > max_rpm) max_rpm = rpm;
+      }
+      crank_stats_t st;
+      Crank.GetStats(&st);
+      Serial.printf("hall: %lu edges, %lu bounces, %lu revolutions; page 0x10 cadence %u..%u rpm, %u/%u at %lu\n",
+                    (unsigned long)st.edges, (unsigned long)st.bounces, (unsigned long)st.revolutions,
+                    min_rpm, max_rpm, exact, pages, (unsigned long)hall_rpm);
+   }
+   if (virtual_only)
+   {
+      // The last page 0x10 must carry the generator's own event count and
+      // accumulated power, and every page after the first sample the workout's
+      // cadence rather than OFF; the digest makes two runs with one seed comparable.
+      const std::vector<HostSim::AntFrame>& all = HostSim::antFrames();
+      uint32_t digest = 2166136261u;
+      unsigned events = 0, accumulated = 0, min_rpm = 255, max_rpm = 0, off = 0;
+      for (size_t i = 0; i < all.size(); i++)
+      {
+         for (uint8_t b = 0; b < ANT_STANDARD_DATA_PAYLOAD_SIZE; b++) digest = (digest ^ all[i].payload[b]) * 16777619u;
+         if (all[i].payload[0] != 0x10) continue;
+         events = all[i].payload[1];
+         accumulated = all[i].payload[4] | (all[i].payload[5] << 8);
+         unsigned rpm = all[i].payload[3];
+         if (rpm == 0xFF)
+         {
+            off++;
+            continue;
+         }
+         if (rpm < min_rpm) min_rpm = rpm;
+         if (rpm > max_rpm) max_rpm = rpm;
+      }
+      MeterLink* link = power.getLink(0);
+      Serial.printf("virtual: %u events, %u accumulated W (link %u / %u), cadence %u..%u rpm (%u pages OFF), digest %08lX\n",
+                    events, accumulated, link->PWREventCount, link->accPWR, min_rpm, max_rpm, off, (unsigned long)digest);
+      power.handleSerialCommand("metrics");
+   }
+   if (perf) Perf.Print();
+   return 0;
+}
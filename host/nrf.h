@@ -0,0 +1,6 @@
+#ifndef HOST_NRF_H
+#define HOST_NRF_H
+
+#include "compiler_abstraction.h"
+
+#endif
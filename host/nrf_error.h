@@ -0,0 +1,13 @@
+#ifndef HOST_NRF_ERROR_H
+#define HOST_NRF_ERROR_H
+
+#define NRF_ERROR_BASE_NUM          (0x0)
+#define NRF_SUCCESS                 (NRF_ERROR_BASE_NUM + 0)
+#define NRF_ERROR_INVALID_STATE     (NRF_ERROR_BASE_NUM + 8)
+#define NRF_ERROR_INVALID_PARAM     (NRF_ERROR_BASE_NUM + 7)
+#define NRF_ERROR_NOT_FOUND         (NRF_ERROR_BASE_NUM + 5)
+#define NRF_ERROR_NO_MEM            (NRF_ERROR_BASE_NUM + 4)
+
+#define NRF_ERROR_ANT_BASE_NUM      (0x4000)
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ Host test for PWRPageScheduler: drives Request()/Next() with the bridge's
+ own schedule at 8, 4 and 2 Hz and random page 0x46 requests, and checks
+ the ANT+ interleave rules on every tick.
+
+   host/build/scheduler_test [TICKS_PER_RATE] [SEED]
+
+ Exits non-zero on the first violated rule.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../src/PowerMeter/BicyclePower.h"
+
+#define TEST_DEFAULT_TICKS      1000000u
+#define TEST_MAX_GAP_50_51      121     // ANT+ common pages 0x50/0x51: at least every 121 messages
+#define TEST_REQUEST_DEADLINE   64      // Ticks within which an accepted request must be served
+#define TEST_REQUEST_ODDS       4       // One request every N ticks on average
+#define TEST_MAX_COUNT          4       // Page 0x46 "number of responses" drawn from 1..N
+
+static uint32_t s_state;
+
+static uint32_t NextRandom(void)
+{
+   uint32_t x = s_state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   return s_state = x;
+}
+
+static const uint8_t s_requestable[] = { 0x02, 0x50, 0x51, 0x52, 0x56, 0x01 };
+
+// Outstanding request per page: responses still owed and the tick by which
+// the last of them must have gone out. A repeated request replaces both.
+struct Outstanding
+{
+   uint8_t remaining;
+   uint64_t deadline;
+};
+
+static int Fail(const char* rate, uint64_t tick, const char* what, unsigned value)
+{
+   fprintf(stderr, "FAIL %s tick %llu: %s (%u)\n", rate, (unsigned long long)tick, what, value);
+   return 1;
+}
+
+static bool InRotation(uint8_t page)
+{
+   return page == 0x50 || page == 0x51 || page == 0x52 || page == 0x56;
+}
+
+// Same background spacing rule as BicyclePower::OnChannelPeriodChanged().
+static uint8_t IntervalForPeriod(uint16_t period)
+{
+   uint32_t interval = ((uint32_t)PWR_BACKGROUND_INTERVAL * PWR_MSG_PERIOD_4Hz + period / 2) / period;
+   if (interval > PWR_BACKGROUND_INTERVAL_MAX) interval = PWR_BACKGROUND_INTERVAL_MAX;
+   if (interval < 1) interval = 1;
+   return (uint8_t)interval;
+}
+
+static int RunRate(const char* rate, uint16_t period, uint64_t ticks)
+{
+   pwr_schedule_config_t schedule =
+   {
+      0x10,
+      IntervalForPeriod(period),
+      6,
+      { 0x50, 0x51, 0x52, 0x50, 0x51, 0x56 }
+   };
+   PWRPageScheduler scheduler;
+   if (!scheduler.Configure(schedule)) return Fail(rate, 0, "schedule rejected", schedule.main_interval);
+   scheduler.SetSupportedPages(s_requestable, sizeof(s_requestable));
+
+   Outstanding outstanding[256] = {};
+   uint64_t last_seen[256];
+   for (unsigned p = 0; p < 256; p++) last_seen[p] = 0;
+   unsigned non_main_run = 0;
+   uint64_t accepted = 0, served = 0, refused = 0;
+
+   // The tail runs without new requests so everything accepted drains.
+   for (uint64_t tick = 1; tick <= ticks + TEST_REQUEST_DEADLINE; tick++)
+   {
+      if (tick <= ticks && NextRandom() % TEST_REQUEST_ODDS == 0)
+      {
+         uint8_t page = s_requestable[NextRandom() % sizeof(s_requestable)];
+         uint8_t count = (uint8_t)(1 + NextRandom() % TEST_MAX_COUNT);
+         if (scheduler.Request(page, count))
+         {
+            outstanding[page].remaining = count;
+            outstanding[page].deadline = tick + TEST_REQUEST_DEADLINE;
+            accepted++;
+         }
+         else
+         {
+            refused++;
+         }
+      }
+
+      uint8_t page = scheduler.Next();
+      if (page == 0x10)
+      {
+         non_main_run = 0;
+      }
+      else if (++non_main_run > PWR_SCHEDULE_MAX_NON_MAIN)
+      {
+         return Fail(rate, tick, "consecutive non-main pages", non_main_run);
+      }
+
+      Outstanding& owed = outstanding[page];
+      if (owed.remaining != 0)
+      {
+         // Rotation pages may be a background slot rather than the answer;
+         // either way the requester sees the page, so it counts.
+         owed.remaining--;
+         served++;
+      }
+      else if (!InRotation(page) && page != 0x10)
+      {
+         return Fail(rate, tick, "page sent without a request", page);
+      }
+
+      for (unsigned p = 0; p < sizeof(s_requestable); p++)
+      {
+         const Outstanding& o = outstanding[s_requestable[p]];
+         if (o.remaining != 0 && tick > o.deadline)
+            return Fail(rate, tick, "request not served in time, page", s_requestable[p]);
+      }
+      if (page == 0x50 || page == 0x51)
+      {
+         if (tick - last_seen[page] > TEST_MAX_GAP_50_51) return Fail(rate, tick, "common page gap, page", page);
+      }
+      last_seen[page] = tick;
+      if (tick - last_seen[0x50] > TEST_MAX_GAP_50_51) return Fail(rate, tick, "page 0x50 missing", 0x50);
+      if (tick - last_seen[0x51] > TEST_MAX_GAP_50_51) return Fail(rate, tick, "page 0x51 missing", 0x51);
+   }
+   if (last_seen[0x52] == 0 || last_seen[0x56] == 0) return Fail(rate, ticks, "0x52/0x56 never rotated in", 0);
+
+   printf("%s: %llu ticks, background every %u messages, %llu requests (%llu refused, queue full), %llu responses\n",
+          rate, (unsigned long long)ticks, schedule.main_interval, (unsigned long long)accepted,
+          (unsigned long long)refused, (unsigned long long)served);
+   return 0;
+}
+
+int main(int argc, char** argv)
+{
+   uint64_t ticks = argc > 1 ? strtoull(argv[1], NULL, 0) : TEST_DEFAULT_TICKS;
+   s_state = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+   if (s_state == 0) s_state = 1;
+
+   int failed = 0;
+   failed |= RunRate("8 Hz", PWR_MSG_PERIOD_8Hz, ticks);
+   failed |= RunRate("4 Hz", PWR_MSG_PERIOD_4Hz, ticks);
+   failed |= RunRate("2 Hz", PWR_MSG_PERIOD_2Hz, ticks);
+   printf(failed ? "scheduler test FAILED\n" : "scheduler test passed\n");
+   return failed;
+}
@@ -46,6 +46,9 @@ SOFTWARE.
 */
 
 #include "ANTProfile.h"
+#include <string.h>
+
+void (*ANTProfile::s_tx_tap)(uint8_t channel, uint8_t const* payload) = NULL;
 
  const  __FlashStringHelper *   AntEventTypeDecode(const ant_evt_t *evt)
 {
@@ -325,31 +328,86 @@ const  __FlashStringHelper *  AntEventType2LongDescription(const ant_evt_t *evt)
 
 ANTProfile::ANTProfile(ANTTransmissionMode mode)
 {
+   // Profiles are also built on the heap (trace replay), so nothing may rely
+   // on static zero-fill. Setup() assigns the real channel number.
    m_op_mode = mode;
+   m_channel_number = 0;
+   memset(m_message_payload, 0, sizeof(m_message_payload));
+   memset(&m_channel_sens_config, 0, sizeof(m_channel_sens_config));
+   memset(&m_disp_config, 0, sizeof(m_disp_config));
 }
 
 void ANTProfile::ProcessMessage(ant_evt_t* evt)
+{
+   if (!ProcessTimeCritical(evt))
+   {
+      ProcessDeferred(evt);
+   }
+}
+
+bool ANTProfile::ProcessTimeCritical(ant_evt_t* evt)
+{
+   if (evt->channel != m_channel_number)
+   {
+      return true;
+   }
+   switch (evt->event)
+   {
+      case EVENT_TX                                    : // ((uint8_t)0x03)   ///< ANT stack generated event when synchronous tx channel has occurred
+      {
+         uint32_t tx_cycles = PerfTrace::Now();
+         SendMessage(FinalizeTxFrame());
+         uint32_t sent_cycles = PerfTrace::Now();
+         Perf.Record(PERF_TX_TO_SENT, tx_cycles, sent_cycles);
+         OnFrameSent(tx_cycles, sent_cycles);
+         PrepareNextMessage();
+         return true;
+      }
+
+      case EVENT_CHANNEL_CLOSED                        : // ((uint8_t)0x07)   ///< ANT stack generated event when channel has closed
+         if (m_pending_period != 0)
+         {
+            // Closed by ChangeChannelPeriod(): reopen here and keep the
+            // event from the listeners, which reopen unexpected closes.
+            uint16_t period = m_pending_period;
+            m_pending_period = 0;
+            m_channel_sens_config.channel_period = period;
+            m_disp_config.channel_period = period;
+            sd_ant_channel_period_set(m_channel_number, period);
+            OnChannelPeriodChanged(period);
+            sd_ant_channel_open(m_channel_number);
+            return true;
+         }
+         return false;
+
+      default:
+         return false;
+   }
+}
+
+void ANTProfile::ProcessDeferred(ant_evt_t* evt)
 {
    if (evt->channel == m_channel_number)
    {
       switch (evt->event)
       {
-            case EVENT_TX                                    : // ((uint8_t)0x03)   ///< ANT stack generated event when synchronous tx channel has occurred
-               EncodeMessage();
-               SendMessage();
-               break;
-
             case EVENT_RX                                    : // ((uint8_t)0x80)   ///< ANT stack generated event indicating received data (eg. broadcast, acknowledge, burst) from the channel
                if (evt->message.ANT_MESSAGE_ucMesgID == MESG_BROADCAST_DATA_ID
                || evt->message.ANT_MESSAGE_ucMesgID == MESG_ACKNOWLEDGED_DATA_ID
                || evt->message.ANT_MESSAGE_ucMesgID == MESG_BURST_DATA_ID)
                {
+                  // Requests change the page schedule and cached frames that
+                  // the ANT task reads; it outranks this task, so only this
+                  // side needs to keep it out while the decode runs.
+                  taskENTER_CRITICAL();
                   DecodeMessage(evt->message.ANT_MESSAGE_aucPayload);
+                  taskEXIT_CRITICAL();
                   newRxData = true;
-                  newTicks = xTaskGetTickCountFromISR();
+                  newTicks = xTaskGetTickCount();
                }
                break;
 
+            case EVENT_CHANNEL_CLOSED                        : // ((uint8_t)0x07)   ///< ANT stack generated event when channel has closed
             case RESPONSE_NO_ERROR                           : // ((uint8_t)0x00)   ///< Command response with no error
             //case NO_EVENT                                    : // ((uint8_t)0x00)   ///< No Event
             case EVENT_RX_SEARCH_TIMEOUT                     : // ((uint8_t)0x01)   ///< ANT stack generated event when rx searching state for the channel has timed out
@@ -357,7 +415,6 @@ void ANTProfile::ProcessMessage(ant_evt_t* evt)
             case EVENT_TRANSFER_RX_FAILED                    : // ((uint8_t)0x04)   ///< ANT stack generated event when the completion of rx transfer has failed
             case EVENT_TRANSFER_TX_COMPLETED                 : // ((uint8_t)0x05)   ///< ANT stack generated event when the completion of tx transfer has succeeded
             case EVENT_TRANSFER_TX_FAILED                    : // ((uint8_t)0x06)   ///< ANT stack generated event when the completion of tx transfer has failed
-            case EVENT_CHANNEL_CLOSED                        : // ((uint8_t)0x07)   ///< ANT stack generated event when channel has closed
             case EVENT_RX_FAIL_GO_TO_SEARCH                  : // ((uint8_t)0x08)   ///< ANT stack generated event when synchronous rx channel has lost tracking and is entering rx searching state
             case EVENT_CHANNEL_COLLISION                     : // ((uint8_t)0x09)   ///< ANT stack generated event during a multi-channel setup where an instance of the current synchronous channel is blocked by another synchronous channel
             case EVENT_TRANSFER_TX_START                     : // ((uint8_t)0x0A)   ///< ANT stack generated event when the start of tx transfer is occuring
@@ -406,9 +463,6 @@ uint32_t ANTProfile::Setup(uint8_t channel)
 
    if (m_op_mode == ANTTransmissionMode::TX)
    {
-      // Fill tx buffer for the first frame
-      EncodeMessage();
-
       uint32_t err_code;
       // Set Channel Number.
       err_code = sd_ant_channel_assign(m_channel_sens_config.channel_number,
@@ -448,7 +502,9 @@ uint32_t ANTProfile::Setup(uint8_t channel)
          return err_code;
       }
 
-      SendMessage();
+      // First frame
+      SendMessage(FinalizeTxFrame());
+      PrepareNextMessage();
     }
     else if (m_op_mode == ANTTransmissionMode::RX)
     {
@@ -464,13 +520,55 @@ uint32_t ANTProfile::Setup(uint8_t channel)
     {
         return err_code;
     }
+    m_channel_open = true;
 
    return NRF_SUCCESS;
 }
 
+uint32_t ANTProfile::ChangeChannelPeriod(uint16_t period)
+{
+   if (period == 0)
+   {
+      return NRF_ERROR_INVALID_PARAM;
+   }
+   if (period == m_channel_sens_config.channel_period && m_pending_period == 0)
+   {
+      return NRF_SUCCESS;
+   }
+   if (!m_channel_open)
+   {
+      m_channel_sens_config.channel_period = period;
+      m_disp_config.channel_period = period;
+      OnChannelPeriodChanged(period);
+      return NRF_SUCCESS;
+   }
+   m_pending_period = period;
+   uint32_t err_code = sd_ant_channel_close(m_channel_number);
+   if (err_code != NRF_SUCCESS)
+   {
+      // Not open right now (closed and not reopened yet): no close event
+      // will come, so apply the period directly.
+      m_pending_period = 0;
+      m_channel_sens_config.channel_period = period;
+      m_disp_config.channel_period = period;
+      err_code = sd_ant_channel_period_set(m_channel_number, period);
+      OnChannelPeriodChanged(period);
+   }
+   return err_code;
+}
+
 uint32_t ANTProfile::SendMessage()
 {
-   uint32_t err_code = sd_ant_broadcast_message_tx(m_channel_number, sizeof(m_message_payload), m_message_payload);
+   return SendMessage(m_message_payload);
+}
+
+uint32_t ANTProfile::SendMessage(uint8_t const* payload)
+{
+   uint32_t err_code = sd_ant_broadcast_message_tx(m_channel_number, ANT_STANDARD_DATA_PAYLOAD_SIZE, (uint8_t*)payload);
+   if (err_code == NRF_SUCCESS && s_tx_tap != NULL)
+   {
+      s_tx_tap(m_channel_number, payload);
+   }
 
    return err_code;
 }
@@ -69,6 +69,7 @@ SOFTWARE.
 #include "ant_channel_config.h"
 #include <Arduino.h>
 #include <avr/pgmspace.h>
+#include "PerfTrace.h"
 
 #define ANTPLUS_NETWORK_NUMBER  0                           /**< Network number. */
 #define MAIN_DATA_INTERVAL          4       /**< The number of background data pages sent between main data pages.*/
@@ -91,6 +92,7 @@ class ANTProfile
 public:
 
    ANTProfile(ANTTransmissionMode mode);
+   virtual ~ANTProfile() {}
 
    //profile operartions 
    uint32_t Setup(uint8_t channel);
@@ -100,9 +102,39 @@ public:
    const char* getName(void) {return name;}
    uint8_t getChannelNumber(void) { return m_channel_number;}
 
+   /**@brief Sets the device number of the channel ID. Call before Setup(). */
+   void SetDeviceNumber(uint16_t device_number)
+   {
+      m_channel_sens_config.device_number = device_number;
+      m_disp_config.device_number = device_number;
+   }
+   uint16_t GetDeviceNumber(void) { return m_channel_sens_config.device_number; }
+
+   /**@brief Changes the channel period. Before Setup() this only changes the
+    *        configuration; on an open channel it closes the channel and
+    *        the EVENT_CHANNEL_CLOSED handler applies the period and reopens.
+    */
+   uint32_t ChangeChannelPeriod(uint16_t period);
+   uint16_t GetChannelPeriod(void) { return m_channel_sens_config.channel_period; }
+
+   /**@brief Handles evt completely, in the calling context. */
    void ProcessMessage(ant_evt_t* evt);
+   /**@brief The part of an event that has to be served before the next
+    *        radio slot: EVENT_TX and the close issued by ChangeChannelPeriod().
+    * @return true if evt was consumed, false if it still needs ProcessDeferred().
+    */
+   bool ProcessTimeCritical(ant_evt_t* evt);
+   /**@brief Everything else: RX decode, requests and the event listeners.
+    *        Runs in a lower-priority task than ProcessTimeCritical().
+    */
+   void ProcessDeferred(ant_evt_t* evt);
    void setUnhandledEventListener(void (*fp)(ant_evt_t* evt)) { _AntUnhandledEventLister = fp; };
    void setAllEventListener(void (*fp)(ant_evt_t* evt)) { _AntAllEventLister = fp; };
+   /**@brief Sets a hook called with every payload handed to the SoftDevice,
+    *        on all channels, in the context of the send (the ANT task once
+    *        the channels are open). It must not block.
+    */
+   static void SetTxTap(void (*fp)(uint8_t channel, uint8_t const* payload)) { s_tx_tap = fp; }
    //void setCustomDataPtr(void* ptr) { m_customDataPtr = ptr;}
    //void* getCustomDataPtr(void) {return m_customDataPtr;} 
    bool newRxData = false;
@@ -112,14 +144,31 @@ protected:
 
    virtual void DecodeMessage(uint8_t* buffer) = 0;
    virtual void EncodeMessage() = 0;
+   /**@brief Returns the frame to broadcast on this EVENT_TX. The default
+    *        encodes into m_message_payload; profiles that pre-build their
+    *        frames only finish and hand over the ready one here.
+    */
+   virtual uint8_t const* FinalizeTxFrame() { EncodeMessage(); return m_message_payload; }
+   /**@brief Called after the broadcast to build the next frame ahead of time. */
+   virtual void PrepareNextMessage() {}
+   /**@brief Called in the ANT task right after the EVENT_TX broadcast, with
+    *        the PerfTrace stamps of the event and of the send returning.
+    */
+   virtual void OnFrameSent(uint32_t tx_cycles, uint32_t sent_cycles) { (void)tx_cycles; (void)sent_cycles; }
+   /**@brief Called in the ANT task once a new channel period is in effect. */
+   virtual void OnChannelPeriodChanged(uint16_t period) { (void)period; }
    uint32_t SendMessage();
+   uint32_t SendMessage(uint8_t const* payload);
    void (*_AntUnhandledEventLister)(ant_evt_t* evt) = NULL; 
    void (*_AntAllEventLister)(ant_evt_t* evt) = NULL; 
+   static void (*s_tx_tap)(uint8_t channel, uint8_t const* payload);
    const char *  name = "";
 
    uint8_t m_channel_number; ///< Channel number assigned to the profile.
    uint8_t m_message_payload[ANT_STANDARD_DATA_PAYLOAD_SIZE];
    ANTTransmissionMode m_op_mode;
+   bool m_channel_open = false;             ///< Setup() has configured and opened the channel.
+   volatile uint16_t m_pending_period = 0;   ///< Period to apply on the next EVENT_CHANNEL_CLOSED, 0 if none.
 
    ant_channel_config_t m_channel_sens_config;
    ant_channel_config_t m_disp_config;
@@ -129,44 +178,4 @@ private:
 
 };
 
-
-
-class ANTProfileEntry
-{
-public:
-
-   ANTProfileEntry(ANTProfile* e = NULL)
-   {
-      m_entry = e;
-      m_next = NULL;
-   }
-
-   ANTProfile* m_entry;
-   ANTProfileEntry* m_next;
-};
-
-
-class ANTProfileList
-{
-public:
-
-   ANTProfileList()
-   {
-      m_head = NULL;
-      m_tail = NULL;
-   }
-
-   void AddProfile(ANTProfile* p)
-   {
-      ANTProfileEntry* entry = new ANTProfileEntry(p);
-      if (m_tail == NULL)
-         m_head = entry;
-      else
-         m_tail->m_next = entry;
-      m_tail = entry;
-   }
-
-   ANTProfileEntry* m_head;
-   ANTProfileEntry* m_tail;
-};
 #endif
\ No newline at end of file
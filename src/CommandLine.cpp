@@ -0,0 +1,94 @@
+#include "CommandLine.h"
+
+CommandLine::CommandLine() :
+   m_length(0),
+   m_complete(false),
+   m_discarding(false),
+   m_overflow_count(0)
+{
+   m_buffer[0] = '\0';
+}
+
+bool CommandLine::Feed(char c)
+{
+   if (m_complete)
+   {
+      m_complete = false;
+      m_length = 0;
+   }
+
+   if (c == '\r' || c == '\n')
+   {
+      bool ready = !m_discarding && m_length > 0;
+      m_discarding = false;
+      m_buffer[m_length] = '\0';
+      if (!ready)
+      {
+         m_length = 0;
+         return false;
+      }
+      m_complete = true;
+      return true;
+   }
+
+   if (m_discarding)
+   {
+      return false;
+   }
+   if (m_length >= CMDLINE_SIZE - 1)
+   {
+      m_discarding = true;
+      m_length = 0;
+      m_overflow_count++;
+      return false;
+   }
+   m_buffer[m_length++] = c;
+   return false;
+}
+
+static bool IsSeparator(char c)
+{
+   return c == ' ' || c == '\t' || c == ':' || c == '=';
+}
+
+uint8_t CommandLine::Tokenize(char* line, char** argv, uint8_t max_args)
+{
+   uint8_t argc = 0;
+   char* p = line;
+   while (*p != '\0' && argc < max_args)
+   {
+      while (IsSeparator(*p)) *p++ = '\0';
+      if (*p == '\0') break;
+      argv[argc++] = p;
+      while (*p != '\0' && !IsSeparator(*p)) p++;
+   }
+   if (*p != '\0') *p = '\0';   // Terminate the last token, ignore the rest
+   return argc;
+}
+
+bool CommandLine::Matches(const char* token, const char* keyword)
+{
+   if (token == nullptr) return false;
+   for (; *keyword != '\0'; token++, keyword++)
+   {
+      char c = *token;
+      if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+      if (c != *keyword) return false;
+   }
+   return *token == '\0';
+}
+
+bool CommandLine::ParseUInt(const char* text, uint32_t* value)
+{
+   if (text == nullptr || *text == '\0') return false;
+   uint32_t result = 0;
+   for (const char* p = text; *p != '\0'; p++)
+   {
+      if (*p < '0' || *p > '9') return false;
+      uint32_t digit = (uint32_t)(*p - '0');
+      if (result > (UINT32_MAX - digit) / 10u) return false;
+      result = result * 10u + digit;
+   }
+   *value = result;
+   return true;
+}
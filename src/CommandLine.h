@@ -0,0 +1,55 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <stdint.h>
+
+#ifndef CMDLINE_SIZE
+#define CMDLINE_SIZE            64      ///< Longest command line, including the terminator.
+#endif
+#define CMDLINE_MAX_ARGS        4       ///< Tokens per line, command name included.
+
+/**@brief Incremental console line assembler with a fixed buffer.
+ *
+ * Feed() takes one byte at a time, so the caller can hand over whatever the
+ * UART has buffered and return immediately; nothing waits for the rest of
+ * a line and nothing is allocated. Bytes are stored as typed, so file names
+ * and other arguments keep their case; compare command names and keywords
+ * with Matches().
+ * A line longer than the buffer is discarded up to its end of line and
+ * counted in GetOverflowCount().
+ */
+class CommandLine
+{
+public:
+   CommandLine();
+
+   /**@brief Appends c. CR, LF and CRLF all end a line.
+    * @return true when a complete, non-empty line is ready in Line().
+    */
+   bool Feed(char c);
+
+   /// The completed line; valid until the next Feed().
+   char* Line(void) { return m_buffer; }
+
+   uint32_t GetOverflowCount(void) const { return m_overflow_count; }
+
+   /**@brief Splits line in place at spaces, tabs, ':' and '='.
+    * @return Number of tokens stored in argv (at most max_args).
+    */
+   static uint8_t Tokenize(char* line, char** argv, uint8_t max_args);
+
+   /// True when token equals the lowercase keyword, ignoring the token's case.
+   static bool Matches(const char* token, const char* keyword);
+
+   /// Parses a decimal unsigned integer; false on anything else.
+   static bool ParseUInt(const char* text, uint32_t* value);
+
+private:
+   char m_buffer[CMDLINE_SIZE];
+   uint8_t m_length;
+   bool m_complete;            ///< m_buffer holds a finished line.
+   bool m_discarding;          ///< Dropping the rest of an overlong line.
+   uint32_t m_overflow_count;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "CrankCapture.h"
+
+#ifndef POWERMETER_HOST
+#include <nrf.h>
+#include <nrf_soc.h>
+#endif
+
+CrankCapture Crank;
+
+CrankCapture::CrankCapture() :
+   m_pin(CRANK_PIN_NONE),
+   m_have_last(false),
+   m_last_us(0),
+   m_edges(0),
+   m_bounces(0)
+{
+}
+
+#ifdef POWERMETER_HOST
+static void HostEdge(void)
+{
+   Crank.OnEdge(micros());
+}
+#else
+extern "C" void CRANK_EGU_IRQHandler(void)
+{
+   CRANK_EGU->EVENTS_TRIGGERED[0] = 0;
+   (void)CRANK_EGU->EVENTS_TRIGGERED[0];   // Flush the clear before returning.
+   // Read after the trigger: a second edge already in flight overwrites CC[0]
+   // and pends another interrupt, which the debounce then drops.
+   Crank.OnEdge(CRANK_TIMER->CC[0]);
+}
+#endif
+
+bool CrankCapture::begin(uint8_t pin)
+{
+   end();
+   if (pin == CRANK_PIN_NONE) return false;
+   m_have_last = false;
+   m_edges = 0;
+   m_bounces = 0;
+   pinMode(pin, INPUT_PULLUP);
+
+#ifdef POWERMETER_HOST
+   attachInterrupt(pin, HostEdge, FALLING);
+#else
+   CRANK_TIMER->TASKS_STOP = 1;
+   CRANK_TIMER->MODE = TIMER_MODE_MODE_Timer;
+   CRANK_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit << TIMER_BITMODE_BITMODE_Pos;
+   CRANK_TIMER->PRESCALER = 4;                 // 16 MHz / 2^4 = CRANK_TIMER_HZ
+   CRANK_TIMER->TASKS_CLEAR = 1;
+
+   NRF_GPIOTE->CONFIG[CRANK_GPIOTE_CHANNEL] =
+      (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos) |
+      ((uint32_t)g_ADigitalPinMap[pin] << GPIOTE_CONFIG_PSEL_Pos) |
+      (GPIOTE_CONFIG_POLARITY_HiToLo << GPIOTE_CONFIG_POLARITY_Pos);
+   NRF_GPIOTE->EVENTS_IN[CRANK_GPIOTE_CHANNEL] = 0;
+
+   // The timestamp is taken by PPI, so the interrupt can run at low priority.
+   CRANK_EGU->EVENTS_TRIGGERED[0] = 0;
+   CRANK_EGU->INTENSET = EGU_INTENSET_TRIGGERED0_Msk;
+   NVIC_SetPriority(CRANK_EGU_IRQn, 6);
+   NVIC_ClearPendingIRQ(CRANK_EGU_IRQn);
+   NVIC_EnableIRQ(CRANK_EGU_IRQn);
+
+   // PPI belongs to the SoftDevice once it is enabled.
+   volatile uint32_t* edge = &NRF_GPIOTE->EVENTS_IN[CRANK_GPIOTE_CHANNEL];
+   uint32_t err = sd_ppi_channel_assign(CRANK_PPI_CAPTURE, edge, &CRANK_TIMER->TASKS_CAPTURE[0]);
+   if (err == NRF_SUCCESS) err = sd_ppi_channel_assign(CRANK_PPI_NOTIFY, edge, &CRANK_EGU->TASKS_TRIGGER[0]);
+   if (err == NRF_SUCCESS) err = sd_ppi_channel_enable_set((1u << CRANK_PPI_CAPTURE) | (1u << CRANK_PPI_NOTIFY));
+   if (err != NRF_SUCCESS)
+   {
+      NVIC_DisableIRQ(CRANK_EGU_IRQn);
+      CRANK_EGU->INTENCLR = EGU_INTENCLR_TRIGGERED0_Msk;
+      NRF_GPIOTE->CONFIG[CRANK_GPIOTE_CHANNEL] = 0;
+      return false;
+   }
+   CRANK_TIMER->TASKS_START = 1;
+#endif
+
+   m_pin = pin;
+   return true;
+}
+
+void CrankCapture::end(void)
+{
+   if (m_pin == CRANK_PIN_NONE) return;
+#ifdef POWERMETER_HOST
+   detachInterrupt(m_pin);
+#else
+   sd_ppi_channel_enable_clr((1u << CRANK_PPI_CAPTURE) | (1u << CRANK_PPI_NOTIFY));
+   NVIC_DisableIRQ(CRANK_EGU_IRQn);
+   CRANK_EGU->INTENCLR = EGU_INTENCLR_TRIGGERED0_Msk;
+   NRF_GPIOTE->CONFIG[CRANK_GPIOTE_CHANNEL] = 0;
+   CRANK_TIMER->TASKS_STOP = 1;
+#endif
+   m_pin = CRANK_PIN_NONE;
+}
+
+void CrankCapture::OnEdge(uint32_t capture_us)
+{
+   m_edges++;
+   uint32_t period = capture_us - m_last_us;
+   if (m_have_last && period < CRANK_MIN_PERIOD_US)
+   {
+      m_bounces++;
+      return;
+   }
+
+   crank_event_t event;
+   event.time_us = capture_us;
+   event.period_us = m_have_last && period <= CRANK_STOP_US ? period : 0;
+   m_have_last = true;
+   m_last_us = capture_us;
+   m_queue.Push(event);
+}
+
+void CrankCapture::GetStats(crank_stats_t* stats) const
+{
+   stats->edges = m_edges;
+   stats->bounces = m_bounces;
+   stats->revolutions = m_queue.GetPushCount();
+   stats->overflows = m_queue.GetOverflowCount();
+}
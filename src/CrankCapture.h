@@ -0,0 +1,90 @@
+#ifndef CRANKCAPTURE_H
+#define CRANKCAPTURE_H
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "SpscRing.h"
+
+#define CRANK_PIN_NONE          0xFF    ///< powermeter_config::hallPin value for "no sensor".
+#define CRANK_TIMER_HZ          1000000 ///< Capture timer rate; periods are in microseconds.
+#define CRANK_MIN_PERIOD_US     200000  ///< Edges closer than this (300 rpm) are bounce.
+#define CRANK_STOP_US           4000000 ///< Longer gaps (15 rpm) restart the period chain.
+#define CRANK_QUEUE_SIZE        16      ///< Must be a power of two.
+
+// nRF52 resources owned by the capture path. The Arduino core's
+// attachInterrupt() allocates GPIOTE channels from 0 upward and the
+// SoftDevice reserves PPI channels 17..19, so the top free ones are used.
+#ifndef POWERMETER_HOST
+#define CRANK_TIMER             NRF_TIMER3
+#define CRANK_GPIOTE_CHANNEL    7
+#define CRANK_PPI_CAPTURE       14      ///< GPIOTE IN -> TIMER CAPTURE[0]
+#define CRANK_PPI_NOTIFY        15      ///< GPIOTE IN -> EGU TRIGGER[0]
+#define CRANK_EGU               NRF_EGU3
+#define CRANK_EGU_IRQn          SWI3_EGU3_IRQn
+#define CRANK_EGU_IRQHandler    SWI3_EGU3_IRQHandler
+#endif
+
+/**@brief One accepted crank revolution. */
+typedef struct
+{
+   uint32_t time_us;    ///< Capture timer value at the edge (wraps after ~71 min).
+   uint32_t period_us;  ///< Time since the previous accepted edge, 0 for the first after a stop.
+} crank_event_t;
+
+/**@brief Capture statistics since begin(). */
+typedef struct
+{
+   uint32_t edges;      ///< Every falling edge seen by the interrupt.
+   uint32_t bounces;    ///< Edges rejected by the minimum-period debounce.
+   uint32_t revolutions;///< Edges queued (first-after-stop included).
+   uint32_t overflows;  ///< Revolutions lost to a full queue.
+} crank_stats_t;
+
+/**@brief Hall-sensor crank input with hardware timestamps.
+ *
+ * On the nRF52 a falling edge on the sensor pin raises a GPIOTE event that
+ * PPI routes to two tasks at once: CAPTURE[0] on a free-running 1 MHz timer,
+ * so the timestamp is taken by hardware with no interrupt latency, and an
+ * EGU trigger whose interrupt reads the captured value. Millisecond polling
+ * from loop() would add +/-1 ms to every period, several rpm at 120 rpm.
+ *
+ * The interrupt debounces by period: an edge less than CRANK_MIN_PERIOD_US
+ * after the last accepted one is counted as a bounce and dropped (a reed
+ * switch or a marginal magnet gap produces bursts of edges microseconds
+ * apart). Accepted edges go to a lock-free SpscRing; the interrupt is the
+ * only producer and the consumer is PowerMeter::update().
+ *
+ * The host build has no capture hardware. The GPIO stand-in calls the
+ * attachInterrupt() handler at the edge's exact virtual time, so micros()
+ * read in the handler is the capture value.
+ */
+class CrankCapture
+{
+public:
+   CrankCapture();
+
+   /**@brief Configures the pin (with pull-up) and starts capturing. */
+   bool begin(uint8_t pin);
+   void end(void);
+   bool IsRunning(void) const { return m_pin != CRANK_PIN_NONE; }
+
+   /**@brief Consumer side: the next accepted revolution, oldest first. */
+   bool Pop(crank_event_t& event) { return m_queue.Pop(event); }
+
+   void GetStats(crank_stats_t* stats) const;
+
+   /**@brief Interrupt body: debounces one edge captured at capture_us. */
+   void OnEdge(uint32_t capture_us);
+
+private:
+   uint8_t  m_pin;
+   bool     m_have_last;        ///< m_last_us holds an accepted edge.
+   uint32_t m_last_us;
+   volatile uint32_t m_edges;   ///< Interrupt-owned statistics.
+   volatile uint32_t m_bounces;
+   SpscRing<crank_event_t, CRANK_QUEUE_SIZE> m_queue;
+};
+
+extern CrankCapture Crank;
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef CYCLECOUNTER_H
+#define CYCLECOUNTER_H
+
+#include <stdint.h>
+
+#ifdef POWERMETER_HOST
+#include <time.h>
+#else
+#include <nrf.h>
+#endif
+
+/**@brief Free-running 32-bit timestamp counter for short measurements.
+ *
+ * On the nRF52 this is the Cortex-M4 DWT cycle counter (CYCCNT), which
+ * counts CPU cycles and wraps after ~67 s at 64 MHz. The host build counts
+ * nanoseconds of CLOCK_MONOTONIC instead, so GetHz() is 1 GHz there and
+ * "cycles" are nanoseconds. Differences of two Now() values are valid
+ * across a single wrap.
+ */
+class CycleCounter
+{
+public:
+   /**@brief Starts the counter if it is not running yet; safe to call again.
+    *
+    * The count is never reset: PerfTrace stamps may be in flight when a
+    * later caller (e.g. the bench command) enables it, and only Now()
+    * differences are meaningful anyway.
+    */
+   static void Enable(void)
+   {
+#ifndef POWERMETER_HOST
+      if ((CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) && (DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)) return;
+      CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+      DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+   }
+
+   static inline uint32_t Now(void)
+   {
+#ifdef POWERMETER_HOST
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+#else
+      return DWT->CYCCNT;
+#endif
+   }
+
+   static inline uint32_t GetHz(void)
+   {
+#ifdef POWERMETER_HOST
+      return 1000000000u;
+#else
+      return SystemCoreClock;
+#endif
+   }
+
+   /// True when Now() counts real CPU cycles rather than a time base.
+   static inline bool CountsCycles(void)
+   {
+#ifdef POWERMETER_HOST
+      return false;
+#else
+      return true;
+#endif
+   }
+
+   static inline uint32_t ToNanos(uint32_t cycles)
+   {
+      return (uint32_t)(((uint64_t)cycles * 1000000000ull) / GetHz());
+   }
+};
+
+#endif
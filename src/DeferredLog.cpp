@@ -0,0 +1,84 @@
+#include "DeferredLog.h"
+
+static_assert((DLOG_RING_SIZE & (DLOG_RING_SIZE - 1)) == 0, "DLOG_RING_SIZE must be a power of two");
+
+DeferredLog DLog;
+
+static void dlog_task(void* arg);
+
+DeferredLog::DeferredLog() :
+   m_head(0),
+   m_tail(0),
+   m_dropped(0),
+   m_dropped_reported(0)
+{}
+
+bool DeferredLog::begin(void)
+{
+   TaskHandle_t log_task_hdl;
+   return xTaskCreate(dlog_task, "LOG", CFG_DLOG_TASK_STACKSIZE, NULL, TASK_PRIO_LOWEST, &log_task_hdl) == pdPASS;
+}
+
+void DeferredLog::Write(const char* fmt, uint8_t nargs, const uint32_t* args)
+{
+   // Writers live in several tasks (loop, BLE, ANT); the slot reservation and
+   // the 28 byte copy are the only work done under the critical section.
+   taskENTER_CRITICAL();
+   uint32_t head = m_head;
+   if (head - __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE) >= DLOG_RING_SIZE)
+   {
+      m_dropped++;
+   }
+   else
+   {
+      dlog_record_t* rec = &m_ring[head & (DLOG_RING_SIZE - 1)];
+      rec->fmt = fmt;
+      rec->timestamp = millis();
+      rec->nargs = nargs;
+      for (uint8_t i = 0; i < nargs; i++) rec->args[i] = args[i];
+      __atomic_store_n(&m_head, head + 1, __ATOMIC_RELEASE);
+   }
+   taskEXIT_CRITICAL();
+}
+
+uint32_t DeferredLog::GetPendingCount(void) const
+{
+   return __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) - m_tail;
+}
+
+uint32_t DeferredLog::Drain(uint32_t max_records)
+{
+   uint32_t count = 0;
+   while (count < max_records)
+   {
+      uint32_t tail = m_tail;
+      if (__atomic_load_n(&m_head, __ATOMIC_ACQUIRE) == tail) break;
+
+      dlog_record_t rec = m_ring[tail & (DLOG_RING_SIZE - 1)];
+      __atomic_store_n(&m_tail, tail + 1, __ATOMIC_RELEASE);
+
+      uint32_t a[DLOG_MAX_ARGS] = { 0 };
+      for (uint8_t i = 0; i < rec.nargs; i++) a[i] = rec.args[i];
+      Serial.printf("[%lu] ", (unsigned long)rec.timestamp);
+      Serial.printf(rec.fmt, a[0], a[1], a[2], a[3]);
+      Serial.println();
+      count++;
+   }
+
+   uint32_t dropped = m_dropped;
+   if (dropped != m_dropped_reported)
+   {
+      Serial.printf("(%lu log records dropped)\n", (unsigned long)(dropped - m_dropped_reported));
+      m_dropped_reported = dropped;
+   }
+   return count;
+}
+
+static void dlog_task(void* arg)
+{
+   (void)arg;
+   while (1)
+   {
+      if (DLog.Drain() == 0) vTaskDelay(pdMS_TO_TICKS(10));
+   }
+}
@@ -0,0 +1,78 @@
+#ifndef DEFERREDLOG_H
+#define DEFERREDLOG_H
+
+#include <stdint.h>
+#include <type_traits>
+#include <Arduino.h>
+
+#ifndef DLOG_RING_SIZE
+#define DLOG_RING_SIZE          64      ///< Number of records, must be a power of two.
+#endif
+#define DLOG_MAX_ARGS           4       ///< Raw 32-bit arguments per record.
+
+#ifndef CFG_DLOG_TASK_STACKSIZE
+#define CFG_DLOG_TASK_STACKSIZE (256 * 2)
+#endif
+
+/**@brief One deferred log record. The format string is never copied: its
+ *        address is the record's format ID and it must be a string literal.
+ */
+typedef struct
+{
+   const char* fmt;
+   uint32_t    timestamp;               ///< millis() when the record was written.
+   uint8_t     nargs;
+   uint32_t    args[DLOG_MAX_ARGS];
+} dlog_record_t;
+
+/**@brief Binary log ring: hot paths store a record in a few dozen cycles and
+ *        an idle-priority task formats the records to Serial later.
+ *
+ * Arguments are stored as raw 32-bit words, so format strings may only use
+ * 32-bit integer conversions (%d %u %x %X %c). Records written while the ring
+ * is full are dropped and counted; the drainer reports the count.
+ */
+class DeferredLog
+{
+public:
+   DeferredLog();
+
+   bool begin(void);
+
+   template <typename... Args>
+   void Log(const char* fmt, Args... args)
+   {
+      static_assert(sizeof...(Args) <= DLOG_MAX_ARGS, "too many deferred log arguments");
+      uint32_t raw[] = { 0u, ToRaw(args)... };
+      Write(fmt, (uint8_t)sizeof...(Args), raw + 1);
+   }
+
+   void Write(const char* fmt, uint8_t nargs, const uint32_t* args);
+
+   /**@brief Formats up to max_records pending records to Serial.
+    * @return Number of records formatted.
+    */
+   uint32_t Drain(uint32_t max_records = DLOG_RING_SIZE);
+
+   uint32_t GetDroppedCount(void) const { return m_dropped; }
+   uint32_t GetPendingCount(void) const;
+
+private:
+   template <typename T>
+   static uint32_t ToRaw(T v)
+   {
+      static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                    "deferred log arguments must be integers");
+      return (uint32_t)v;
+   }
+
+   dlog_record_t m_ring[DLOG_RING_SIZE];
+   uint32_t m_head;            ///< Advanced by writers inside a critical section.
+   uint32_t m_tail;            ///< Advanced by the drainer only.
+   uint32_t m_dropped;
+   uint32_t m_dropped_reported;
+};
+
+extern DeferredLog DLog;
+
+#endif
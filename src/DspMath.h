@@ -0,0 +1,82 @@
+#ifndef DSPMATH_H
+#define DSPMATH_H
+
+#include <stdint.h>
+
+#if !defined(POWERMETER_HOST) && defined(__ARM_FEATURE_DSP)
+#include <nrf.h>
+#define DSPMATH_USE_CMSIS 1
+#endif
+
+/**@brief Cortex-M4 DSP extension helpers with portable fallbacks.
+ *
+ * On the nRF52 these map to single-cycle SIMD/saturation instructions
+ * (USAT, UADD16, USUB16); the host build uses plain C with identical
+ * results. Packed helpers treat a 32-bit word as two independent unsigned
+ * 16-bit lanes that wrap modulo 2^16.
+ */
+namespace Dsp
+{
+   /// Clamps value to 0 .. 2^BITS - 1.
+   template <uint8_t BITS>
+   inline uint32_t SaturateUnsigned(int32_t value)
+   {
+      static_assert(BITS < 32, "Dsp::SaturateUnsigned: BITS must be below 32");
+#ifdef DSPMATH_USE_CMSIS
+      return __USAT(value, BITS);
+#else
+      if (value < 0) return 0;
+      return (uint32_t)value > ((1u << BITS) - 1u) ? ((1u << BITS) - 1u) : (uint32_t)value;
+#endif
+   }
+
+   /// Two 16-bit values in one word, hi in the upper lane.
+   inline uint32_t Pack16(uint16_t hi, uint16_t lo)
+   {
+      return ((uint32_t)hi << 16) | lo;
+   }
+
+   /// Lane-wise a + b.
+   inline uint32_t AddPacked16(uint32_t a, uint32_t b)
+   {
+#ifdef DSPMATH_USE_CMSIS
+      return __UADD16(a, b);
+#else
+      return Pack16((uint16_t)((a >> 16) + (b >> 16)), (uint16_t)(a + b));
+#endif
+   }
+
+   /// Lane-wise a - b.
+   inline uint32_t SubPacked16(uint32_t a, uint32_t b)
+   {
+#ifdef DSPMATH_USE_CMSIS
+      return __USUB16(a, b);
+#else
+      return Pack16((uint16_t)((a >> 16) - (b >> 16)), (uint16_t)(a - b));
+#endif
+   }
+
+   /// Floor of the square root of a 64-bit value.
+   inline uint32_t Isqrt64(uint64_t value)
+   {
+      uint64_t result = 0;
+      uint64_t bit = 1ull << 62;
+      while (bit > value) bit >>= 2;
+      while (bit != 0)
+      {
+         if (value >= result + bit)
+         {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+         }
+         else
+         {
+            result >>= 1;
+         }
+         bit >>= 2;
+      }
+      return (uint32_t)result;
+   }
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "DeferredLog.h"
+
+/*
+ Compile-time, per-subsystem log levels.
+
+ Every call site names its subsystem and level; the check is a constant
+ expression, so a call below the configured level leaves neither code nor
+ its format string in the image (the branch is dropped at -Os, which is how
+ the nRF52 core builds). Override any level on the command line or before
+ including this file, e.g. -DPM_LOG_LEVEL_XDS=PM_LOG_LEVEL_WARN.
+
+ PM_LOG_PRODUCTION lowers every default to warnings (console command output
+ stays at info), which removes all formatting from parsePowerData(),
+ update() and DecodeMessage(). Compare the size report of the two builds to
+ see what the logging costs in flash and RAM.
+*/
+
+#define PM_LOG_LEVEL_NONE   0
+#define PM_LOG_LEVEL_ERROR  1
+#define PM_LOG_LEVEL_WARN   2
+#define PM_LOG_LEVEL_INFO   3
+#define PM_LOG_LEVEL_DEBUG  4
+
+#ifdef PM_LOG_PRODUCTION
+   #define PM_LOG_LEVEL_DEFAULT  PM_LOG_LEVEL_WARN
+#else
+   #define PM_LOG_LEVEL_DEFAULT  PM_LOG_LEVEL_DEBUG
+#endif
+
+#ifndef PM_LOG_LEVEL_BLE
+#define PM_LOG_LEVEL_BLE     PM_LOG_LEVEL_DEFAULT   ///< Scanning, connection and GATT handling.
+#endif
+#ifndef PM_LOG_LEVEL_XDS
+#define PM_LOG_LEVEL_XDS     PM_LOG_LEVEL_DEFAULT   ///< XDS frame parsing and data quality.
+#endif
+#ifndef PM_LOG_LEVEL_ANT_TX
+#define PM_LOG_LEVEL_ANT_TX  PM_LOG_LEVEL_DEFAULT   ///< ANT+ page scheduling and broadcast.
+#endif
+#ifndef PM_LOG_LEVEL_ANT_RX
+#define PM_LOG_LEVEL_ANT_RX  PM_LOG_LEVEL_DEFAULT   ///< ANT+ page reception and decoding.
+#endif
+#ifndef PM_LOG_LEVEL_SDANT
+#define PM_LOG_LEVEL_SDANT   PM_LOG_LEVEL_DEFAULT   ///< ANT stack and channel events.
+#endif
+#ifndef PM_LOG_LEVEL_CMD
+#define PM_LOG_LEVEL_CMD     PM_LOG_LEVEL_INFO      ///< Serial console output.
+#endif
+
+typedef enum
+{
+   LOG_SUB_BLE,
+   LOG_SUB_XDS,
+   LOG_SUB_ANT_TX,
+   LOG_SUB_ANT_RX,
+   LOG_SUB_SDANT,
+   LOG_SUB_CMD
+} log_subsystem_t;
+
+template <log_subsystem_t S> struct LogLevelOf;
+template <> struct LogLevelOf<LOG_SUB_BLE>    { static constexpr uint8_t value = PM_LOG_LEVEL_BLE; };
+template <> struct LogLevelOf<LOG_SUB_XDS>    { static constexpr uint8_t value = PM_LOG_LEVEL_XDS; };
+template <> struct LogLevelOf<LOG_SUB_ANT_TX> { static constexpr uint8_t value = PM_LOG_LEVEL_ANT_TX; };
+template <> struct LogLevelOf<LOG_SUB_ANT_RX> { static constexpr uint8_t value = PM_LOG_LEVEL_ANT_RX; };
+template <> struct LogLevelOf<LOG_SUB_SDANT>  { static constexpr uint8_t value = PM_LOG_LEVEL_SDANT; };
+template <> struct LogLevelOf<LOG_SUB_CMD>    { static constexpr uint8_t value = PM_LOG_LEVEL_CMD; };
+
+template <log_subsystem_t S, uint8_t L>
+struct LogEnabled
+{
+   static constexpr bool value = (L != PM_LOG_LEVEL_NONE) && (L <= LogLevelOf<S>::value);
+};
+
+/// Constant expression: is SUB logging at LEVEL compiled in?
+#define PM_LOG_ENABLED(SUB, LEVEL)  (LogEnabled<LOG_SUB_##SUB, PM_LOG_LEVEL_##LEVEL>::value)
+
+/// Immediate printf to Serial. For cold paths only (setup, console, errors).
+#define PM_LOG(SUB, LEVEL, ...) \
+   do { if (PM_LOG_ENABLED(SUB, LEVEL)) { Serial.printf(__VA_ARGS__); } } while (0)
+
+/// Immediate println to Serial.
+#define PM_LOGLN(SUB, LEVEL, str) \
+   do { if (PM_LOG_ENABLED(SUB, LEVEL)) { Serial.println(str); } } while (0)
+
+/// Deferred record in the DLog ring (see DeferredLog.h for argument rules).
+#define PM_DLOG(SUB, LEVEL, ...) \
+   do { if (PM_LOG_ENABLED(SUB, LEVEL)) { DLog.Log(__VA_ARGS__); } } while (0)
+
+#endif
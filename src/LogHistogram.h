@@ -0,0 +1,96 @@
+#ifndef LOGHISTOGRAM_H
+#define LOGHISTOGRAM_H
+
+#include <stdint.h>
+
+/**@brief Fixed-RAM histogram of 32-bit values with log-linear buckets.
+ *
+ * Values below 2^(SUB_BITS+1) get one bucket each; above that every power
+ * of two is split into 2^SUB_BITS equal buckets, so a bucket is never wider
+ * than 1/2^SUB_BITS of its lower bound. Values of 2^MAX_BITS and more share
+ * the last bucket; the exact maximum is kept separately. Record() is O(1)
+ * (one CLZ) and never allocates. Only one context may call Record().
+ *
+ * @tparam SUB_BITS  log2 of the buckets per power of two.
+ * @tparam MAX_BITS  Values up to 2^MAX_BITS - 1 are resolved.
+ */
+template <uint8_t SUB_BITS, uint8_t MAX_BITS>
+class LogHistogram
+{
+public:
+   static const uint32_t BUCKETS = (uint32_t)(MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+   LogHistogram() { Reset(); }
+
+   void Record(uint32_t value)
+   {
+      m_counts[BucketOf(value)]++;
+      m_count++;
+      if (value > m_max) m_max = value;
+      if (value < m_min) m_min = value;
+   }
+
+   void Reset()
+   {
+      for (uint32_t i = 0; i < BUCKETS; i++) m_counts[i] = 0;
+      m_count = 0;
+      m_max = 0;
+      m_min = UINT32_MAX;
+   }
+
+   uint32_t GetCount() const { return m_count; }
+   uint32_t GetMax() const { return m_max; }
+   uint32_t GetMin() const { return m_count ? m_min : 0; }
+   uint32_t GetBucketCount(uint32_t bucket) const { return bucket < BUCKETS ? m_counts[bucket] : 0; }
+
+   /**@brief Upper bound of the bucket holding the given percentile, never
+    *        above the recorded maximum. 0 when nothing was recorded.
+    */
+   uint32_t Percentile(uint8_t percent) const
+   {
+      if (m_count == 0) return 0;
+      uint32_t rank = (uint32_t)(((uint64_t)m_count * percent + 99u) / 100u);
+      if (rank == 0) rank = 1;
+      uint32_t seen = 0;
+      for (uint32_t i = 0; i < BUCKETS; i++)
+      {
+         seen += m_counts[i];
+         if (seen >= rank)
+         {
+            uint32_t upper = UpperBound(i);
+            return upper < m_max ? upper : m_max;
+         }
+      }
+      return m_max;
+   }
+
+   static uint32_t BucketOf(uint32_t value)
+   {
+      if (value < (1u << SUB_BITS)) return value;
+      uint32_t exponent = 31u - (uint32_t)__builtin_clz(value);
+      if (exponent >= MAX_BITS) return BUCKETS - 1;
+      uint32_t shift = exponent - SUB_BITS;
+      return ((shift + 1u) << SUB_BITS) + ((value >> shift) & ((1u << SUB_BITS) - 1u));
+   }
+
+   /// Largest value that falls into bucket.
+   static uint32_t UpperBound(uint32_t bucket)
+   {
+      uint32_t group = bucket >> SUB_BITS;
+      uint32_t sub = bucket & ((1u << SUB_BITS) - 1u);
+      if (group == 0) return sub;
+      uint32_t shift = group - 1u;
+      uint32_t lower = (1u << (shift + SUB_BITS)) + (sub << shift);
+      return lower + ((1u << shift) - 1u);
+   }
+
+private:
+   static_assert(SUB_BITS < MAX_BITS && MAX_BITS <= 31, "LogHistogram: need SUB_BITS < MAX_BITS <= 31");
+
+   uint32_t m_counts[BUCKETS];
+   uint32_t m_count;
+   uint32_t m_max;
+   uint32_t m_min;
+};
+
+#endif
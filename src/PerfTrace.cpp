@@ -0,0 +1,50 @@
+#include "PerfTrace.h"
+
+PerfTrace Perf;
+
+PerfTrace::PerfTrace()
+{
+   for (uint8_t i = 0; i < PERF_STAGE_COUNT; i++) m_reset_pending[i] = false;
+}
+
+const char* PerfTrace::StageName(perf_stage_t stage)
+{
+   switch (stage)
+   {
+      case PERF_NOTIFY_TO_PARSE:  return "notify->parse";
+      case PERF_PARSE_TO_PUBLISH: return "parse->publish";
+      case PERF_PUBLISH_TO_TX:    return "publish->EVENT_TX";
+      case PERF_TX_TO_SENT:       return "EVENT_TX->sent";
+      case PERF_SAMPLE_AGE:       return "sample age";
+      default:                    return "?";
+   }
+}
+
+static void PrintMicros(uint32_t cycles)
+{
+   uint64_t us_x10 = ((uint64_t)cycles * 10000000ull) / PerfTrace::GetHz();
+   Serial.printf(" %9lu.%lu", (unsigned long)(us_x10 / 10u), (unsigned long)(us_x10 % 10u));
+}
+
+void PerfTrace::Print(void)
+{
+   Serial.printf("%-18s %8s %11s %11s %11s\n", "stage", "count", "p50 us", "p99 us", "max us");
+   for (uint8_t i = 0; i < PERF_STAGE_COUNT; i++)
+   {
+      perf_stage_t stage = (perf_stage_t)i;
+      const PerfHistogram& h = m_stages[i];
+      bool cleared = __atomic_load_n(&m_reset_pending[i], __ATOMIC_ACQUIRE);
+      Serial.printf("%-18s %8lu", StageName(stage), (unsigned long)(cleared ? 0 : h.GetCount()));
+      PrintMicros(cleared ? 0 : h.Percentile(50));
+      PrintMicros(cleared ? 0 : h.Percentile(99));
+      PrintMicros(cleared ? 0 : h.GetMax());
+      Serial.println();
+   }
+   Reset();
+}
+
+void PerfTrace::Reset(void)
+{
+   for (uint8_t i = 0; i < PERF_STAGE_COUNT; i++)
+      __atomic_store_n(&m_reset_pending[i], true, __ATOMIC_RELEASE);
+}
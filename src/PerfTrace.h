@@ -0,0 +1,89 @@
+#ifndef PERFTRACE_H
+#define PERFTRACE_H
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "CycleCounter.h"
+#include "LogHistogram.h"
+
+#define PERF_HZ_HOST            64000000u   ///< Rate of the cycle count the host derives from micros().
+
+/// Stages between the trace points on the BLE notify -> ANT broadcast path.
+typedef enum
+{
+   PERF_NOTIFY_TO_PARSE,       ///< BLE notify entry -> XDS frame parsed in update()
+   PERF_PARSE_TO_PUBLISH,      ///< parsed -> sample published to the ANT profile
+   PERF_PUBLISH_TO_TX,         ///< published -> EVENT_TX that first carries it
+   PERF_TX_TO_SENT,            ///< EVENT_TX entry -> sd_ant_broadcast_message_tx returned
+   PERF_SAMPLE_AGE,            ///< BLE notify entry -> page 0x10 handed to the radio
+   PERF_STAGE_COUNT
+} perf_stage_t;
+
+/// 4 buckets per octave up to 2^28 cycles (4.2 s at 64 MHz).
+typedef LogHistogram<2, 28> PerfHistogram;
+
+/**@brief Cycle-stamped latency histograms for the bridge's hot path.
+ *
+ * Trace points call Now() and hand two stamps to Record(); each stage has
+ * exactly one writer task (loop() for the first two, the ANT task for the
+ * rest), so recording takes no lock. Print() may run in any task: it reads
+ * the histograms as they are and asks each writer to clear its stage on
+ * its next Record(), so the reset never races an increment.
+ *
+ * On target the stamps are DWT cycles. The host derives a 64 MHz count
+ * from the virtual clock instead, so queueing and sample age come out in
+ * simulated time and the compute-only stages read 0 (see CodecBench for
+ * those).
+ */
+class PerfTrace
+{
+public:
+   PerfTrace();
+
+   void begin(void) { CycleCounter::Enable(); }
+
+   static inline uint32_t Now(void)
+   {
+#ifdef POWERMETER_HOST
+      return micros() * (PERF_HZ_HOST / 1000000u);
+#else
+      return CycleCounter::Now();
+#endif
+   }
+
+   static inline uint32_t GetHz(void)
+   {
+#ifdef POWERMETER_HOST
+      return PERF_HZ_HOST;
+#else
+      return CycleCounter::GetHz();
+#endif
+   }
+
+   void Record(perf_stage_t stage, uint32_t start, uint32_t end)
+   {
+      if (__atomic_load_n(&m_reset_pending[stage], __ATOMIC_ACQUIRE))
+      {
+         m_stages[stage].Reset();
+         __atomic_store_n(&m_reset_pending[stage], false, __ATOMIC_RELEASE);
+      }
+      m_stages[stage].Record(end - start);
+   }
+
+   const PerfHistogram& GetStage(perf_stage_t stage) const { return m_stages[stage]; }
+   static const char* StageName(perf_stage_t stage);
+
+   /**@brief Prints count and p50/p99/max in microseconds per stage, then
+    *        resets every stage.
+    */
+   void Print(void);
+   void Reset(void);
+
+private:
+   PerfHistogram m_stages[PERF_STAGE_COUNT];
+   bool m_reset_pending[PERF_STAGE_COUNT];   ///< Set by Reset(), cleared by the stage's writer.
+};
+
+extern PerfTrace Perf;
+
+#endif
@@ -1,5 +1,6 @@
 #include "BicyclePower.h"
 #include "../util.h"
+#include "../Log.h"
 
 PWRPage10::PWRPage10() :
     pwr_event_count(0),
@@ -135,10 +136,10 @@ void PWRPage46::Encode(uint8_t* buffer)
 }
 
 PWRPage52::PWRPage52() :
-    battery_identifier(0),
+    battery_identifier(0xFFu),          //Single battery, identifier not used
     cumulative_operating_time(0),
     fractional_battery_voltage(0),
-    descriptive_bitfield(0)
+    descriptive_bitfield(0xFFu)         //Coarse voltage and status invalid, 2s time resolution
 {}
 
 void PWRPage52::Decode(uint8_t const* buffer)
@@ -153,6 +154,7 @@ void PWRPage52::Decode(uint8_t const* buffer)
 void PWRPage52::Encode(uint8_t* buffer)
 {
     ant_pwr_page52_data_layout_t * p_outgoing_data = (ant_pwr_page52_data_layout_t *)buffer;
+    p_outgoing_data->reserved = UINT8_MAX;
     p_outgoing_data->battery_identifier = battery_identifier;
     UNUSED_PARAMETER(uint24_encode(cumulative_operating_time, p_outgoing_data->cumulative_operating_time));
     p_outgoing_data->fractional_battery_voltage = fractional_battery_voltage;
@@ -241,18 +243,30 @@ BicyclePower::BicyclePower(ANTTransmissionMode mode) :
         m_channel_sens_config.device_number      = PWR_DEVICE_NUMBER;
         m_channel_sens_config.network_number     = ANTPLUS_NETWORK_NUMBER;
 
-        main_page_number = ANT_PWR_PAGE_10;
-        bkgd_page0_number = ANT_PWR_PAGE_50;
-        bkgd_page1_number = ANT_PWR_PAGE_51;
-        bkgd_page2_number = ANT_PWR_PAGE_52;
-        bkgd_page3_number = ANT_PWR_PAGE_56;
-        calibration_page_number = ANT_PWR_PAGE_01;
-        message_counter = 0;
+        pwr_schedule_config_t schedule =
+        {
+            ANT_PWR_PAGE_10,
+            PWR_BACKGROUND_INTERVAL,
+            6,
+            { ANT_PWR_PAGE_50, ANT_PWR_PAGE_51, ANT_PWR_PAGE_52, ANT_PWR_PAGE_50, ANT_PWR_PAGE_51, ANT_PWR_PAGE_56 }
+        };
+        period_mode = PWR_PERIOD_4HZ;
+        SetSchedule(schedule);
+        static const uint8_t requestable_pages[] =
+        {
+            ANT_PWR_PAGE_02, ANT_PWR_PAGE_50, ANT_PWR_PAGE_51, ANT_PWR_PAGE_52, ANT_PWR_PAGE_56, ANT_PWR_PAGE_01
+        };
+        scheduler.SetSupportedPages(requestable_pages, sizeof(requestable_pages));
+        cal_id = 0;
+        requested_page = 0;
+        requested_subpage = 0;
         
         // page_52_present = false;
         // ext_page_number = ANT_PWR_PAGE_52;
         page10.SetPedalPWR(0xFFu);              //0xff for OFF
         page10.SetInstantCadence(0xFFu);        //0xff for OFF
+        pwr_sample_t idle_sample = { 0, 0, 0, 0xFFu, 0 };
+        sample_slot.Write(idle_sample);        //Cadence OFF until the first real sample
         page50.SetHwRevision(0x01u);            //v1
         page50.SetManufacturerID(0x000Fu);      //15 for dynastream
         page50.SetModelNumber(0x1B39);          //6969 for fun
@@ -260,215 +274,289 @@ BicyclePower::BicyclePower(ANTTransmissionMode mode) :
         page51.SetSWRevisionMain(0x01u);        //v1
         page51.SetSerialNumber(0x00B8AAF6u);    //12102390
 
+        cached_dirty = (uint8_t)((1u << PWR_CACHED_PAGE_COUNT) - 1);
+        tx_next = 0;
+        tx_carries_sample = false;
+        tx_origin_cycles = 0;
+        tx_publish_cycles = 0;
+        last_sent_publish_cycles = 0;
+        PrepareNextMessage();                   //First frame is ready before the channel opens
     }
 
 
-BicyclePower::ant_pwr_page_t BicyclePower::GetNextPageNumber()
+uint16_t BicyclePower::PeriodForMode(pwr_period_mode_t mode)
 {
-    ant_pwr_page_t page_number;
-    if (need_answer)
+    switch (mode)
     {
-        need_answer = false;
-        switch (requested_page)
-        {
-        case 0x50:
-            page_number = bkgd_page0_number;
-            non_main_messages++;
-            break;
-        case 0x51:
-            page_number = bkgd_page1_number;
-            non_main_messages++;
-            break;
-        case 0x52:
-            page_number = bkgd_page2_number;
-            non_main_messages++;
-            break;
-        case 0x56:
-            page_number = bkgd_page3_number;
-            non_main_messages++;
-            break;
-        case 0x02:
-            page_number = ANT_PWR_PAGE_02;
-            non_main_messages++;
-            break;
-        default:
-            break;
-        }
-        if (page_number == ANT_PWR_PAGE_02)
-        {
-            switch (requested_subpage)
-            {
-            case 0x01:
-                page02.SetSubPageNumber(0x01u);
-                page02.SetSubpageData(0, 0xFFu);        //Byte 2 of answer
-                page02.SetSubpageData(1, 0xFFu);        //Byte 3 of answer
-                page02.SetSubpageData(2, 0x7Du);        //172.5mm Crank length
-                page02.SetSubpageData(3, 0b00000011);   //No Custom Cal. Not two individual Sensors Bit 2-5. Crank Length Fixed
-                page02.SetSubpageData(4, 0x00);
-                page02.SetSubpageData(5, 0xFFu);
-                break;
-            case 0xFD:
-                page02.SetSubPageNumber(0xFDu);
-                page02.SetSubpageData(0, 0b11111110);   //Byte 2 of answer
-                page02.SetSubpageData(1, 0x45u);        //Byte 3 of answer
-                page02.SetSubpageData(2, 0b11111110);   //
-                page02.SetSubpageData(3, 0x45u);        //0b00000011
-                page02.SetSubpageData(4, 0b11111110);   //
-                page02.SetSubpageData(5, 0x45u);        //
-                break;
-            case 0xFE:
-                page02.SetSubPageNumber(0xFEu);
-                page02.SetSubpageData(0, 0xFFu);        //Byte 2 of answer reserved
-                page02.SetSubpageData(1, 0xFFu);        //Byte 3 of answer reserved
-                page02.SetSubpageData(2, 0b11111110);   //
-                page02.SetSubpageData(3, 0xFFu);        //0b00000011
-                page02.SetSubpageData(4, 0b11111110);   //
-                page02.SetSubpageData(5, 0xFFu);        //
-                break;
-            
-            default:
-                break;
-            }
-            Serial.printf("Set Subpage Values acc: 0x%.2X\n", requested_subpage);
-        }
-        //Serial.printf("requested_page: 0x%.2X\n", requested_page);
+        case PWR_PERIOD_8HZ: return PWR_MSG_PERIOD_8Hz;
+        case PWR_PERIOD_2HZ: return PWR_MSG_PERIOD_2Hz;
+        case PWR_PERIOD_4HZ:
+        default:             return PWR_MSG_PERIOD_4Hz;
     }
-    else if (calibration_request && non_main_messages < 2) //If calibration request is there next page is Calibration Page but need to set params
+}
+
+uint8_t BicyclePower::RateForMode(pwr_period_mode_t mode)
+{
+    switch (mode)
     {
-        page_number = calibration_page_number;
-        calibration_request = false;
-        non_main_messages++;
-        page01.SetCalibrationID(0xACu);
-        page01.SetAutoZeroStatus(0x00u);
-        page01.SetCalibrationData(0x0000u);
-        if (message_counter == (BACKGROUND_DATA_INTERVAL)) {
-            background_page_offset++;
-        }
+        case PWR_PERIOD_8HZ: return 8;
+        case PWR_PERIOD_2HZ: return 2;
+        case PWR_PERIOD_4HZ:
+        default:             return 4;
     }
-    else if (message_counter == (BACKGROUND_DATA_INTERVAL + background_page_offset) && non_main_messages < 2)
-    {
-        page_number = bkgd_page0_number;
-        page50.SetHwRevision(0x01u);            //v1
-        page50.SetManufacturerID(0x000Fu);      //15 for dynastream
-        page50.SetModelNumber(0x1B39);          //6969 for fun
+}
 
-        non_main_messages++;
-    } 
-    else if (message_counter > (BACKGROUND_DATA_INTERVAL + background_page_offset) && non_main_messages < 2)
-    {
-        page_number = bkgd_page1_number;
-        page51.SetSWRevisionSuppl(0xFFu);       //OFF
-        page51.SetSWRevisionMain(0x01u);        //v1
-        page51.SetSerialNumber(0x00B8AAF6u);    //12102390
+uint32_t BicyclePower::SetPeriodMode(pwr_period_mode_t mode)
+{
+    period_mode = mode;
+    return ChangeChannelPeriod(PeriodForMode(mode));
+}
+
+bool BicyclePower::SetSchedule(pwr_schedule_config_t const& config)
+{
+    if (config.main_interval == 0)
+        return false;
+    base_schedule = config;
+    OnChannelPeriodChanged(GetChannelPeriod());
+    return true;
+}
+
+void BicyclePower::OnChannelPeriodChanged(uint16_t period)
+{
+    //Keep the background pages at the same time spacing as at 4 Hz, but never
+    //beyond the 121-message limit for 0x50/0x51 at higher rates.
+    pwr_schedule_config_t schedule = base_schedule;
+    uint32_t interval = ((uint32_t)base_schedule.main_interval * PWR_MSG_PERIOD_4Hz + period / 2) / period;
+    if (interval > PWR_BACKGROUND_INTERVAL_MAX) interval = PWR_BACKGROUND_INTERVAL_MAX;
+    if (interval < 1) interval = 1;
+    schedule.main_interval = (uint8_t)interval;
+    scheduler.Configure(schedule);
+    PM_DLOG(ANT_TX, DEBUG, "Channel period %u, background every %u messages", period, schedule.main_interval);
+}
+
+BicyclePower::ant_pwr_page_t BicyclePower::GetNextPageNumber()
+{
+    return (ant_pwr_page_t)scheduler.Next();
+}
 
-        message_counter = 0;
-        background_page_offset = 0;
-        non_main_messages++;
+void BicyclePower::SetParametersSubpage(uint8_t subpage)
+{
+    switch (subpage)
+    {
+    case 0x01:
+        page02.SetSubPageNumber(0x01u);
+        page02.SetSubpageData(0, 0xFFu);        //Byte 2 of answer
+        page02.SetSubpageData(1, 0xFFu);        //Byte 3 of answer
+        page02.SetSubpageData(2, 0x7Du);        //172.5mm Crank length
+        page02.SetSubpageData(3, 0b00000011);   //No Custom Cal. Not two individual Sensors Bit 2-5. Crank Length Fixed
+        page02.SetSubpageData(4, 0x00);
+        page02.SetSubpageData(5, 0xFFu);
+        break;
+    case 0xFD:
+        page02.SetSubPageNumber(0xFDu);
+        page02.SetSubpageData(0, 0b11111110);   //Byte 2 of answer
+        page02.SetSubpageData(1, 0x45u);        //Byte 3 of answer
+        page02.SetSubpageData(2, 0b11111110);   //
+        page02.SetSubpageData(3, 0x45u);        //0b00000011
+        page02.SetSubpageData(4, 0b11111110);   //
+        page02.SetSubpageData(5, 0x45u);        //
+        break;
+    case 0xFE:
+        page02.SetSubPageNumber(0xFEu);
+        page02.SetSubpageData(0, 0xFFu);        //Byte 2 of answer reserved
+        page02.SetSubpageData(1, 0xFFu);        //Byte 3 of answer reserved
+        page02.SetSubpageData(2, 0b11111110);   //
+        page02.SetSubpageData(3, 0xFFu);        //0b00000011
+        page02.SetSubpageData(4, 0b11111110);   //
+        page02.SetSubpageData(5, 0xFFu);        //
+        break;
+    
+    default:
+        break;
     }
-    else
+    InvalidatePage(ANT_PWR_PAGE_02);
+    PM_DLOG(ANT_TX, DEBUG, "Set Subpage Values acc: 0x%02X", subpage);
+}
+
+int8_t BicyclePower::CachedFrameIndex(uint8_t page_number)
+{
+    switch (page_number)
     {
-        page_number = main_page_number;
-        non_main_messages = 0;
+        case ANT_PWR_PAGE_01: return 0;
+        case ANT_PWR_PAGE_02: return 1;
+        case ANT_PWR_PAGE_50: return 2;
+        case ANT_PWR_PAGE_51: return 3;
+        case ANT_PWR_PAGE_52: return 4;
+        case ANT_PWR_PAGE_56: return 5;
+        default:              return -1;
     }
-    //Serial.printf("page_number: %d\t\tmessage_counter: %d\n", page_number, message_counter);
-    message_counter++;
-    return page_number;
 }
 
-void BicyclePower::EncodeMessage()
+void BicyclePower::InvalidatePage(uint8_t page_number)
 {
-    ant_pwr_message_layout_t * p_pwr_message_payload = (ant_pwr_message_layout_t *)m_message_payload;
-    p_pwr_message_payload->page_number = GetNextPageNumber();
-    switch (p_pwr_message_payload->page_number)
+    int8_t index = CachedFrameIndex(page_number);
+    if (index >= 0)
+        cached_dirty |= (uint8_t)(1u << index);
+}
+
+void BicyclePower::EncodeMainPage(uint8_t* buffer)
+{
+    ant_pwr_message_layout_t * p_pwr_message_payload = (ant_pwr_message_layout_t *)buffer;
+    pwr_sample_t sample = sample_slot.Read();   //Newest consistent sample at EVENT_TX time
+    page10.SetInstantPWR(sample.instant_power);
+    page10.SetAccumulatedPWR(sample.accumulated_power);
+    page10.SetPWREventCount(sample.event_count);
+    page10.SetInstantCadence(sample.instant_cadence);
+    tx_origin_cycles = sample.origin_cycles;
+    tx_publish_cycles = sample.publish_cycles;
+    p_pwr_message_payload->page_number = ANT_PWR_PAGE_10;
+    page10.Encode(p_pwr_message_payload->page_payload);
+}
+
+void BicyclePower::EncodePage(uint8_t page_number, uint8_t* buffer)
+{
+    ant_pwr_message_layout_t * p_pwr_message_payload = (ant_pwr_message_layout_t *)buffer;
+    p_pwr_message_payload->page_number = page_number;
+    switch (page_number)
     {
         case ANT_PWR_PAGE_10: //Main Page
-            page10.Encode(p_pwr_message_payload->page_payload);
-            //Serial.printf("Encoding Page 0x10\n");
+            EncodeMainPage(buffer);
             break;
         case ANT_PWR_PAGE_50: //Manufacturer Info
             page50.Encode(p_pwr_message_payload->page_payload);
-            //Serial.printf("Encoding Page 0x50\n");
             break;
         case ANT_PWR_PAGE_51: //Product Info
             page51.Encode(p_pwr_message_payload->page_payload);
-            //Serial.printf("Encoding Page 0x51\n");
             break;
         case ANT_PWR_PAGE_01: //Calibration Page
             page01.Encode(p_pwr_message_payload->page_payload);
-            //Serial.printf("Encoding Page 0x01\n");
             break;
         case ANT_PWR_PAGE_52: //Battery Page
             page52.Encode(p_pwr_message_payload->page_payload);
-            //Serial.printf("Encoding Page 0x52\n");
             break;
         case ANT_PWR_PAGE_56: //Paired Devices Page
             page56.Encode(p_pwr_message_payload->page_payload);
-            //Serial.printf("Encoding Page 0x56\n");
             break;
         case ANT_PWR_PAGE_46: //Request Data Page
             page46.Encode(p_pwr_message_payload->page_payload);
-            //Serial.printf("Encoding Page 0x46\n");
             break;
         case ANT_PWR_PAGE_02: //Get Set Parameters page
             page02.Encode(p_pwr_message_payload->page_payload);
-            // Serial.printf("Encoding Page 0x02\n");
             break;
         default:
             break;
     }
 }
 
-void BicyclePower::DecodeMessage(uint8_t* buffer)
+void BicyclePower::PrepareNextMessage()
 {
-    ant_pwr_message_layout_t * p_pwr_message_payload = (ant_pwr_message_layout_t *)buffer;
-    Serial.printf("0x%.2X\t", p_pwr_message_payload->page_number);
-    for (int i = 0; i < 7; ++i)
+    uint8_t page_number = GetNextPageNumber();
+    uint8_t* buffer = tx_frames[tx_next];
+    int8_t index = CachedFrameIndex(page_number);
+    if (page_number == ANT_PWR_PAGE_10)
+    {
+        buffer[0] = page_number;    //Data is filled in at EVENT_TX from the newest sample
+        return;
+    }
+    if (index < 0)
     {
-        Serial.printf("%.2X ", p_pwr_message_payload->page_payload[i]);
+        EncodePage(page_number, buffer);
+        return;
     }
-    Serial.printf("\n");
+    if (cached_dirty & (1u << index))
+    {
+        EncodePage(page_number, cached_frames[index]);
+        cached_dirty &= (uint8_t)~(1u << index);
+    }
+    memcpy(buffer, cached_frames[index], ANT_STANDARD_DATA_PAYLOAD_SIZE);
+}
+
+uint8_t const* BicyclePower::FinalizeTxFrame()
+{
+    uint8_t* buffer = tx_frames[tx_next];
+    tx_carries_sample = (buffer[0] == ANT_PWR_PAGE_10);
+    if (tx_carries_sample)
+        EncodeMainPage(buffer);
+    tx_next ^= 1;
+    return buffer;
+}
+
+void BicyclePower::OnFrameSent(uint32_t tx_cycles, uint32_t sent_cycles)
+{
+    if (!tx_carries_sample || tx_publish_cycles == 0)
+        return;                                 //Not a main page, or nothing published yet
+    Perf.Record(PERF_SAMPLE_AGE, tx_origin_cycles, sent_cycles);
+    if (tx_publish_cycles != last_sent_publish_cycles)
+    {
+        //Only the first broadcast of a sample says how long it waited for the radio
+        Perf.Record(PERF_PUBLISH_TO_TX, tx_publish_cycles, tx_cycles);
+        last_sent_publish_cycles = tx_publish_cycles;
+    }
+}
+
+void BicyclePower::EncodeMessage()
+{
+    //Same sequence as EVENT_TX, for callers that do not split it around the broadcast
+    memcpy(m_message_payload, FinalizeTxFrame(), ANT_STANDARD_DATA_PAYLOAD_SIZE);
+    PrepareNextMessage();
+}
+
+void BicyclePower::DecodeMessage(uint8_t* buffer)
+{
+    ant_pwr_message_layout_t * p_pwr_message_payload = (ant_pwr_message_layout_t *)buffer;
+    uint8_t const* p = p_pwr_message_payload->page_payload;
+    PM_DLOG(ANT_RX, DEBUG, "0x%02X\t%08X %06X", p_pwr_message_payload->page_number,
+         ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3],
+         ((uint32_t)p[4] << 16) | ((uint32_t)p[5] << 8) | p[6]);
     //Serial.printf("\t%d\n", p_pwr_message_payload->page_payload[5]);
     switch (p_pwr_message_payload->page_number)
     {
         case ANT_PWR_PAGE_10: //Main Page
             page10.Decode(p_pwr_message_payload->page_payload);
-            Serial.printf("\tDecoding Page 0x10\n");
+            PM_DLOG(ANT_RX, DEBUG, "\tDecoding Page 0x10");
             break;
         case ANT_PWR_PAGE_50: //Manufacturer Info
             page50.Decode(p_pwr_message_payload->page_payload);
-            Serial.printf("\tDecoding Page 0x50\n");
+            PM_DLOG(ANT_RX, DEBUG, "\tDecoding Page 0x50");
             break;
         case ANT_PWR_PAGE_51: //Product Info
             page51.Decode(p_pwr_message_payload->page_payload);
-            Serial.printf("\tDecoding Page 0x51\n");
+            PM_DLOG(ANT_RX, DEBUG, "\tDecoding Page 0x51");
             break;
         case ANT_PWR_PAGE_01: //Calibration Page
             page01.Decode(p_pwr_message_payload->page_payload);
-            Serial.printf("\tDecoding Page 0x01\n");
+            PM_DLOG(ANT_RX, DEBUG, "\tDecoding Page 0x01");
             cal_id = page01.GetCalibrationID();
             if (cal_id == 0xAA || cal_id == 0xAB) //In case we need a calibration response
             {
-                calibration_request = true;
+                page01.SetCalibrationID(0xACu);
+                page01.SetAutoZeroStatus(0x00u);
+                page01.SetCalibrationData(0x0000u);
+                InvalidatePage(ANT_PWR_PAGE_01);
+                scheduler.Request(ANT_PWR_PAGE_01, 1);
             }
             break;
         case ANT_PWR_PAGE_52: //Battery Page
             page52.Decode(p_pwr_message_payload->page_payload);
-            Serial.printf("\tDecoding Page 0x52\n");
+            PM_DLOG(ANT_RX, DEBUG, "\tDecoding Page 0x52");
             break;
         case ANT_PWR_PAGE_56: //Paired Devices Page
             page56.Decode(p_pwr_message_payload->page_payload);
-            Serial.printf("\tDecoding Page 0x56\n");
+            PM_DLOG(ANT_RX, DEBUG, "\tDecoding Page 0x56");
             break;
         case 0x46: //Request Data Page
             page46.Decode(p_pwr_message_payload->page_payload);
             requested_page = page46.GetRequestedPageNumber();
             requested_subpage = page46.GetDescriptorByte1();
-            need_answer = true;
-            Serial.printf("\tDecoding Page 0x46 -> Wanted: 0x%.2X Sub: 0x%.2X\n", requested_page, requested_subpage);
+            if (requested_page == ANT_PWR_PAGE_02)
+                SetParametersSubpage(requested_subpage);
+            if (!scheduler.Request(requested_page, page46.GetRequestedNumberOfResponses()))
+                PM_DLOG(ANT_RX, DEBUG, "\tRequest for page 0x%02X ignored", requested_page);
+            PM_DLOG(ANT_RX, DEBUG, "\tDecoding Page 0x46 -> Wanted: 0x%02X Sub: 0x%02X", requested_page, requested_subpage);
             break;
         case ANT_PWR_PAGE_02: //Get Set Parameters page
             page02.Decode(p_pwr_message_payload->page_payload);
-            Serial.printf("\tDecoding Page 0x02\n");
+            PM_DLOG(ANT_RX, DEBUG, "\tDecoding Page 0x02");
             break;
         default:
             
@@ -4,21 +4,33 @@
 #include <stdint.h>
 
 #include "../ANTProfile.h"
+#include "PWRPageScheduler.h"
+#include "../SnapshotSlot.h"
 
 #define PWR_DEVICE_TYPE             0x0Bu     ///< Device type reserved for transmitting ANT+ Power.
 #define PWR_DEVICE_NUMBER           0x03E8u   //1000 in hex
 #define PWR_RF_CHANNEL              0x39u     ///< Frequency, decimal 57 (2457 MHz).
 
-//#define PWR_MSG_PERIOD_8Hz        0x1F86u   ///< Message period, decimal 8070 (4.06 Hz).
+#define PWR_MSG_PERIOD_8Hz          0x0FFBu   ///< Message period, decimal 4091 (8.0098 Hz).
 #define PWR_MSG_PERIOD_4Hz          0x1FF6u   ///< Message period, decimal 8182 (4.0049 Hz).
-//#define PWR_MSG_PERIOD_2Hz        0x3F0Cu   ///< Message period, decimal 16140 (2.03 Hz).
-//#define PWR_MSG_PERIOD_1Hz        0x7E18u   ///< Message period, decimal 32280 (1.02 Hz).
+#define PWR_MSG_PERIOD_2Hz          0x3FECu   ///< Message period, decimal 16364 (2.0024 Hz).
 
 #define PWR_EXT_ASSIGN              0x00                  ///< ANT ext assign.
 #define PWR_DISP_CHANNEL_TYPE       CHANNEL_TYPE_SLAVE    ///< Display HRM channel type.
 #define PWR_SENS_CHANNEL_TYPE       CHANNEL_TYPE_MASTER   ///< Sensor HRM channel type.
 #define PWR_TRANSMISSION_TYPE       0x05      //No shared channel (MSN 0x0 cause no extended Device number LSN 0x5)
 
+#define PWR_CACHED_PAGE_COUNT       6         ///< 0x01, 0x02, 0x50, 0x51, 0x52, 0x56
+#define PWR_BACKGROUND_INTERVAL     32        ///< Messages between background pages at 4 Hz. With the default rotation 0x50/0x51 go out every 99 messages (spec: at most 121).
+#define PWR_BACKGROUND_INTERVAL_MAX 39        ///< Largest interval that keeps 0x50/0x51 within 121 messages (3 slots of 40).
+
+typedef enum
+{
+    PWR_PERIOD_8HZ,
+    PWR_PERIOD_4HZ,     ///< ANT+ default
+    PWR_PERIOD_2HZ
+} pwr_period_mode_t;
+
 class PWRPage10
 {
 public:
@@ -166,7 +178,7 @@ public:
     void SetRequestedPageNumber(uint8_t val) { requested_page_number = val; }
     
     uint8_t GetRequestedResponse() { return requested_transmission_response; }
-    uint8_t GetRequestedNumberOfResponses() { return requested_transmission_response & 0xEF; }
+    uint8_t GetRequestedNumberOfResponses() { return requested_transmission_response & 0x7F; }
     void SetRequestedResponse(uint8_t val) { requested_transmission_response = val; }
 
     uint8_t GetDescriptorByte1() { return descriptor_byte_1; }
@@ -263,17 +275,55 @@ private:
     } ant_pwr_page02_data_layout_t;
 };
 
+/**@brief Power data carried by page 0x10, published as one consistent unit. */
+typedef struct
+{
+    uint16_t instant_power;         ///< W
+    uint16_t accumulated_power;     ///< W, rolls over at 65536
+    uint8_t  event_count;           ///< Incremented once per new power value
+    uint8_t  instant_cadence;       ///< rpm, 0xFF if not available
+    uint32_t timestamp;             ///< millis() when the sample was taken
+    uint32_t origin_cycles;         ///< PerfTrace::Now() when the source data arrived
+    uint32_t publish_cycles;        ///< PerfTrace::Now() at PublishSample(), 0 if never published
+} pwr_sample_t;
+
 class BicyclePower : public ANTProfile
 {
+    friend class BicyclePowerBench;
+    friend class TraceReplay;
 public:
     BicyclePower(ANTTransmissionMode mode);
 
     void ProcessMessage(ant_evt_t*);
 
-    void SetInstantPWR(uint16_t val) { page10.SetInstantPWR(val); }
-    void SetAccumulatedPWR(uint16_t val) { page10.SetAccumulatedPWR(val); }
-    void SetPWREventCount(uint8_t val) { page10.SetPWREventCount(val); }
-    void SetInstantCadence(uint8_t val) { page10.SetInstantCadence(val); }
+    /**@brief Makes sample the one the next page 0x10 carries. Safe to call
+     *        from a task that the ANT task preempts; EncodeMessage() picks
+     *        it up at EVENT_TX time.
+     */
+    void PublishSample(pwr_sample_t const& sample) { sample_slot.Write(sample); }
+    uint32_t GetPublishedSampleCount() const { return sample_slot.GetWriteCount(); }
+
+    /**@brief Replaces the page schedule. main_interval is given for 4 Hz
+     *        and scaled with the period mode.
+     */
+    bool SetSchedule(pwr_schedule_config_t const& config);
+
+    /**@brief Serial number sent in page 0x51. Call before the channel opens. */
+    void SetSerialNumber(uint32_t serial_number)
+    {
+        page51.SetSerialNumber(serial_number);
+        InvalidatePage(ANT_PWR_PAGE_51);
+    }
+
+    /**@brief Selects the broadcast rate. On an open channel this closes it;
+     *        the new period and schedule take effect when it reopens.
+     */
+    uint32_t SetPeriodMode(pwr_period_mode_t mode);
+    pwr_period_mode_t GetPeriodMode() { return period_mode; }
+    bool IsPeriodChangePending() { return GetChannelPeriod() != PeriodForMode(period_mode); }
+
+    static uint16_t PeriodForMode(pwr_period_mode_t mode);
+    static uint8_t RateForMode(pwr_period_mode_t mode);
 
 private:
 
@@ -291,7 +341,7 @@ private:
 
     typedef struct
     {
-        ant_pwr_page_t page_number;
+        uint8_t        page_number;         ///< ant_pwr_page_t, stored as one byte on every ABI.
         uint8_t        page_payload[7];
     } ant_pwr_message_layout_t;
 
@@ -305,26 +355,42 @@ private:
     PWRPage02 page02;
 
     ant_pwr_page_t GetNextPageNumber();
+    void SetParametersSubpage(uint8_t subpage);
 
     void EncodeMessage();
     void DecodeMessage(uint8_t* p_message_payload);
-
-
-    //uint8_t        toggle_bit;
-    ant_pwr_page_t  main_page_number;
-    ant_pwr_page_t  bkgd_page0_number;
-    ant_pwr_page_t  bkgd_page1_number;
-    ant_pwr_page_t  bkgd_page2_number;
-    ant_pwr_page_t  bkgd_page3_number;
-    ant_pwr_page_t  calibration_page_number;
-    uint8_t         message_counter;
-    uint8_t         background_page_offset;
-    uint8_t         non_main_messages;
+    uint8_t const* FinalizeTxFrame();
+    void PrepareNextMessage();
+
+    void EncodePage(uint8_t page_number, uint8_t* p_message_payload);
+    void EncodeMainPage(uint8_t* p_message_payload);
+    int8_t CachedFrameIndex(uint8_t page_number);
+    void InvalidatePage(uint8_t page_number);
+    void OnChannelPeriodChanged(uint16_t period);
+    void OnFrameSent(uint32_t tx_cycles, uint32_t sent_cycles);
+
+    PWRPageScheduler scheduler;
+    pwr_schedule_config_t base_schedule;    ///< Schedule as configured for 4 Hz.
+    pwr_period_mode_t period_mode;
+    SnapshotSlot<pwr_sample_t> sample_slot;
+
+    //Pages whose content only changes on configuration or a request are
+    //encoded once and copied from here until InvalidatePage() is called.
+    uint8_t cached_frames[PWR_CACHED_PAGE_COUNT][ANT_STANDARD_DATA_PAYLOAD_SIZE];
+    uint8_t cached_dirty;           ///< One bit per cached_frames entry.
+
+    //The next frame is built right after the previous broadcast; EVENT_TX
+    //only patches in the newest sample (main page) and hands it over.
+    uint8_t tx_frames[2][ANT_STANDARD_DATA_PAYLOAD_SIZE];
+    uint8_t tx_next;                ///< tx_frames entry holding the pre-built frame.
+    //Trace stamps of the sample in the frame just finalized, for OnFrameSent()
+    bool tx_carries_sample;
+    uint32_t tx_origin_cycles;
+    uint32_t tx_publish_cycles;
+    uint32_t last_sent_publish_cycles;  ///< Sample of the last page 0x10 sent.
     uint8_t         cal_id;
     uint8_t         requested_page;
     uint8_t         requested_subpage;
-    bool            need_answer;
-    bool            calibration_request;
     
     // uint8_t        page_52_present;
     // ant_pwr_page_t ext_page_number;
@@ -336,11 +402,8 @@ private:
 /*
 TODO:
 
-Page 0x52
-Page 0x56
-Page 0x46
-
-GetNextPageNumber anpassen
+Page 0x52 (real battery data)
+Page 0x56 (real paired devices)
 
 (Page 0x02)
 
@@ -0,0 +1,140 @@
+#include "CodecBench.h"
+#include "PowerMeter.h"
+#include "XdsValidator.h"
+#include "VirtualWorkout.h"
+#include "BicyclePower.h"
+#include "../CycleCounter.h"
+
+/// Keeps the compiler from discarding a result it can otherwise prove unused.
+template <typename T>
+static inline void Consume(const T& v)
+{
+   __asm__ volatile("" : : "r"(v) : "memory");
+}
+
+static void Report(const char* name, uint32_t iterations, uint32_t best_cycles)
+{
+   uint64_t ns_x10 = (uint64_t)CycleCounter::ToNanos(best_cycles) * 10u / iterations;
+   Serial.printf("bench,%s,%lu,%lu.%lu,", name, (unsigned long)iterations,
+                 (unsigned long)(ns_x10 / 10u), (unsigned long)(ns_x10 % 10u));
+   if (CycleCounter::CountsCycles())
+   {
+      uint64_t cyc_x10 = (uint64_t)best_cycles * 10u / iterations;
+      Serial.printf("%lu.%lu", (unsigned long)(cyc_x10 / 10u), (unsigned long)(cyc_x10 % 10u));
+   }
+   Serial.println();
+}
+
+/// Times op(i) for i in [0, iterations) and reports the fastest round.
+template <typename Op>
+static void Measure(const char* name, uint32_t iterations, Op op)
+{
+   uint32_t best = UINT32_MAX;
+   for (uint8_t round = 0; round < CODEC_BENCH_ROUNDS; round++)
+   {
+      uint32_t start = CycleCounter::Now();
+      for (uint32_t i = 0; i < iterations; i++) op(i);
+      uint32_t elapsed = CycleCounter::Now() - start;
+      if (elapsed < best) best = elapsed;
+   }
+   Report(name, iterations, best);
+}
+
+/// Encode/Decode pair for one page class; set(page, i) varies the input.
+template <typename Page, typename Setter>
+static void MeasurePage(const char* encode_name, const char* decode_name, uint32_t iterations, Setter set)
+{
+   static Page page;
+   uint8_t buffer[ANT_STANDARD_DATA_PAYLOAD_SIZE - 1] = { 0 };
+   Measure(encode_name, iterations, [&](uint32_t i) {
+      set(page, i);
+      page.Encode(buffer);
+      Consume(buffer[0]);
+   });
+   Measure(decode_name, iterations, [&](uint32_t i) {
+      buffer[0] = (uint8_t)i;
+      page.Decode(buffer);
+      Consume(&page);
+   });
+}
+
+class BicyclePowerBench
+{
+public:
+   static void Run(uint32_t iterations)
+   {
+      // Private instance so the live channel's page rotation is not disturbed.
+      static BicyclePower pwr(TX);
+      Measure("BicyclePower::GetNextPageNumber", iterations, [&](uint32_t) {
+         Consume(pwr.GetNextPageNumber());
+      });
+      Measure("BicyclePower::EncodeMessage", iterations, [&](uint32_t i) {
+         pwr_sample_t sample = { (uint16_t)i, (uint16_t)(i * 3), (uint8_t)i, 0xFFu, i };
+         pwr.PublishSample(sample);
+         pwr.EncodeMessage();
+         Consume(pwr.m_message_payload[0]);
+      });
+      Measure("BicyclePower::FinalizeTxFrame", iterations, [&](uint32_t) {
+         Consume(pwr.FinalizeTxFrame());
+         pwr.tx_next ^= 1;  //Re-finalize the same pre-built frame
+      });
+      Measure("BicyclePower::PrepareNextMessage", iterations, [&](uint32_t) {
+         pwr.PrepareNextMessage();
+         Consume(pwr.tx_frames[pwr.tx_next][0]);
+      });
+   }
+};
+
+void CodecBench::Run(uint32_t iterations)
+{
+   if (iterations == 0) return;
+   CycleCounter::Enable();
+
+   Serial.println("bench,name,iterations,ns_per_op,cycles_per_op");
+   Measure("loop", iterations, [](uint32_t i) { Consume(i); });
+
+   MeasurePage<PWRPage10>("PWRPage10::Encode", "PWRPage10::Decode", iterations,
+      [](PWRPage10& p, uint32_t i) { p.SetInstantPWR((uint16_t)i); p.SetPWREventCount((uint8_t)i); });
+   MeasurePage<PWRPage01>("PWRPage01::Encode", "PWRPage01::Decode", iterations,
+      [](PWRPage01& p, uint32_t i) { p.SetCalibrationData((uint16_t)i); });
+   MeasurePage<PWRPage02>("PWRPage02::Encode", "PWRPage02::Decode", iterations,
+      [](PWRPage02& p, uint32_t i) { p.SetSubPageNumber((uint8_t)i); });
+   MeasurePage<PWRPage46>("PWRPage46::Encode", "PWRPage46::Decode", iterations,
+      [](PWRPage46& p, uint32_t i) { p.SetRequestedPageNumber((uint8_t)i); });
+   MeasurePage<PWRPage50>("PWRPage50::Encode", "PWRPage50::Decode", iterations,
+      [](PWRPage50& p, uint32_t i) { p.SetModelNumber((uint16_t)i); });
+   MeasurePage<PWRPage51>("PWRPage51::Encode", "PWRPage51::Decode", iterations,
+      [](PWRPage51& p, uint32_t i) { p.SetSerialNumber(i); });
+   MeasurePage<PWRPage52>("PWRPage52::Encode", "PWRPage52::Decode", iterations,
+      [](PWRPage52&, uint32_t) {});
+   MeasurePage<PWRPage56>("PWRPage56::Encode", "PWRPage56::Decode", iterations,
+      [](PWRPage56&, uint32_t) {});
+
+   BicyclePowerBench::Run(iterations);
+
+   uint8_t frame[XDS_FRAME_SIZE] = { 0xB4, 0x00, 0x5A, 0x00, 0x5A, 0x00, 0x10, 0x00, 0x55, 0x00, 0x00 };
+   Measure("XdsFrameView::decode", iterations, [&](uint32_t i) {
+      frame[0] = (uint8_t)i;
+      XdsFrameView view(frame, XDS_FRAME_SIZE);
+      if (view.isValid()) Consume(view.totalPower() + view.cadence());
+   });
+   frame[0] = 0xB4;
+   XdsFrameView sample(frame, XDS_FRAME_SIZE);
+   // Private instance so the live links' reject counters are not disturbed.
+   static XdsValidator validator;
+   Measure("XdsValidator::check", iterations, [&](uint32_t i) {
+      frame[XdsFrameView::CADENCE_OFFSET] = (uint8_t)(60 + (i & 0x3F));
+      Consume(validator.check(sample));
+   });
+   Measure("XdsValidator::filterPower", iterations, [&](uint32_t i) {
+      Consume(validator.filterPower((uint16_t)(180 + (i & 0x1F))));
+   });
+
+   // Private generator so the live links' workout progress is not disturbed.
+   static VirtualWorkout workout;
+   workout.Begin(NULL, 0, 1);
+   Measure("VirtualWorkout::Next", iterations, [&](uint32_t) {
+      workout_sample_t w = workout.Next(8192, 200, 85);
+      Consume(w.watts + w.cadence);
+   });
+}
@@ -0,0 +1,132 @@
+#include "PWRPageScheduler.h"
+
+PWRPageScheduler::PWRPageScheduler() :
+    supported_count(0),
+    ignored_requests(0),
+    dropped_requests(0)
+{
+    config.main_page = 0;
+    config.main_interval = 1;
+    config.rotation_length = 0;
+    Reset();
+}
+
+bool PWRPageScheduler::Configure(pwr_schedule_config_t const& new_config)
+{
+    if (new_config.main_interval == 0)
+        return false;
+
+    config.main_page = new_config.main_page;
+    config.main_interval = new_config.main_interval;
+    config.rotation_length = 0;
+    for (uint8_t i = 0; i < new_config.rotation_length && i < PWR_SCHEDULE_MAX_ROTATION; i++)
+    {
+        if (new_config.rotation[i] != 0)
+            config.rotation[config.rotation_length++] = new_config.rotation[i];
+    }
+    Reset();
+    return true;
+}
+
+void PWRPageScheduler::SetSupportedPages(uint8_t const* pages, uint8_t count)
+{
+    supported_count = 0;
+    for (uint8_t i = 0; i < count && i < PWR_SCHEDULE_MAX_SUPPORTED; i++)
+        supported[supported_count++] = pages[i];
+}
+
+bool PWRPageScheduler::IsSupported(uint8_t page) const
+{
+    for (uint8_t i = 0; i < supported_count; i++)
+    {
+        if (supported[i] == page)
+            return true;
+    }
+    return false;
+}
+
+bool PWRPageScheduler::Request(uint8_t page, uint8_t count)
+{
+    if (!IsSupported(page))
+    {
+        ignored_requests++;
+        return false;
+    }
+    if (count == 0)
+        count = 1;
+
+    for (uint8_t i = 0; i < pending_count; i++)
+    {
+        pending_request_t& entry = pending[(pending_head + i) % PWR_SCHEDULE_MAX_PENDING];
+        if (entry.page == page)
+        {
+            entry.remaining = count;
+            return true;
+        }
+    }
+    if (pending_count == PWR_SCHEDULE_MAX_PENDING)
+    {
+        dropped_requests++;
+        return false;
+    }
+    pending_request_t& entry = pending[(pending_head + pending_count) % PWR_SCHEDULE_MAX_PENDING];
+    entry.page = page;
+    entry.remaining = count;
+    pending_count++;
+    return true;
+}
+
+uint8_t PWRPageScheduler::Next()
+{
+    bool background_due = messages_until_background == 0 && config.rotation_length != 0;
+    if (non_main_run < PWR_SCHEDULE_MAX_NON_MAIN)
+    {
+        // Background slots go first so a stream of requests cannot push
+        // 0x50/0x51 beyond their interleave limit.
+        if (background_due)
+        {
+            uint8_t page = config.rotation[rotation_index];
+            if (++rotation_index == config.rotation_length)
+                rotation_index = 0;
+            // Count from when the slot was due, not from when it went out.
+            messages_until_background = config.main_interval - background_late;
+            background_late = 0;
+            non_main_run++;
+            return page;
+        }
+        if (pending_count != 0)
+        {
+            pending_request_t& entry = pending[pending_head];
+            uint8_t page = entry.page;
+            if (--entry.remaining == 0)
+            {
+                pending_head = (pending_head + 1) % PWR_SCHEDULE_MAX_PENDING;
+                pending_count--;
+            }
+            if (page == config.main_page)
+                non_main_run = 0;
+            else
+                non_main_run++;
+            if (messages_until_background != 0)
+                messages_until_background--;
+            return page;
+        }
+    }
+
+    non_main_run = 0;
+    if (background_due)
+        background_late++;
+    else if (messages_until_background != 0)
+        messages_until_background--;
+    return config.main_page;
+}
+
+void PWRPageScheduler::Reset()
+{
+    pending_head = 0;
+    pending_count = 0;
+    messages_until_background = config.main_interval;
+    background_late = 0;
+    rotation_index = 0;
+    non_main_run = 0;
+}
@@ -0,0 +1,94 @@
+#ifndef PWRPAGESCHEDULER_H
+#define PWRPAGESCHEDULER_H
+
+#include <stdint.h>
+
+#define PWR_SCHEDULE_MAX_ROTATION       8   ///< Background pages in one rotation.
+#define PWR_SCHEDULE_MAX_PENDING        4   ///< Outstanding on-demand page requests.
+#define PWR_SCHEDULE_MAX_NON_MAIN       2   ///< Consecutive non-main pages allowed before a main page.
+#define PWR_SCHEDULE_MAX_SUPPORTED      12  ///< Pages that may be requested on demand.
+
+/**@brief Static description of a page schedule.
+ *
+ * After main_interval other messages one background slot is due; it sends
+ * the next entry of rotation[]. Without on-demand requests those messages
+ * are all main pages. Repeating a page in the rotation sends it more often
+ * (0x50/0x51 must each be seen at least every 121 messages).
+ */
+typedef struct
+{
+    uint8_t main_page;
+    uint8_t main_interval;                          ///< Messages between background slots, >= 1.
+    uint8_t rotation_length;
+    uint8_t rotation[PWR_SCHEDULE_MAX_ROTATION];
+} pwr_schedule_config_t;
+
+/**@brief Interleaves main, background and on-demand pages for one channel.
+ *
+ * Next() is called once per EVENT_TX and does a constant amount of work:
+ * it never sends more than PWR_SCHEDULE_MAX_NON_MAIN non-main pages in a
+ * row, serves a due background slot first and on-demand requests second,
+ * and defers whatever does not fit to the tick after the next main page.
+ * Background slots stay on a fixed grid of main_interval + 1 messages: a
+ * slot delayed by the non-main limit shortens the wait for the next one,
+ * so on-demand traffic cannot stretch the 0x50/0x51 interval.
+ * Not thread-safe by itself. Next() runs in the ANT task on EVENT_TX;
+ * Request() runs in the lower-priority ANTW worker (page 0x46 and
+ * calibration decode in ANTProfile::ProcessDeferred) inside
+ * taskENTER_CRITICAL(), so Next() never sees a half-updated queue. Any
+ * other caller that modifies the scheduler must do the same.
+ */
+class PWRPageScheduler
+{
+public:
+    PWRPageScheduler();
+
+    /**@brief Replaces the schedule. Rotation entries that are zero or beyond
+     *        PWR_SCHEDULE_MAX_ROTATION are ignored.
+     * @return false if the configuration was rejected.
+     */
+    bool Configure(pwr_schedule_config_t const& config);
+
+    /**@brief Pages Request() accepts; any other page number is ignored. */
+    void SetSupportedPages(uint8_t const* pages, uint8_t count);
+
+    /**@brief Queues an on-demand page to be sent count times (at least once).
+     *        A repeated request for a queued page replaces its count.
+     * @return false for unsupported pages or a full request queue.
+     */
+    bool Request(uint8_t page, uint8_t count);
+
+    /**@brief Page to send on this tick. */
+    uint8_t Next();
+
+    void Reset();
+
+    uint32_t GetIgnoredRequestCount() const { return ignored_requests; }
+    uint32_t GetDroppedRequestCount() const { return dropped_requests; }
+
+private:
+    typedef struct
+    {
+        uint8_t page;
+        uint8_t remaining;
+    } pending_request_t;
+
+    bool IsSupported(uint8_t page) const;
+
+    pwr_schedule_config_t config;
+    uint8_t supported[PWR_SCHEDULE_MAX_SUPPORTED];
+    uint8_t supported_count;
+
+    pending_request_t pending[PWR_SCHEDULE_MAX_PENDING];
+    uint8_t pending_head;
+    uint8_t pending_count;
+
+    uint8_t messages_until_background;  ///< Messages left before the next background slot.
+    uint8_t background_late;            ///< Ticks the due background slot has waited.
+    uint8_t rotation_index;
+    uint8_t non_main_run;               ///< Non-main pages sent since the last main page.
+    uint32_t ignored_requests;
+    uint32_t dropped_requests;
+};
+
+#endif
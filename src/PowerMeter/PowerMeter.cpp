@@ -1,158 +1,313 @@
 #include "./PowerMeter.h"
+#include "../Log.h"
+#include "CodecBench.h"
 
-// 静态实例指针定义
+// 在编译输出中报告本次构建的日志级别；PM_LOG_PRODUCTION节省的闪存/RAM由 "make -C host logsize" 报告
+#define PM_LOG_STR_(x) #x
+#define PM_LOG_STR(x) PM_LOG_STR_(x)
+#pragma message("Log levels BLE/XDS/ANT_TX/ANT_RX/SDANT/CMD: " \
+    PM_LOG_STR(PM_LOG_LEVEL_BLE) "/" PM_LOG_STR(PM_LOG_LEVEL_XDS) "/" \
+    PM_LOG_STR(PM_LOG_LEVEL_ANT_TX) "/" PM_LOG_STR(PM_LOG_LEVEL_ANT_RX) "/" \
+    PM_LOG_STR(PM_LOG_LEVEL_SDANT) "/" PM_LOG_STR(PM_LOG_LEVEL_CMD))
+
+// 静态实例指针与连接表定义
 PowerMeter* PowerMeter::instance = nullptr;
+MeterLink* PowerMeter::linkByConn[BLE_MAX_CONNECTION] = { nullptr };
 
 void PrintUnhandledANTEvent(ant_evt_t *evt)
 {
-  Serial.printf("Channel #%d for %s: event %s\n", evt->channel, ANTplus.getAntProfileByChNum(evt->channel)->getName(), AntEventTypeDecode(evt)); 
+  PM_LOG(SDANT, INFO, "Channel #%d for %s: event %s\n", evt->channel, ANTplus.getAntProfileByChNum(evt->channel)->getName(), (const char*)AntEventTypeDecode(evt)); 
   if (evt->event != EVENT_CHANNEL_COLLISION 
     && evt->event != EVENT_RX_FAIL
     && evt->event != EVENT_CHANNEL_CLOSED
     )
-    Serial.printf("  (%s)\n", AntEventType2LongDescription(evt));
+    PM_LOG(SDANT, INFO, "  (%s)\n", (const char*)AntEventType2LongDescription(evt));
 }
 void ReopenANTChannel(ant_evt_t *evt)
 {
   if (evt->event == EVENT_CHANNEL_CLOSED ) {
-    Serial.printf("Channel #%d closed for %s\n", evt->channel,ANTplus.getAntProfileByChNum(evt->channel)->getName()); 
-    Serial.printf("Reopening...");
+    PM_LOG(SDANT, INFO, "Channel #%d closed for %s, reopening\n", evt->channel, ANTplus.getAntProfileByChNum(evt->channel)->getName()); 
     uint32_t ret;
     ret = sd_ant_channel_open(evt->channel);
-    if (ret == NRF_SUCCESS) Serial.println("success!");
-    else Serial.printf("failed with code:%#x\n", ret);
+    if (ret == NRF_SUCCESS) PM_LOG(SDANT, INFO, "Channel #%d reopened\n", evt->channel);
+    else PM_LOG(SDANT, ERROR, "Reopening channel #%d failed with code:%#x\n", evt->channel, (unsigned int)ret);
   }
 }
 
-PowerMeter::PowerMeter(powermeter_config * cfg) : 
+static const char* linkStateName(link_state_t state)
+{
+    switch (state) {
+        case LINK_FREE:          return "Free";
+        case LINK_CONNECTING:    return "Connecting";
+        case LINK_CONNECTED:     return "Connected";
+        case LINK_DISCONNECTING: return "Disconnecting";
+        case LINK_BACKOFF:       return "Backoff";
+    }
+    return "?";
+}
+
+// 解析 "AA:BB:CC:DD:EE:FF" (分隔符可省略)，按peer_addr.addr的顺序存放 (低字节在前)
+static bool parseAddress(const char* text, uint8_t* addr)
+{
+    uint8_t digits = 0;
+    for (const char* p = text; *p != '\0'; p++) {
+        char c = *p;
+        uint8_t nibble;
+        if (c >= '0' && c <= '9') nibble = c - '0';
+        else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+        else if (c == ':' || c == '-') continue;
+        else return false;
+        if (digits >= BLE_GAP_ADDR_LEN * 2) return false;
+        uint8_t& byte = addr[BLE_GAP_ADDR_LEN - 1 - digits / 2];
+        byte = (digits & 1) ? (uint8_t)((byte << 4) | nibble) : nibble;
+        digits++;
+    }
+    return digits == BLE_GAP_ADDR_LEN * 2;
+}
+
+// 连接参数策略表 (间隔单位1.25 ms，超时单位10 ms)
+typedef struct
+{
+    const char* name;
+    uint16_t interval;
+    uint16_t slaveLatency;
+    uint16_t supervisionTimeout;
+} conn_policy_params_t;
+
+static const conn_policy_params_t connPolicies[CONN_POLICY_COUNT] = {
+    { "low-latency", 6,  0, 400 },     // 7.5 ms，4 s超时
+    { "low-power",   80, 4, 600 },     // 100 ms，可跳过4个连接事件，6 s超时
+};
+
+// 1.25 ms单位的连接间隔转换为0.1 ms
+static uint32_t connIntervalTenthsMs(uint16_t units)
+{
+    return (uint32_t)units * 25 / 2;
+}
+
+// 每路功率计独立的BLE客户端对象与数据状态
+MeterLink::MeterLink() :
+    index(0),
+    pwr(NULL),
+    replay(false),
     meshProxyService(MESH_PROXY_SERVICE_UUID),
-    powerMeasurementChar(CYCLING_POWER_MEASUREMENT_UUID)
+    powerMeasurementChar(CYCLING_POWER_MEASUREMENT_UUID),
+    isConnected(false),
+    connectionHandle(BLE_CONN_HANDLE_INVALID),
+    notificationsEnabled(false),
+    state(LINK_FREE),
+    stateSince(0),
+    retryAt(0),
+    retryCount(0),
+    connectDirect(false),
+    peerKnown(false),
+    disconnectTime(0),
+    dataTimeoutWarned(false),
+    directReconnects(0),
+    scanReconnects(0),
+    connectTimeouts(0),
+    stallDisconnects(0),
+    connParamRequestTime(0),
+    connParamRetries(0),
+    connParamsOk(false),
+    connInterval(0), connLatency(0), connTimeout(0),
+    accPWR(0), instPWR(0), instCAD(0), PWREventCount(0),
+    virtualStart(0),
+    virtualSamples(0),
+    virtualPeriod(0),
+    lastValidDataTime(0),
+    dataQualityGood(true),
+    sampleDropCount(0)
+{
+}
+
+PowerMeter::PowerMeter(powermeter_config * cfg) :
+    configSource(cfg),
+    meterCount(0),
+    connectedCount(0),
+    connectingLink(NULL),
+    cancelledLink(NULL)
 {
-    config.profileUpdateCycle = cfg->profileUpdateCycle;
-    //config.p_power_profile = cfg->p_power_profile;
-    pwr = new BicyclePower(TX);
-    
     // 设置静态实例指针
     instance = this;
     
     // 初始化虚拟数据参数
-    basePower = 100;           // 基础功率100W
-    baseCadence = 70;          // 基础踏频70RPM
-    virtualDataInterval = 1000; // 1秒更新一次虚拟数据
-    lastVirtualDataUpdate = 0;
-    lastCadenceUpdate = 0;
-    
-    // 初始化功率和踏频
-    instPWR = basePower;
-    instCAD = baseCadence;
-    accPWR = 0;
-    PWREventCount = 0;
+    basePower = 100;           // 参考功率100W
+    baseCadence = 70;          // 参考踏频70RPM
+    crankCadence = 0;
+    crankLastRevolution = 0;
+    crankPeriodUs = 0;
     
     // 初始化蓝牙客户端状态
-    isConnected = false;
     isScanning = false;
-    connectionHandle = 0;
-    
-    // 初始化错误处理和数据质量监控
-    invalidDataCount = 0;
-    validDataCount = 0;
-    lastValidDataTime = 0;
+    scanPhase = SCAN_PHASE_FAST;
+    scanPhaseSince = 0;
+    memset(scanStats, 0, sizeof(scanStats));
+    allowlistCount = 0;
+    rejectedSince = 0;
     dataTimeoutMs = 5000;      // 5秒数据超时
-    dataQualityGood = true;
-    notificationsEnabled = false;  // 初始化通知状态为禁用
 }
 
 void PowerMeter::begin() {
-    Serial.println("Starting PowerMeter Setup...");
-    Serial.println("Adding PWR profile");
-    pwr->setUnhandledEventListener(PrintUnhandledANTEvent);
-    pwr->setAllEventListener(ReopenANTChannel);
-    pwr->setName("PWR");
-    ANTplus.AddProfile(pwr);
-
-    Serial.println("Bluefruit52 BLEUART Startup");
-    Serial.println("---------------------------\n");
+    PM_LOGLN(BLE, INFO, "Starting PowerMeter Setup...");
+    DLog.begin();
+    Perf.begin();
+
+    // 读取配置：每路功率计对应一个ANT+通道，设备号依次递增
+    static const char* const profileNames[PM_MAX_METERS] = { "PWR0", "PWR1", "PWR2", "PWR3" };
+    config.periodMode = configSource ? configSource->periodMode : PWR_PERIOD_4HZ;
+    config.meterCount = configSource ? configSource->meterCount : 1;
+    config.baseDeviceNumber = configSource ? configSource->baseDeviceNumber : 0;
+    if (config.meterCount == 0) config.meterCount = 1;
+    if (config.meterCount > PM_MAX_METERS) config.meterCount = PM_MAX_METERS;
+    if (config.baseDeviceNumber == 0) config.baseDeviceNumber = PWR_DEVICE_NUMBER;
+    meterCount = config.meterCount;
+
+    // 白名单：格式错误的条目跳过
+    config.allowlist = configSource ? configSource->allowlist : NULL;
+    config.allowlistCount = configSource && configSource->allowlist ? configSource->allowlistCount : 0;
+    for (uint8_t i = 0; i < config.allowlistCount && allowlistCount < PM_ALLOWLIST_SIZE; i++) {
+        if (parseAddress(config.allowlist[i], allowlist[allowlistCount])) {
+            allowlistCount++;
+        } else {
+            PM_LOG(BLE, WARN, "Ignoring malformed allowlist address: %s\n", config.allowlist[i]);
+        }
+    }
+    if (allowlistCount > 0) PM_LOG(BLE, INFO, "Allowlist: %u known power meter(s)\n", allowlistCount);
+    config.connPolicy = configSource && configSource->connPolicy < CONN_POLICY_COUNT ? configSource->connPolicy : CONN_POLICY_LOW_LATENCY;
+    config.powerSmoothing = configSource ? configSource->powerSmoothing : 0;
+    if (config.powerSmoothing != 3 && config.powerSmoothing != 10) config.powerSmoothing = 0;
+    config.recordSession = configSource ? configSource->recordSession : false;
+    config.workout = configSource ? configSource->workout : NULL;
+    config.workoutStepCount = configSource && configSource->workout ? configSource->workoutStepCount : 0;
+    config.workoutSeed = configSource ? configSource->workoutSeed : 1;
+    config.hallPin = configSource ? configSource->hallPin : CRANK_PIN_NONE;
+
+    for (uint8_t i = 0; i < meterCount; i++) {
+        MeterLink& link = links[i];
+        link.index = i;
+        link.pwr = new BicyclePower(TX);
+        link.pwr->setUnhandledEventListener(PrintUnhandledANTEvent);
+        link.pwr->setAllEventListener(ReopenANTChannel);
+        link.pwr->setName(meterCount == 1 ? "PWR" : profileNames[i]);
+        link.pwr->SetDeviceNumber(config.baseDeviceNumber + i);
+        link.pwr->SetSerialNumber(link.pwr->GetDeviceNumber());
+        link.pwr->SetPeriodMode(config.periodMode);  // 通道打开前设置，仅修改配置
+        // 未连接时单车模式发送虚拟数据，网关模式保持空闲样本
+        link.instPWR = meterCount == 1 ? basePower : 0;
+        link.instCAD = meterCount == 1 ? baseCadence : 0;
+        link.workout.Begin(config.workout, config.workoutStepCount, config.workoutSeed + i);
+        PM_LOG(BLE, INFO, "Adding %s profile, device number %u\n", link.pwr->getName(), link.pwr->GetDeviceNumber());
+        if (!ANTplus.AddProfile(link.pwr)) {
+            PM_LOG(SDANT, ERROR, "ANT profile table full, %s not added\n", link.pwr->getName());
+        }
+    }
+    config.p_power_profile = links[0].pwr;
+
+    PM_LOGLN(BLE, INFO, "Bluefruit52 BLEUART Startup");
+    PM_LOGLN(BLE, INFO, "---------------------------\n");
     Bluefruit.autoConnLed(true);
     // Bluefruit.configPrphBandwidth(BANDWIDTH_NORMAL);
     // Bluefruit.configCentralBandwidth(BANDWIDTH_NORMAL);
 
-    Serial.print("Starting BLE stack as Central. Expecting 'true':");
-    bool ret = Bluefruit.begin(0, 1);  // 0 peripheral, 1 central
-    Serial.println(ret);
+    PM_LOG(BLE, INFO, "Starting BLE stack as Central. Expecting 'true':");
+    bool ret = Bluefruit.begin(0, meterCount);  // 0 peripheral, 每路功率计一个central连接
+    PM_LOG(BLE, INFO, "%d\n", ret);
     
     // 初始化蓝牙客户端
     initBLEClient();
-    Serial.print("Starting ANT stack. Expecting 'true':");
-    ret = ANTplus.begin(1);
-    Serial.println(ret);
-    ANTProfile* profiles[] = {pwr};
-    for (auto i: profiles)
+    PM_LOG(SDANT, INFO, "Starting ANT stack. Expecting 'true':");
+    ret = ANTplus.begin(meterCount);
+    PM_LOG(SDANT, INFO, "%d\n", ret);
+    for (uint8_t i = 0; i < meterCount; i++)
     {
-        Serial.printf("Channel number for %s became %d\n", i->getName(), i->getChannelNumber());
+        PM_LOG(SDANT, INFO, "Channel number for %s became %d\n", links[i].pwr->getName(), links[i].pwr->getChannelNumber());
+    }
+
+    // 会话记录：通道打开后再挂上ANT发送钩子，此后只有ANT任务发送
+    if (!Recorder.begin()) {
+        PM_LOGLN(BLE, ERROR, "Session recorder unavailable (file system mount failed)");
+    } else if (config.recordSession) {
+        Recorder.Start();
     }
     
-    // 初始化虚拟数据时间戳
-    nextProfileUpdate = millis();
-    lastVirtualDataUpdate = millis();
-    lastCadenceUpdate = millis();
+    // 霍尔传感器踏频：边沿由硬件定时器捕获，update()中取出每圈周期
+    if (config.hallPin != CRANK_PIN_NONE) {
+        if (Crank.begin(config.hallPin)) {
+            PM_LOG(BLE, INFO, "Hall sensor cadence on pin %u\n", config.hallPin);
+        } else {
+            PM_LOG(BLE, ERROR, "Hall sensor capture on pin %u failed\n", config.hallPin);
+        }
+    }
     
-    Serial.println("Virtual PowerMeter initialized successfully!");
-    Serial.printf("Base Power: %dW, Base Cadence: %dRPM\n", basePower, baseCadence);
-    Serial.printf("Startup is complete.\n");
+    PM_LOGLN(BLE, INFO, "Virtual PowerMeter initialized successfully!");
+    PM_LOG(BLE, INFO, "Base Power: %dW, Base Cadence: %dRPM, Workout Seed: %lu\n", basePower, baseCadence,
+                 (unsigned long)links[0].workout.seed());
+    PM_LOG(BLE, INFO, "Startup is complete.\n");
     
     // 串口命令使用提示
-    Serial.println("\n============================");
-    Serial.println("Serial Commands Available:");
-    Serial.println("Type 'help' for command list");
-    Serial.println("Type 'scan' to start BLE scan");
-    Serial.println("Notifications will auto-enable on connect");
-    Serial.println("============================\n");
+    PM_LOGLN(BLE, INFO, "\n============================");
+    PM_LOGLN(BLE, INFO, "Serial Commands Available:");
+    PM_LOGLN(BLE, INFO, "Type 'help' for command list");
+    PM_LOGLN(BLE, INFO, "Type 'scan' to start BLE scan");
+    PM_LOGLN(BLE, INFO, "Notifications will auto-enable on connect");
+    PM_LOGLN(BLE, INFO, "============================\n");
 }
 
-void PowerMeter::generateVirtualData() // 生成虚拟的功率和踏频数据
+void PowerMeter::generateVirtualData(MeterLink& link) // 按虚拟训练每个ANT+周期生成一个功率和踏频样本
 {
     uint32_t currentTime = millis();
+    uint16_t period = BicyclePower::PeriodForMode(link.pwr->GetPeriodMode());
     
-    // 每1秒更新一次虚拟数据
-    if (currentTime - lastVirtualDataUpdate >= virtualDataInterval) 
-    {
-        // 生成功率：基础100W，随机浮动±20W
-        int powerVariation = random(-20, 21); // -20到+20的随机数
-        instPWR = basePower + powerVariation;
-        if (instPWR < 0) instPWR = 0; // 确保功率不为负数
-        
-        // 生成踏频：基础70RPM，随机浮动±10RPM
-        int cadenceVariation = random(-10, 11); // -10到+10的随机数
-        instCAD = baseCadence + cadenceVariation;
-        if (instCAD < 0) instCAD = 0; // 确保踏频不为负数
-        
-        // 累积功率和事件计数
-        accPWR += instPWR;
-        PWREventCount++;
-        
-        lastVirtualDataUpdate = currentTime;
+    // 第n个样本的时刻 = virtualStart + n个周期；首次进入、周期切换或停顿 (如连接期间) 后
+    // 从当前时刻重新开始计数，不补发中间的样本，训练进度从停下的地方继续
+    uint32_t due = link.virtualStart + (uint32_t)((uint64_t)(link.virtualSamples + 1) * period * 1000 / 32768);
+    if (link.virtualPeriod != period || (int32_t)(currentTime - due) > PM_VIRTUAL_RESYNC_MS) {
+        link.virtualPeriod = period;
+        link.virtualStart = currentTime;
+        link.virtualSamples = 0;
+        return;
+    }
+    
+    // update()可能晚于样本时刻，补齐所有到期的样本，累积功率和事件计数与周期数一致
+    while ((int32_t)(currentTime - due) >= 0) {
+        workout_sample_t sample = link.workout.Next(period, basePower, baseCadence);
+        link.instPWR = sample.watts;
+        link.instCAD = sample.cadence;
+        link.accPWR += link.instPWR;
+        link.PWREventCount++;
+        link.metrics.addSample(due, link.instPWR);
+        link.virtualSamples++;
+        publishSample(link, PerfTrace::Now(), true);
         
-        // 输出调试信息
-        Serial.printf("Virtual Data - Power: %dW, Cadence: %dRPM\n", instPWR, instCAD);
+        PM_DLOG(XDS, DEBUG, "Virtual Data - Power: %uW, Cadence: %uRPM, Step: %u", link.instPWR, link.instCAD,
+                link.workout.stepIndex());
+        due = link.virtualStart + (uint32_t)((uint64_t)(link.virtualSamples + 1) * period * 1000 / 32768);
     }
 }
 
-void PowerMeter::simulateHallInterrupt() // 模拟霍尔传感器中断，用于踏频计算
+// 取出霍尔传感器捕获的每圈周期，换算为踏频 (只用于第0路)
+void PowerMeter::processCrankEvents(uint32_t now)
 {
-    uint32_t currentTime = millis();
-    
-    // 根据当前踏频计算中断间隔
-    // 踏频 = 60 / (间隔秒数)，所以间隔 = 60000ms / 踏频
-    uint32_t expectedInterval = (instCAD > 0) ? (60000 / instCAD) : 1000;
+    crank_event_t event;
+    while (Crank.Pop(event)) {
+        crankLastRevolution = now;
+        crankPeriodUs = event.period_us;
+        if (event.period_us == 0) continue;     // 停止后的第一圈没有周期
+        uint32_t rpm = (60u * CRANK_TIMER_HZ + event.period_us / 2) / event.period_us;
+        crankCadence = (uint8_t)(rpm > 254 ? 254 : rpm);
+        PM_DLOG(XDS, DEBUG, "Crank - Period: %uus, Cadence: %uRPM", event.period_us, crankCadence);
+    }
     
-    // 模拟霍尔传感器中断
-    if (currentTime - lastCadenceUpdate >= expectedInterval) 
-    {
-        lastCadenceUpdate = currentTime;
-        
-        // 这里可以添加一些踏频相关的处理逻辑
-        // 但主要的数据生成在generateVirtualData()中完成
-        Serial.printf("Simulated Hall Interrupt - Cadence: %dRPM\n", instCAD);
+    // 超过上一圈的周期仍没有新的一圈时，踏频按已等待的时间下降，停止后为0
+    uint32_t waitedMs = now - crankLastRevolution;
+    if (crankCadence != 0 && waitedMs * 1000 > crankPeriodUs) {
+        if (waitedMs * 1000 >= CRANK_STOP_US) {
+            crankCadence = 0;
+        } else if (60000 / waitedMs < crankCadence) {
+            crankCadence = (uint8_t)(60000 / waitedMs);
+        }
     }
 }
 
@@ -161,539 +316,1135 @@ void PowerMeter::update()
     // 处理串口命令
     processSerialCommands();
     
+    // 实时重放：到期的轨迹帧与通知回调一样入队
+    replay.Service(*this, millis());
+    
+    // 踏频先更新，随后发布的样本带上最新值
+    if (Crank.IsRunning()) processCrankEvents(millis());
+    
+    // 取出通知回调入队的样本并解析
+    for (uint8_t i = 0; i < meterCount; i++) {
+        processSampleQueue(links[i]);
+    }
+    
     uint32_t currentTime = millis();
     static uint32_t lastStatusCheck = 0;
-    static uint32_t lastDataRequest = 0;
     
     // 每5秒检查一次连接状态
     if (currentTime - lastStatusCheck > 5000) {
         lastStatusCheck = currentTime;
-        if (isConnected) {
-            Serial.printf("Status: Connected, lastValidDataTime: %d, currentTime: %d\n", 
-                         lastValidDataTime, currentTime);
+        if (connectedCount > 0) {
+            PM_LOG(BLE, INFO, "Status: Connected %d/%d\n", connectedCount, meterCount);
         } else {
-            Serial.println("Status: Not connected");
+            PM_LOGLN(BLE, INFO, "Status: Not connected");
         }
     }
     
-    // 检查数据超时 (仅在已连接时检查)
-    if (isConnected && lastValidDataTime > 0) {
-        if (currentTime - lastValidDataTime > dataTimeoutMs) {
-            Serial.printf("Warning: No valid data received for %d ms\n", currentTime - lastValidDataTime);
-            
-            // 如果超时时间过长，考虑重新扫描
-            if (currentTime - lastValidDataTime > dataTimeoutMs * 2) {
-                Serial.println("Data timeout exceeded, attempting reconnection...");
-                // 这里可以添加重新连接逻辑
-                // 暂时切换到虚拟数据模式
-                if (isConnected) {
-                    Serial.println("Switching to virtual data mode due to timeout");
-                }
-            }
+    // 蓝牙回调投递的扫描/连接/断开事件，之后是连接超时、退避重连、数据中断断开
+    processLinkEvents(currentTime);
+    serviceConnections(currentTime);
+    
+    for (uint8_t i = 0; i < meterCount; i++) {
+        MeterLink& link = links[i];
+        
+        // 单车模式下未连接或数据超时时生成虚拟数据；网关模式下空闲通道不发送虚拟功率
+        if (meterCount == 1 && !replay.IsActive() &&
+            (!link.isConnected || (link.lastValidDataTime > 0 && currentTime - link.lastValidDataTime > dataTimeoutMs))) {
+            generateVirtualData(link);
         }
     }
     
-    // 如果没有连接到蓝牙功率计，或者数据超时，则生成虚拟数据
-    if (!isConnected || (lastValidDataTime > 0 && currentTime - lastValidDataTime > dataTimeoutMs)) {
-        generateVirtualData();
-        simulateHallInterrupt();
-    }
+    // ANT+数据由publishSample()在每个新样本时发布，ANT任务在EVENT_TX时读取
     
-    // 定期发送ANT+数据
-    if (millis() > nextProfileUpdate)
-    {
-        nextProfileUpdate += config.profileUpdateCycle;
-        pwr->SetInstantPWR(instPWR);
-        pwr->SetAccumulatedPWR(accPWR);
-        pwr->SetPWREventCount(PWREventCount);
-        pwr->SetInstantCadence(0xFF);  // 0xFF = OFF, 暂时禁用踏频数据
-        
-        // 确定数据源
-        // bool usingRealData = isConnected && (lastValidDataTime > 0 && currentTime - lastValidDataTime <= dataTimeoutMs);
-        bool usingRealData = isConnected;
-        
-        if (usingRealData) {
-            Serial.printf("ANT+ Data Sent (XDS BLE) - Power: %dW, Cadence: OFF, AccPWR: %d, Events: %d\n", 
-                         instPWR, accPWR, PWREventCount);
-        } else {
-            Serial.printf("ANT+ Data Sent (Virtual) - Power: %dW, Cadence: OFF, AccPWR: %d, Events: %d\n", 
-                         instPWR, accPWR, PWREventCount);
-        }
-        
-        // 定期打印数据质量统计 (每分钟一次)
-        static uint32_t lastStatsTime = 0;
-        if (currentTime - lastStatsTime > 60000) {  // 60秒
-            lastStatsTime = currentTime;
-            if (validDataCount > 0 || invalidDataCount > 0) {
-                float errorRate = (float)invalidDataCount / (validDataCount + invalidDataCount) * 100.0;
-                Serial.printf("=== Data Quality Report ===\n");
-                Serial.printf("Valid packets: %d, Invalid packets: %d\n", validDataCount, invalidDataCount);
-                Serial.printf("Error rate: %.2f%%, Data quality: %s\n", errorRate, dataQualityGood ? "Good" : "Poor");
-                Serial.printf("Last valid data: %d ms ago\n", lastValidDataTime > 0 ? currentTime - lastValidDataTime : 0);
-                Serial.printf("Connection status: %s\n", isConnected ? "Connected" : "Disconnected");
-                Serial.println("===========================");
+    // 定期打印数据质量统计 (每分钟一次)
+    static uint32_t lastStatsTime = 0;
+    if (currentTime - lastStatsTime > 60000) {  // 60秒
+        lastStatsTime = currentTime;
+        for (uint8_t i = 0; i < meterCount; i++) {
+            MeterLink& link = links[i];
+            if (link.quality.frameCount() > 0) {
+                printQualityReport(link);
             }
+            link.quality.Reset();  // 每份报告覆盖最近一个窗口
         }
     }
 }
 
 // 蓝牙客户端方法实现
 void PowerMeter::initBLEClient() {
-    Serial.println("Initializing BLE Client...");
+    PM_LOGLN(BLE, INFO, "Initializing BLE Client...");
     
     // 设置设备名称
     Bluefruit.setName("PowerMeter Central");
     
-    // 初始化Mesh Proxy服务
-    meshProxyService.begin();
+    // 每路一组客户端对象，发现时绑定到各自的连接
+    for (uint8_t i = 0; i < meterCount; i++) {
+        // 初始化Mesh Proxy服务
+        links[i].meshProxyService.begin();
+        
+        // 初始化Cycling Power Measurement特征值
+        links[i].powerMeasurementChar.setNotifyCallback(staticPowerMeasurementNotify);
+        links[i].powerMeasurementChar.begin(&links[i].meshProxyService);
+    }
     
-    // 初始化Cycling Power Measurement特征值
-    powerMeasurementChar.setNotifyCallback(staticPowerMeasurementNotify);
-    powerMeasurementChar.begin();
+    // 新连接直接使用策略的连接间隔，发现服务后再请求一次完整参数
+    const conn_policy_params_t& policy = connPolicies[config.connPolicy];
+    Bluefruit.Central.setConnInterval(policy.interval, policy.interval);
+    Bluefruit.Central.setConnSupervisionTimeout(policy.supervisionTimeout);
     
     // 设置连接回调
     Bluefruit.Central.setConnectCallback(staticConnectCallback);
     Bluefruit.Central.setDisconnectCallback(staticDisconnectCallback);
     
-    Serial.println("BLE Client initialized successfully!");
+    PM_LOGLN(BLE, INFO, "BLE Client initialized successfully!");
 }
 
 void PowerMeter::startScanning() {
     if (isScanning) {
-        Serial.println("Already scanning...");
+        PM_LOGLN(BLE, INFO, "Already scanning...");
+        return;
+    }
+    if (findFreeLink() == NULL) {
+        PM_LOGLN(BLE, INFO, "All meter slots connected, not scanning");
         return;
     }
     
-    Serial.println("Starting BLE scan for power meters...");
-    Serial.printf("Looking for service UUID: 0x%04X\n", MESH_PROXY_SERVICE_UUID);
+    PM_LOGLN(BLE, INFO, "Starting BLE scan for power meters...");
+    PM_LOG(BLE, INFO, "Looking for service UUID: 0x%04X\n", MESH_PROXY_SERVICE_UUID);
     
-    // 设置扫描回调
+    // 设置扫描回调；服务UUID在回调中检查，先用地址过滤掉重复的无关设备
     Bluefruit.Scanner.setRxCallback(staticScanCallback);
-    Bluefruit.Scanner.filterUuid(meshProxyService.uuid);
     
-    // 设置扫描参数以确保持续扫描
-    Bluefruit.Scanner.restartOnDisconnect(true);
+    // 断开后由状态机决定直连还是扫描
+    Bluefruit.Scanner.restartOnDisconnect(false);
     
-    // 开始扫描
-    Bluefruit.Scanner.start(0);  // 0 = 永久扫描直到找到设备
+    // 每次开始扫描都先进入快速阶段
+    startScanPhase(SCAN_PHASE_FAST, millis());
     isScanning = true;
     
-    Serial.println("BLE scanning started successfully");
-    Serial.println("Scanning will continue until correct device is found...");
+    PM_LOGLN(BLE, INFO, "BLE scanning started successfully");
+    PM_LOGLN(BLE, INFO, "Scanning will continue until correct device is found...");
+}
+
+// 按阶段设置扫描窗口并(重新)开始扫描，设置只在start()时生效
+void PowerMeter::startScanPhase(scan_phase_t phase, uint32_t now) {
+    if (isScanning) Bluefruit.Scanner.stop();
+    if (phase == SCAN_PHASE_FAST) {
+        Bluefruit.Scanner.setInterval(PM_SCAN_FAST_INTERVAL, PM_SCAN_FAST_WINDOW);
+    } else {
+        Bluefruit.Scanner.setInterval(PM_SCAN_SLOW_INTERVAL, PM_SCAN_SLOW_WINDOW);
+    }
+    scanPhase = phase;
+    scanPhaseSince = now;
+    scanStats[phase].starts++;
+    Bluefruit.Scanner.start(0);  // 0 = 永久扫描直到找到设备
+}
+
+// 等待扫描的通道
+MeterLink* PowerMeter::findFreeLink() {
+    for (uint8_t i = 0; i < meterCount; i++) {
+        if (links[i].state == LINK_FREE) return &links[i];
+    }
+    return NULL;
+}
+
+// 扫描发现的功率计优先回到它原来的通道 (保持ANT+设备号不变)，
+// 其次分配从未连接过的空闲通道，最后才占用缓存了其他地址的空闲通道
+MeterLink* PowerMeter::findLinkForPeer(const ble_gap_addr_t& addr) {
+    for (uint8_t i = 0; i < meterCount; i++) {
+        MeterLink& link = links[i];
+        if ((link.state == LINK_FREE || link.state == LINK_BACKOFF) && link.peerKnown &&
+            memcmp(link.peerAddr.addr, addr.addr, BLE_GAP_ADDR_LEN) == 0) {
+            return &link;
+        }
+    }
+    for (uint8_t i = 0; i < meterCount; i++) {
+        if (links[i].state == LINK_FREE && !links[i].peerKnown) return &links[i];
+    }
+    return findFreeLink();
+}
+
+void PowerMeter::setLinkState(MeterLink& link, link_state_t state, uint32_t now) {
+    PM_LOG(BLE, DEBUG, "%s: %s -> %s\n", link.pwr->getName(), linkStateName(link.state), linkStateName(state));
+    link.state = state;
+    link.stateSince = now;
+}
+
+// 连续失败时退避时间翻倍，直到PM_RECONNECT_MAX_MS
+void PowerMeter::enterBackoff(MeterLink& link, uint32_t now) {
+    uint32_t wait = PM_RECONNECT_MIN_MS << (link.retryCount < 16 ? link.retryCount : 16);
+    if (wait > PM_RECONNECT_MAX_MS) wait = PM_RECONNECT_MAX_MS;
+    if (link.retryCount < 255) link.retryCount++;
+    link.retryAt = now + wait;
+    setLinkState(link, LINK_BACKOFF, now);
+    PM_LOG(BLE, INFO, "%s: retry %u in %lu ms\n", link.pwr->getName(), link.retryCount, (unsigned long)wait);
+}
+
+// 按缓存地址直接发起连接，省去扫描和广播过滤；扫描器与连接不能同时进行
+void PowerMeter::beginDirectConnect(MeterLink& link, uint32_t now) {
+    if (isScanning) {
+        Bluefruit.Scanner.stop();
+        isScanning = false;
+    }
+    link.connectDirect = true;
+    connectingLink = &link;
+    cancelledLink = NULL;
+    setLinkState(link, LINK_CONNECTING, now);
+    PM_LOG(BLE, INFO, "%s: reconnecting directly to last peer\n", link.pwr->getName());
+    if (!Bluefruit.Central.connect(&link.peerAddr)) {
+        connectingLink = NULL;
+        enterBackoff(link, now);
+    }
+}
+
+// 连接状态机：每次update()调用一次，只比较时间戳，不阻塞
+void PowerMeter::serviceConnections(uint32_t now) {
+    for (uint8_t i = 0; i < meterCount; i++) {
+        MeterLink& link = links[i];
+        switch (link.state) {
+            case LINK_CONNECTING:
+                // SoftDevice连接超时不回调，由这里取消
+                if (now - link.stateSince > PM_CONNECT_TIMEOUT_MS) {
+                    sd_ble_gap_connect_cancel();
+                    connectingLink = NULL;
+                    cancelledLink = &link;   // 连接事件可能已经在队列中
+                    link.connectTimeouts++;
+                    PM_LOG(BLE, WARN, "%s: connect attempt timed out\n", link.pwr->getName());
+                    enterBackoff(link, now);
+                }
+                break;
+                
+            case LINK_BACKOFF:
+                if ((int32_t)(now - link.retryAt) >= 0 && connectingLink == NULL) {
+                    if (link.peerKnown && link.retryCount <= PM_RECONNECT_DIRECT_TRIES) {
+                        beginDirectConnect(link, now);
+                    } else {
+                        PM_LOG(BLE, INFO, "%s: falling back to scan\n", link.pwr->getName());
+                        setLinkState(link, LINK_FREE, now);
+                    }
+                }
+                break;
+                
+            case LINK_CONNECTED: {
+                // 连接后一直没有数据 (例如发现失败) 也按中断处理
+                uint32_t lastData = link.lastValidDataTime > 0 ? link.lastValidDataTime : link.stateSince;
+                uint32_t silentMs = now - lastData;
+                if (silentMs > dataTimeoutMs * PM_DATA_STALL_FACTOR) {
+                    PM_LOG(BLE, WARN, "%s: no valid data for %lu ms, reconnecting\n", link.pwr->getName(), (unsigned long)silentMs);
+                    link.stallDisconnects++;
+                    setLinkState(link, LINK_DISCONNECTING, now);
+                    Bluefruit.disconnect(link.connectionHandle);  // 断开回调进入BACKOFF
+                } else if (link.connParamRequestTime != 0 && now - link.connParamRequestTime > PM_CONN_PARAM_VERIFY_MS) {
+                    verifyConnParams(link, now);
+                } else if (link.lastValidDataTime > 0 && silentMs > dataTimeoutMs && !link.dataTimeoutWarned) {
+                    link.dataTimeoutWarned = true;
+                    PM_LOG(BLE, WARN, "Warning: %s no valid data received for %lu ms\n", link.pwr->getName(), (unsigned long)silentMs);
+                }
+                break;
+            }
+                
+            case LINK_FREE:
+            case LINK_DISCONNECTING:
+                break;
+        }
+    }
+    
+    // 快速阶段没有发现设备时降为低占空比，功率计重新出现时仍能被发现
+    if (isScanning && scanPhase == SCAN_PHASE_FAST && now - scanPhaseSince > PM_SCAN_FAST_MS) {
+        PM_LOGLN(BLE, INFO, "No power meter found yet, switching to low duty cycle scan");
+        startScanPhase(SCAN_PHASE_SLOW, now);
+    }
+    resumeScanIfFree();
+}
+
+void PowerMeter::bindLink(MeterLink& link, uint16_t conn_handle) {
+    link.connectionHandle = conn_handle;
+    link.isConnected = true;
+    link.peerKnown = true;
+    link.retryCount = 0;
+    if (link.disconnectTime != 0) {
+        if (link.connectDirect) link.directReconnects++;
+        else link.scanReconnects++;
+    }
+    setLinkState(link, LINK_CONNECTED, millis());
+    link.lastValidDataTime = 0;
+    link.quality.Restart();
+    link.validator.Restart();
+    link.dataQualityGood = true;
+    connectedCount++;
+    if (conn_handle < BLE_MAX_CONNECTION) linkByConn[conn_handle] = &link;
+}
+
+void PowerMeter::unbindLink(MeterLink& link) {
+    if (link.connectionHandle < BLE_MAX_CONNECTION) linkByConn[link.connectionHandle] = NULL;
+    link.isConnected = false;
+    link.connectionHandle = BLE_CONN_HANDLE_INVALID;
+    link.notificationsEnabled = false;  // 重置通知状态
+    connectedCount--;
+}
+
+// 还有空闲通道且没有进行中的连接时继续扫描下一台功率计
+void PowerMeter::resumeScanIfFree() {
+    if (!isScanning && connectingLink == NULL && findFreeLink() != NULL) {
+        startScanning();
+    }
 }
 
 void PowerMeter::onConnect(uint16_t conn_handle) {
-    Serial.printf("Connected to power meter, handle: %d\n", conn_handle);
-    connectionHandle = conn_handle;
-    isConnected = true;
+    MeterLink* slot = connectingLink;
+    if (slot == NULL && cancelledLink != NULL && cancelledLink->state == LINK_BACKOFF) {
+        // 取消时连接已经建立：属于刚超时的那次请求，保留而不是断开
+        slot = cancelledLink;
+        PM_LOG(BLE, INFO, "%s: connected as the attempt timed out, keeping it\n", slot->pwr->getName());
+    }
+    connectingLink = NULL;
+    cancelledLink = NULL;
+    if (slot == NULL || conn_handle >= BLE_MAX_CONNECTION) {
+        PM_LOG(BLE, WARN, "No free meter slot for handle %d, disconnecting\n", conn_handle);
+        Bluefruit.disconnect(conn_handle);
+        return;
+    }
+    MeterLink& link = *slot;
+    PM_LOG(BLE, INFO, "Connected to power meter, handle: %d -> %s\n", conn_handle, link.pwr->getName());
+    bindLink(link, conn_handle);
     
     // 发现服务
-    if (meshProxyService.discover(conn_handle)) {
-        Serial.println("Mesh Proxy Service discovered");
+    if (link.meshProxyService.discover(conn_handle)) {
+        PM_LOGLN(BLE, INFO, "Mesh Proxy Service discovered");
         
         // 发现特征值
-        if (powerMeasurementChar.discover()) {
-            Serial.println("Cycling Power Measurement characteristic discovered");
+        if (link.powerMeasurementChar.discover()) {
+            PM_LOGLN(BLE, INFO, "Cycling Power Measurement characteristic discovered");
             
             // 自动启用通知
-            Serial.println("Auto-enabling notifications...");
-            if (powerMeasurementChar.enableNotify()) {
-                notificationsEnabled = true;
-                Serial.println("✓ Power measurement notifications enabled automatically");
-                Serial.println("Use 'disable' command to stop notifications if needed");
+            PM_LOGLN(BLE, INFO, "Auto-enabling notifications...");
+            if (link.powerMeasurementChar.enableNotify()) {
+                link.notificationsEnabled = true;
+                PM_LOGLN(BLE, INFO, "✓ Power measurement notifications enabled automatically");
+                PM_LOGLN(BLE, INFO, "Use 'disable' command to stop notifications if needed");
+                link.connParamRetries = 0;
+                requestConnParams(link, millis());
             } else {
-                Serial.println("✗ Failed to enable power measurement notifications");
-                Serial.println("Use 'enable' command to try manually");
+                PM_LOGLN(BLE, INFO, "✗ Failed to enable power measurement notifications");
+                PM_LOGLN(BLE, INFO, "Use 'enable' command to try manually");
             }
-            Serial.println("Type 'help' for available commands");
+            PM_LOGLN(BLE, INFO, "Type 'help' for available commands");
         } else {
-            Serial.println("Failed to discover Cycling Power Measurement characteristic");
+            PM_LOGLN(BLE, INFO, "Failed to discover Cycling Power Measurement characteristic");
         }
     } else {
-        Serial.println("Failed to discover Mesh Proxy Service");
+        PM_LOGLN(BLE, INFO, "Failed to discover Mesh Proxy Service");
     }
+    
+    resumeScanIfFree();
 }
 
-void PowerMeter::onDisconnect(uint16_t conn_handle, uint8_t reason) {
-    Serial.printf("Disconnected from power meter, handle: %d, reason: 0x%02X\n", conn_handle, reason);
-    isConnected = false;
-    connectionHandle = 0;
-    notificationsEnabled = false;  // 重置通知状态
+// 按当前策略请求连接参数；结果由参数更新事件异步生效，稍后在verifyConnParams()中核对
+void PowerMeter::requestConnParams(MeterLink& link, uint32_t now) {
+    const conn_policy_params_t& policy = connPolicies[config.connPolicy];
+    BLEConnection* conn = Bluefruit.Connection(link.connectionHandle);
+    link.connParamsOk = false;
+    link.connParamRequestTime = 0;
+    if (conn == NULL) return;
+    if (conn->requestConnectionParameter(policy.interval, policy.slaveLatency, policy.supervisionTimeout)) {
+        link.connParamRequestTime = now != 0 ? now : 1;
+        PM_LOG(BLE, INFO, "%s: requesting %s connection parameters\n", link.pwr->getName(), policy.name);
+    } else {
+        PM_LOG(BLE, WARN, "%s: connection parameter request rejected by the stack\n", link.pwr->getName());
+    }
+}
+
+// 读回实际生效的参数；功率计可能拒绝或随后请求自己的参数，不一致时有限次重试
+void PowerMeter::verifyConnParams(MeterLink& link, uint32_t now) {
+    const conn_policy_params_t& policy = connPolicies[config.connPolicy];
+    BLEConnection* conn = Bluefruit.Connection(link.connectionHandle);
+    link.connParamRequestTime = 0;
+    if (conn == NULL) return;
+    link.connInterval = conn->getConnectionInterval();
+    link.connLatency = conn->getSlaveLatency();
+    link.connTimeout = conn->getSupervisionTimeout();
+    link.connParamsOk = link.connInterval == policy.interval && link.connLatency == policy.slaveLatency;
     
-    // 重新开始扫描
-    Serial.println("Restarting scan...");
-    delay(1000);  // 等待1秒后重新扫描
-    startScanning();
+    uint32_t tenths = connIntervalTenthsMs(link.connInterval);
+    if (link.connParamsOk) {
+        PM_LOG(BLE, INFO, "%s: connection interval %lu.%lu ms, latency %u granted\n", link.pwr->getName(),
+               (unsigned long)(tenths / 10), (unsigned long)(tenths % 10), link.connLatency);
+    } else if (link.connParamRetries < PM_CONN_PARAM_RETRIES) {
+        link.connParamRetries++;
+        PM_LOG(BLE, WARN, "%s: got interval %lu.%lu ms, latency %u; retrying\n", link.pwr->getName(),
+               (unsigned long)(tenths / 10), (unsigned long)(tenths % 10), link.connLatency);
+        requestConnParams(link, now);
+    } else {
+        PM_LOG(BLE, WARN, "%s: keeping interval %lu.%lu ms, latency %u chosen by the meter\n", link.pwr->getName(),
+               (unsigned long)(tenths / 10), (unsigned long)(tenths % 10), link.connLatency);
+    }
 }
 
-void PowerMeter::onPowerMeasurementNotify(BLEClientCharacteristic* chr, uint8_t* data, uint16_t len) {
-    Serial.printf("Received power data (%d bytes): ", len);
-    for (int i = 0; i < len; i++) {
-        Serial.printf("%02X ", data[i]);
+void PowerMeter::onDisconnect(uint16_t conn_handle, uint8_t reason) {
+    MeterLink* link = conn_handle < BLE_MAX_CONNECTION ? linkByConn[conn_handle] : NULL;
+    PM_LOG(BLE, INFO, "Disconnected from power meter, handle: %d, reason: 0x%02X\n", conn_handle, reason);
+    if (link == NULL) {
+        return;  // 未分配通道的连接 (例如通道已满时被拒绝)
     }
-    Serial.println();
+    unbindLink(*link);
     
-    // 解析功率数据
-    parsePowerData(data, len);
+    // 只记录并进入退避，重连由serviceConnections()完成
+    uint32_t now = millis();
+    if (link->disconnectTime == 0) link->disconnectTime = now;
+    link->retryCount = 0;
+    enterBackoff(*link, now);
 }
 
-void PowerMeter::parsePowerData(uint8_t* data, uint16_t len) {
-    Serial.printf("Parsing power data, length: %d bytes\n", len);
-    
-    // 打印原始数据用于调试
-    Serial.print("Raw data: ");
-    for (int i = 0; i < len; i++) {
-        Serial.printf("%02X ", data[i]);
+// 发布一个完整样本供ANT任务在下一次EVENT_TX时编码
+// fromWorkout：样本来自虚拟训练，踏频是训练模型给出的值
+void PowerMeter::publishSample(MeterLink& link, uint32_t originCycles, bool fromWorkout) {
+    pwr_sample_t sample;
+    // 平滑只作用于显示的瞬时功率；累积功率仍按原始值，接收端的平均功率不受影响。
+    // 重放链路用固定值，帧摘要不随 "smooth" 设置变化
+    uint8_t smoothing = link.replay ? TRACE_REPLAY_SMOOTHING : config.powerSmoothing;
+    sample.instant_power = smoothing != 0 && link.metrics.countedSeconds() > 0
+                               ? link.metrics.average(smoothing) : link.instPWR;
+    sample.accumulated_power = link.accPWR;
+    sample.event_count = link.PWREventCount;
+    // 踏频优先取霍尔传感器 (第0路)；没有传感器时虚拟训练发送与功率耦合的模型踏频，
+    // 喜德盛帧的踏频不发送 (0xFF = OFF)。快速重放的私有链路不是links[0]，不取在线踏频
+    if (Crank.IsRunning() && &link == &links[0]) {
+        sample.instant_cadence = crankCadence;
+    } else {
+        sample.instant_cadence = fromWorkout ? link.instCAD : 0xFF;
+    }
+    sample.timestamp = millis();
+    sample.origin_cycles = originCycles;
+    sample.publish_cycles = PerfTrace::Now();
+    link.pwr->PublishSample(sample);
+
+    // 延迟日志只接受整数参数，数据源用两条固定格式串区分
+    if (link.isConnected) {
+        PM_DLOG(ANT_TX, DEBUG, "ANT+ Sample #%u (XDS BLE) - Power: %uW, AccPWR: %u, Events: %u", 
+             link.index, link.instPWR, link.accPWR, link.PWREventCount);
+    } else {
+        PM_DLOG(ANT_TX, DEBUG, "ANT+ Sample #%u (Virtual) - Power: %uW, AccPWR: %u, Events: %u", 
+             link.index, link.instPWR, link.accPWR, link.PWREventCount);
+    }
+}
+
+// 运行在蓝牙回调上下文：只入队原始帧，解析在update()中完成
+void PowerMeter::onPowerMeasurementNotify(MeterLink& link, uint8_t* data, uint16_t len) {
+    uint32_t arrivalCycles = PerfTrace::Now();
+    if (len == 0 || len > XDS_FRAME_SIZE) {
+        link.sampleDropCount++;
+        return;
     }
-    Serial.println();
     
-    // 使用喜德盛数据解析
-    XdsPowerMeasurementData xdsData = parseXdsData(data, len);
+    XdsSample sample;
+    sample.arrivalTick = millis();
+    sample.arrivalCycles = arrivalCycles;
+    sample.len = (uint8_t)len;
+    memcpy(sample.data, data, len);
+    link.sampleQueue.Push(sample);  // 队列满时由队列计入溢出
+}
+
+void PowerMeter::processSampleQueue(MeterLink& link) {
+    XdsSample sample;
+    while (link.sampleQueue.Pop(sample)) {
+        link.quality.recordArrival(sample.arrivalTick);
+        Recorder.RecordBle(link.index, sample.arrivalTick, sample.data, sample.len);
+        parsePowerData(link, sample.data, sample.len, sample.arrivalTick, sample.arrivalCycles);
+    }
+}
+
+void PowerMeter::parsePowerData(MeterLink& link, uint8_t* data, uint16_t len, uint32_t arrivalTick, uint32_t arrivalCycles) {
+    // 长度在此检查一次，之后直接从缓冲区读取所需字段
+    XdsFrameView frame(data, len);
     
-    if (xdsData.isValid) {
-        // 更新功率和踏频数据
-        instPWR = xdsData.totalPower;
-        instCAD = xdsData.cadence;
+    if (frame.isValid() && link.validator.check(frame)) {
+        uint32_t parsedCycles = PerfTrace::Now();
+        // 快速重放的到达时间是虚构的，不进入在线链路的延迟统计
+        if (!link.replay) Perf.Record(PERF_NOTIFY_TO_PARSE, arrivalCycles, parsedCycles);
+        // 更新功率和踏频数据，单帧功率尖峰由窗口中值代替，不进入累积功率
+        link.instPWR = link.validator.filterPower(frame.totalPower());
+        link.instCAD = frame.cadence();
         
         // 更新累积功率
-        accPWR += instPWR;
-        PWREventCount++;
+        link.accPWR += link.instPWR;
+        link.PWREventCount++;
+        link.metrics.addSample(arrivalTick, link.instPWR);
+        link.metrics.addBalance(frame.leftPower(), frame.rightPower());
         
         // 更新最后有效数据时间
-        lastValidDataTime = millis();
-        validDataCount++;
-        
-        // 打印解析后的数据
-        Serial.printf("=== Xidesheng Power Data ===\n");
-        Serial.printf("Total Power: %dW\n", xdsData.totalPower);
-        Serial.printf("Left Power: %dW\n", xdsData.leftPower);
-        Serial.printf("Right Power: %dW\n", xdsData.rightPower);
-        Serial.printf("Cadence: %dRPM\n", xdsData.cadence);
-        Serial.printf("Angle: %d degrees\n", xdsData.angle);
-        Serial.printf("Error Code: 0x%02X\n", xdsData.errorCode);
-        Serial.println("============================");
+        link.lastValidDataTime = arrivalTick;
+        link.dataTimeoutWarned = false;
+        if (link.disconnectTime != 0) {
+            link.reconnectGaps.Record(arrivalTick - link.disconnectTime);
+            link.disconnectTime = 0;
+        }
+        link.quality.recordOutcome(frame.errorCode() == 0 ? XDS_PARSE_OK : XDS_PARSE_ERROR_CODE);
+        link.quality.recordErrorCode(frame.errorCode());
+        publishSample(link, arrivalCycles, false);
+        if (!link.replay) Perf.Record(PERF_PARSE_TO_PUBLISH, parsedCycles, PerfTrace::Now());
         
-        // 打印详细的数据分析
-        printXdsDataDetails(xdsData, data);
+        // 打印详细的数据分析 (延迟日志，不阻塞)
+        printXdsDataDetails(frame);
         
+    } else if (frame.isValid()) {
+        // 超出规则表范围：计数后丢弃，不更新功率和最后有效数据时间
+        link.quality.recordOutcome(XDS_PARSE_REJECTED);
+        link.quality.recordErrorCode(frame.errorCode());
+        PM_DLOG(XDS, DEBUG, "XDS frame rejected - Power: %uW, Cadence: %uRPM, Error: 0x%02X",
+                frame.totalPower(), frame.cadence(), frame.errorCode());
     } else {
-        invalidDataCount++;
-        Serial.printf("Invalid Xidesheng data packet (count: %d)\n", invalidDataCount);
+        link.quality.recordOutcome(XDS_PARSE_MALFORMED);
+        PM_DLOG(XDS, WARN, "Invalid Xidesheng data packet (count: %u, len: %u)", link.quality.outcomeCount(XDS_PARSE_MALFORMED), len);
         
         // 如果数据无效，尝试基本解析作为备用
         if (len >= 4) {
             uint16_t basicPower = (data[1] << 8) | data[0];
             uint16_t basicCadence = (data[3] << 8) | data[2];
-            Serial.printf("Fallback parsing - Power: %dW, Cadence: %dRPM\n", basicPower, basicCadence);
+            PM_DLOG(XDS, DEBUG, "Fallback parsing - Power: %uW, Cadence: %uRPM", basicPower, basicCadence);
         }
     }
 }
 
 // 静态回调函数实现
 void PowerMeter::staticPowerMeasurementNotify(BLEClientCharacteristic* chr, uint8_t* data, uint16_t len) {
-    Serial.println("Received power measurement notify");
-    if (instance) {
-        instance->onPowerMeasurementNotify(chr, data, len);
+    uint16_t conn_handle = chr->connHandle();
+    MeterLink* link = conn_handle < BLE_MAX_CONNECTION ? linkByConn[conn_handle] : NULL;
+    if (link && instance) {
+        instance->onPowerMeasurementNotify(*link, data, len);
     }
 }
 
+// 连接和断开回调运行在Bluefruit的回调任务中，只入队，状态由update()切换
 void PowerMeter::staticConnectCallback(uint16_t conn_handle) {
-    Serial.printf("staticConnectCallback called with handle: %d\n", conn_handle);
+    PM_LOG(BLE, DEBUG, "staticConnectCallback called with handle: %d\n", conn_handle);
     if (instance) {
-        instance->onConnect(conn_handle);
+        LinkEvent event;
+        memset(&event, 0, sizeof(event));
+        event.type = LINK_EVT_CONNECTED;
+        event.connHandle = conn_handle;
+        instance->postLinkEvent(instance->connEvents, event);
     } else {
-        Serial.println("ERROR: instance is null in staticConnectCallback");
+        PM_LOGLN(BLE, ERROR, "ERROR: instance is null in staticConnectCallback");
     }
 }
 
 void PowerMeter::staticDisconnectCallback(uint16_t conn_handle, uint8_t reason) {
     if (instance) {
-        instance->onDisconnect(conn_handle, reason);
+        LinkEvent event;
+        memset(&event, 0, sizeof(event));
+        event.type = LINK_EVT_DISCONNECTED;
+        event.reason = reason;
+        event.connHandle = conn_handle;
+        instance->postLinkEvent(instance->connEvents, event);
     }
 }
 
-void PowerMeter::staticScanCallback(ble_gap_evt_adv_report_t* report) {
-    if (instance) {
-        Serial.print("Scan found device: ");
-        Serial.printBufferReverse(report->peer_addr.addr, 6, ':');
-        Serial.print(", RSSI: ");
-        Serial.println(report->rssi);
-        
-        // 检查是否是喜德盛功率计
-        if (Bluefruit.Scanner.checkReportForService(report, instance->meshProxyService)) {
-            Serial.print("Found power meter with correct service: ");
-            Serial.printBufferReverse(report->peer_addr.addr, 6, ':');
-            Serial.println();
-            
-            // 停止扫描并连接
-            Bluefruit.Scanner.stop();
-            instance->isScanning = false;
-            
-            Serial.println("Attempting to connect...");
-            // 连接到设备
-            Bluefruit.Central.connect(report);
-        } else {
-            Serial.println("Device does not have the required service, continuing scan...");
-            // 明确地恢复扫描以确保继续
-            Bluefruit.Scanner.resume();
-        }
+void PowerMeter::postLinkEvent(SpscRing<LinkEvent, PM_LINK_EVENT_QUEUE_SIZE>& queue, const LinkEvent& event) {
+    if (!queue.Push(event)) {
+        PM_LOG(BLE, ERROR, "Link event queue full, event %u dropped\n", event.type);
     }
 }
 
-// 喜德盛功率计数据解析函数实现
-XdsPowerMeasurementData PowerMeter::parseXdsData(uint8_t* data, uint16_t len) {
-    XdsPowerMeasurementData result = {0};
-    
-    // 直接解析数据，不检查长度
-    if (len >= 2) result.totalPower = getUnsignedValue(data, 0);      // Byte 0-1: 总功率
-    if (len >= 4) result.leftPower = getSignedValue(data, 2);         // Byte 2-3: 左腿功率
-    if (len >= 6) result.rightPower = getSignedValue(data, 4);        // Byte 4-5: 右腿功率
-    if (len >= 8) result.angle = getSignedValue(data, 6);             // Byte 6-7: 角度
-    if (len >= 10) result.cadence = getUnsignedValue(data, 8);        // Byte 8-9: 踏频
-    if (len >= 11) result.errorCode = data[10];                       // Byte 10: 错误代码
-    
-    // 直接标记为有效，不进行验证
-    result.isValid = true;
-    
-    return result;
-}
-
-// 读取无符号16位整数 (小端序)
-uint16_t PowerMeter::getUnsignedValue(uint8_t* data, uint16_t offset) {
-    uint16_t low = data[offset] & 0xFF;
-    uint16_t high = data[offset + 1] & 0xFF;
-    return (high << 8) | low;
+// 按到达顺序处理回调投递的事件；连接状态机的所有转换都在update()的这一个上下文中
+void PowerMeter::processLinkEvents(uint32_t now) {
+    LinkEvent event;
+    while (connEvents.Pop(event)) {
+        if (event.type == LINK_EVT_CONNECTED) {
+            onConnect(event.connHandle);
+        } else {
+            onDisconnect(event.connHandle, event.reason);
+        }
+    }
+    while (scanEvents.Pop(event)) {
+        onPeerFound(event.peerAddr, now);
+    }
 }
 
-// 读取有符号16位整数 (小端序)
-int16_t PowerMeter::getSignedValue(uint8_t* data, uint16_t offset) {
-    uint16_t value = getUnsignedValue(data, offset);
-    // 如果最高位为1，则为负数
-    return (value & 0x8000) ? (int16_t)(value - 0x10000) : (int16_t)value;
+void PowerMeter::staticScanCallback(ble_gap_evt_adv_report_t* report) {
+    if (instance) {
+        instance->onScanReport(report);
+    }
 }
 
-// 验证喜德盛数据有效性
-bool PowerMeter::validateXdsData(const XdsPowerMeasurementData& data) {
-    // 检查错误代码
-    if (data.errorCode != 0) {
-        Serial.printf("XDS Error Code: %d\n", data.errorCode);
-        // 根据错误代码决定是否继续处理数据
-        if (data.errorCode > 10) {  // 严重错误
-            return false;
-        }
-        // 轻微错误，继续验证其他数据
+// 白名单中的地址，或某个通道缓存的功率计地址
+bool PowerMeter::isKnownPeer(const ble_gap_addr_t& addr) const {
+    for (uint8_t i = 0; i < allowlistCount; i++) {
+        if (memcmp(allowlist[i], addr.addr, BLE_GAP_ADDR_LEN) == 0) return true;
     }
-    
-    // 基本范围检查 - 总功率
-    if (data.totalPower > 2000) {  // 功率不应超过2000W
-        Serial.printf("Invalid total power: %dW (max 2000W)\n", data.totalPower);
-        return false;
+    for (uint8_t i = 0; i < meterCount; i++) {
+        if (links[i].peerKnown && memcmp(links[i].peerAddr.addr, addr.addr, BLE_GAP_ADDR_LEN) == 0) return true;
     }
+    return false;
+}
+
+// 运行在扫描回调上下文，拥挤环境中每秒可能数百次：
+// 已知地址直接交给update()；不在白名单或最近已拒绝的地址不解析广播；
+// 只有新地址才检查服务UUID，不匹配则记入过滤表。
+// 通道的地址缓存由update()写入，这里读到交错的值最多让一个报告多解析一次
+void PowerMeter::onScanReport(ble_gap_evt_adv_report_t* report) {
+    scan_phase_stats_t& stats = scanStats[scanPhase];
+    stats.reports++;
     
-    // 踏频范围检查
-    if (data.cadence > 200) {  // 踏频不应超过200RPM
-        Serial.printf("Invalid cadence: %dRPM (max 200RPM)\n", data.cadence);
-        return false;
+    uint32_t now = millis();
+    if (now - rejectedSince > PM_SCAN_REJECT_TTL_MS) {
+        rejectedPeers.Clear();
+        rejectedSince = now;
     }
     
-    // 角度范围检查 (-180° 到 +180°)
-    if (data.angle < -180 || data.angle > 180) {
-        Serial.printf("Invalid angle: %d° (range: -180° to +180°)\n", data.angle);
-        return false;
+    const uint8_t* addr = report->peer_addr.addr;
+    if (!isKnownPeer(report->peer_addr)) {
+        if (allowlistCount > 0 || rejectedPeers.Contains(addr)) {
+            stats.filtered++;
+            Bluefruit.Scanner.resume();
+            return;
+        }
+        // 检查是否是喜德盛功率计
+        if (!Bluefruit.Scanner.checkReportForService(report, links[0].meshProxyService)) {
+            stats.misses++;
+            rejectedPeers.Insert(addr);
+            PM_DLOG(BLE, DEBUG, "Scan: rejected %02X%02X%02X, RSSI %d",
+                    addr[5], addr[4], addr[3], report->rssi);
+            Bluefruit.Scanner.resume();
+            return;
+        }
     }
     
-    // 左右功率范围检查
-    if (data.leftPower < -100 || data.leftPower > 1500) {
-        Serial.printf("Invalid left power: %dW (range: -100W to 1500W)\n", data.leftPower);
-        return false;
+    // 扫描器在回调后保持暂停，直到update()连接或恢复扫描
+    LinkEvent event;
+    memset(&event, 0, sizeof(event));
+    event.type = LINK_EVT_FOUND;
+    event.peerAddr = report->peer_addr;
+    if (scanEvents.Push(event)) {
+        stats.hits++;
+    } else {
+        Bluefruit.Scanner.resume();
     }
-    
-    if (data.rightPower < -100 || data.rightPower > 1500) {
-        Serial.printf("Invalid right power: %dW (range: -100W to 1500W)\n", data.rightPower);
-        return false;
+}
+
+// 扫描发现的功率计：分配通道并连接，没有可用通道时恢复扫描
+void PowerMeter::onPeerFound(const ble_gap_addr_t& addr, uint32_t now) {
+    if (!isScanning) return;    // 扫描已停止 (例如改为直连)，报告作废
+    MeterLink* link = connectingLink == NULL ? findLinkForPeer(addr) : NULL;
+    if (link == NULL) {
+        Bluefruit.Scanner.resume();
+        return;
     }
-    
-    // 检查左右功率之和是否接近总功率 (允许15%误差)
-    int16_t calculatedTotal = data.leftPower + data.rightPower;
-    int16_t powerDiff = abs(calculatedTotal - (int16_t)data.totalPower);
-    if (data.totalPower > 10) {  // 只在有显著功率时检查
-        float errorPercent = (float)powerDiff / data.totalPower * 100.0;
-        if (errorPercent > 15.0) {
-            Serial.printf("Power mismatch: Total=%dW, L+R=%dW, Diff=%dW (%.1f%% error)\n", 
-                         data.totalPower, calculatedTotal, powerDiff, errorPercent);
-            // 不返回false，只是警告，因为可能是正常的测量误差
-        }
+    if (PM_LOG_ENABLED(BLE, INFO)) {
+        Serial.print("Found power meter with correct service: ");
+        Serial.printBufferReverse(addr.addr, BLE_GAP_ADDR_LEN, ':');
+        Serial.println();
     }
     
-    // 检查功率和踏频的合理性组合
-    if (data.totalPower > 0 && data.cadence == 0) {
-        Serial.println("Warning: Power > 0 but cadence = 0");
-    }
+    // 停止扫描并连接，连接建立后若仍有空闲通道再继续扫描
+    Bluefruit.Scanner.stop();
+    isScanning = false;
     
-    if (data.totalPower == 0 && data.cadence > 0) {
-        Serial.println("Warning: Cadence > 0 but power = 0");
+    PM_LOG(BLE, INFO, "Attempting to connect as %s...\n", link->pwr->getName());
+    // 连接到设备，连接事件绑定到该通道
+    link->peerAddr = addr;
+    link->connectDirect = false;
+    connectingLink = link;
+    cancelledLink = NULL;
+    setLinkState(*link, LINK_CONNECTING, now);
+    if (!Bluefruit.Central.connect(&addr)) {
+        connectingLink = NULL;
+        enterBackoff(*link, now);
     }
-    
-    // 检查极端功率值
-    if (data.totalPower > 1000) {
-        Serial.printf("Warning: Very high power detected: %dW\n", data.totalPower);
+}
+
+// 非零的规则违反计数与尖峰数，一行输出
+void PowerMeter::printValidatorCounters(const XdsValidator& validator) {
+    PM_LOG(XDS, INFO, "Validation:          %lu checked, %lu rejected, %lu spikes",
+           (unsigned long)validator.checkedCount(), (unsigned long)validator.rejectedCount(),
+           (unsigned long)validator.spikeCount());
+    for (uint8_t i = 0; i < validator.ruleCount(); i++) {
+        if (validator.ruleHits(i) == 0) continue;
+        PM_LOG(XDS, INFO, "; %s %lu", validator.rule(i).name, (unsigned long)validator.ruleHits(i));
     }
-    
-    return true;
+    PM_LOGLN(XDS, INFO, "");
 }
 
-// 打印喜德盛数据详细信息
-void PowerMeter::printXdsDataDetails(const XdsPowerMeasurementData& data, uint8_t* rawData) {
-    Serial.println("=== XDS Power Meter Data ===");
-    
-    // 打印原始数据
-    Serial.print("Raw data: ");
-    for (int i = 0; i < 11; i++) {
-        Serial.printf("%02X", rawData[i]);
-        if (i < 10) Serial.print("-");
+// 数据质量报告：读取当前窗口的直方图，并据此更新dataQualityGood
+void PowerMeter::printQualityReport(MeterLink& link) {
+    const XdsQuality& q = link.quality;
+    uint32_t frames = q.frameCount();
+    uint32_t errorPermille = frames > 0 ? (q.badCount() * 1000 + frames / 2) / frames : 0;
+    link.dataQualityGood = q.isGood();
+    if (!PM_LOG_ENABLED(XDS, INFO)) return;
+
+    PM_LOG(XDS, INFO, "=== Data Quality Report (%s) ===\n", link.pwr->getName());
+    PM_LOG(XDS, INFO, "Frames: %lu ok, %lu error code, %lu malformed, %lu rejected; dropped %lu, queue overflow %lu\n",
+           (unsigned long)q.outcomeCount(XDS_PARSE_OK), (unsigned long)q.outcomeCount(XDS_PARSE_ERROR_CODE),
+           (unsigned long)q.outcomeCount(XDS_PARSE_MALFORMED), (unsigned long)q.outcomeCount(XDS_PARSE_REJECTED),
+           (unsigned long)link.sampleDropCount,
+           (unsigned long)link.sampleQueue.GetOverflowCount());
+    PM_LOG(XDS, INFO, "Error rate: %lu.%lu%%, Data quality: %s\n",
+           (unsigned long)(errorPermille / 10), (unsigned long)(errorPermille % 10), link.dataQualityGood ? "Good" : "Poor");
+    PM_LOG(XDS, INFO, "Interval ms: p50 %lu, p99 %lu, max %lu (smoothed %lu)\n",
+           (unsigned long)q.intervals.Percentile(50), (unsigned long)q.intervals.Percentile(99),
+           (unsigned long)q.intervals.GetMax(), (unsigned long)q.smoothedInterval());
+    PM_LOG(XDS, INFO, "Jitter ms:   p50 %lu, p99 %lu, max %lu\n",
+           (unsigned long)q.jitter.Percentile(50), (unsigned long)q.jitter.Percentile(99), (unsigned long)q.jitter.GetMax());
+    PM_LOG(XDS, INFO, "Error codes:");
+    for (uint32_t b = 0; b < XdsErrorCodeHistogram::BUCKETS; b++) {
+        uint32_t count = q.errorCodes.GetBucketCount(b);
+        if (count == 0) continue;
+        uint32_t hi = XdsErrorCodeHistogram::UpperBound(b);
+        uint32_t lo = b == 0 ? 0 : XdsErrorCodeHistogram::UpperBound(b - 1) + 1;
+        if (lo == hi) PM_LOG(XDS, INFO, " %lu:%lu", (unsigned long)lo, (unsigned long)count);
+        else PM_LOG(XDS, INFO, " %lu-%lu:%lu", (unsigned long)lo, (unsigned long)hi, (unsigned long)count);
     }
-    Serial.println();
-    
-    // 打印解析结果
-    Serial.printf("Total Power:  0x%02X%02X = %dW\n", 
-                 rawData[1], rawData[0], data.totalPower);
-    Serial.printf("Left Power:   0x%02X%02X = %dW\n", 
-                 rawData[3], rawData[2], data.leftPower);
-    Serial.printf("Right Power:  0x%02X%02X = %dW\n", 
-                 rawData[5], rawData[4], data.rightPower);
-    Serial.printf("Angle:        0x%02X%02X = %d deg\n", 
-                 rawData[7], rawData[6], data.angle);
-    Serial.printf("Cadence:      0x%02X%02X = %d RPM\n", 
-                 rawData[9], rawData[8], data.cadence);
-    Serial.printf("Error Code:   0x%02X = %d\n", 
-                 rawData[10], data.errorCode);
-    Serial.printf("Data Valid:   %s\n", data.isValid ? "YES" : "NO");
-    Serial.println("============================");
+    PM_LOGLN(XDS, INFO, "");
+    printValidatorCounters(link.validator);
+    PM_LOG(XDS, INFO, "Last valid data: %lu ms ago\n", (unsigned long)(link.lastValidDataTime > 0 ? millis() - link.lastValidDataTime : 0));
+    PM_LOG(XDS, INFO, "Connection status: %s\n", link.isConnected ? "Connected" : "Disconnected");
+    PM_LOGLN(XDS, INFO, "===========================");
+}
+
+// 打印喜德盛数据详细信息 (写入延迟日志环，由空闲任务格式化输出)
+void PowerMeter::printXdsDataDetails(const XdsFrameView& frame) {
+    // 原始11字节按顺序打包进3个32位参数，只输出一次
+    const uint8_t* rawData = frame.raw();
+    uint32_t raw0 = ((uint32_t)rawData[0] << 24) | ((uint32_t)rawData[1] << 16) | ((uint32_t)rawData[2] << 8) | rawData[3];
+    uint32_t raw1 = ((uint32_t)rawData[4] << 24) | ((uint32_t)rawData[5] << 16) | ((uint32_t)rawData[6] << 8) | rawData[7];
+    uint32_t raw2 = ((uint32_t)rawData[8] << 16) | ((uint32_t)rawData[9] << 8) | rawData[10];
+    PM_DLOG(XDS, DEBUG, "XDS raw: %08X %08X %06X", raw0, raw1, raw2);
+    PM_DLOG(XDS, DEBUG, "XDS Total: %uW, Left: %dW, Right: %dW",
+         frame.totalPower(), frame.leftPower(), frame.rightPower());
+    PM_DLOG(XDS, DEBUG, "XDS Cadence: %uRPM, Angle: %d deg, Error: 0x%02X",
+         frame.cadence(), frame.angle(), frame.errorCode());
 }
 
 // ==================== 串口命令处理功能 ====================
 
+// 命令表：按名称或别名查找，参数个数在分发前检查
+const PowerMeterCommand PowerMeter::commands[] = {
+    { "help",       "h",    "",         0, 0, [](PowerMeter& pm, uint8_t, char**) { pm.printHelp(); },
+      "Show this help message" },
+    { "status",     "s",    "",         0, 0, [](PowerMeter& pm, uint8_t, char**) { pm.printStatus(); },
+      "Show current status" },
+    { "enable",     "en",   "",         0, 0, [](PowerMeter& pm, uint8_t, char**) { pm.enableNotifications(); },
+      "Enable notifications (all meters)" },
+    { "disable",    "dis",  "",         0, 0, [](PowerMeter& pm, uint8_t, char**) { pm.disableNotifications(); },
+      "Disable notifications (all meters)" },
+    { "scan",       NULL,   "",         0, 0, [](PowerMeter& pm, uint8_t, char**) { pm.scanCommand(); },
+      "Start BLE scanning" },
+    { "disconnect", "disc", "",         0, 0, [](PowerMeter& pm, uint8_t, char**) { pm.disconnectAll(); },
+      "Disconnect from all devices" },
+    { "period",     NULL,   "8|4|2",    0, 1, [](PowerMeter& pm, uint8_t argc, char** argv) { pm.setPeriodMode(argc > 0 ? argv[0] : NULL); },
+      "Set ANT+ broadcast rate in Hz" },
+    { "power",      NULL,   "W",        1, 1, [](PowerMeter& pm, uint8_t, char** argv) { pm.setBaseValue(argv[0], true); },
+      "Set virtual workout reference power (when not connected)" },
+    { "cadence",    NULL,   "RPM",      1, 1, [](PowerMeter& pm, uint8_t, char** argv) { pm.setBaseValue(argv[0], false); },
+      "Set virtual workout reference cadence (when not connected)" },
+    { "workout",    NULL,   "[SEED]",   0, 1, [](PowerMeter& pm, uint8_t argc, char** argv) { pm.setWorkoutSeed(argc > 0 ? argv[0] : NULL); },
+      "Restart the virtual workout with a seed, or show its progress" },
+    { "bench",      NULL,   "",         0, 0, [](PowerMeter& pm, uint8_t, char**) { pm.runBenchmarks(); },
+      "Run codec/parser microbenchmarks (CSV)" },
+    { "perf",       NULL,   "",         0, 0, [](PowerMeter& pm, uint8_t, char**) { pm.printPerf(); },
+      "Show BLE->ANT latency per stage and reset it" },
+    { "metrics",    "m",    "[reset]",  0, 1, [](PowerMeter& pm, uint8_t argc, char** argv) { pm.printMetrics(argc > 0 && CommandLine::Matches(argv[0], "reset")); },
+      "Show rolling averages, NP, work and L/R balance" },
+    { "smooth",     NULL,   "0|3|10",   0, 1, [](PowerMeter& pm, uint8_t argc, char** argv) { pm.setPowerSmoothing(argc > 0 ? argv[0] : NULL); },
+      "Broadcast raw or N-second average power" },
+    { "conn",       NULL,   "latency|power", 0, 1, [](PowerMeter& pm, uint8_t argc, char** argv) { pm.setConnPolicy(argc > 0 ? argv[0] : NULL); },
+      "Set BLE connection parameter policy" },
+    { "rec",        NULL,   "on|off",   0, 1, [](PowerMeter& pm, uint8_t argc, char** argv) { pm.setRecording(argc > 0 ? argv[0] : NULL); },
+      "Record BLE/ANT+ frames to flash, or show status" },
+    { "replay",     NULL,   "FILE [fast]|stop", 1, 2, [](PowerMeter& pm, uint8_t argc, char** argv) { pm.replayCommand(argc, argv); },
+      "Replay recorded XDS frames through parse and ANT+" },
+};
+
+// 只取串口已缓冲的字节，行未完整时立即返回，不阻塞update()
 void PowerMeter::processSerialCommands() {
-    if (Serial.available()) {
-        String command = Serial.readStringUntil('\n');
-        command.trim(); // 移除前后空格和换行符
-        if (command.length() > 0) {
-            handleSerialCommand(command);
+    int available = Serial.available();
+    while (available-- > 0) {
+        int c = Serial.read();
+        if (c < 0) break;
+        if (console.Feed((char)c)) {
+            executeCommand(console.Line());
         }
     }
 }
 
-void PowerMeter::handleSerialCommand(String command) {
-    command.toLowerCase(); // 转换为小写以便比较
+void PowerMeter::handleSerialCommand(const char* command) {
+    CommandLine line;
+    for (const char* p = command; *p != '\0'; p++) line.Feed(*p);
+    if (line.Feed('\n')) {
+        executeCommand(line.Line());
+    }
+}
+
+void PowerMeter::executeCommand(char* line) {
+    PM_LOGLN(CMD, INFO, "============================");
+    PM_LOG(CMD, INFO, "Received command: %s\n", line);
+    PM_LOGLN(CMD, INFO, "============================");
     
-    Serial.println("============================");
-    Serial.printf("Received command: %s\n", command.c_str());
-    Serial.println("============================");
+    char* argv[CMDLINE_MAX_ARGS];
+    uint8_t argc = CommandLine::Tokenize(line, argv, CMDLINE_MAX_ARGS);
+    if (argc == 0) return;
     
-    if (command == "help" || command == "h") {
-        printHelp();
+    const PowerMeterCommand* cmd = NULL;
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (CommandLine::Matches(argv[0], commands[i].name) ||
+            (commands[i].alias != NULL && CommandLine::Matches(argv[0], commands[i].alias))) {
+            cmd = &commands[i];
+            break;
+        }
     }
-    else if (command == "status" || command == "s") {
-        printStatus();
+    
+    if (cmd == NULL) {
+        PM_LOG(CMD, INFO, "Unknown command: %s\n", argv[0]);
+        PM_LOGLN(CMD, INFO, "Type 'help' for available commands");
+    } else if (argc - 1 < cmd->minArgs || argc - 1 > cmd->maxArgs) {
+        PM_LOG(CMD, INFO, "Usage: %s %s\n", cmd->name, cmd->usage);
+    } else {
+        cmd->handler(*this, argc - 1, argv + 1);
     }
-    else if (command == "enable" || command == "en") {
-        enableNotifications();
+    PM_LOGLN(CMD, INFO, "");
+}
+
+void PowerMeter::scanCommand() {
+    if (!isScanning && findFreeLink() != NULL) {
+        PM_LOGLN(CMD, INFO, "Starting BLE scan...");
+        startScanning();
+    } else if (isScanning) {
+        PM_LOGLN(CMD, INFO, "Already scanning...");
+    } else {
+        PM_LOGLN(CMD, INFO, "No meter slot waiting for a scan");
     }
-    else if (command == "disable" || command == "dis") {
-        disableNotifications();
+}
+
+void PowerMeter::disconnectAll() {
+    if (connectedCount > 0) {
+        PM_LOGLN(CMD, INFO, "Disconnecting from device...");
+        for (uint8_t i = 0; i < meterCount; i++) {
+            if (links[i].isConnected) Bluefruit.disconnect(links[i].connectionHandle);
+        }
+    } else {
+        PM_LOGLN(CMD, INFO, "Not connected to any device");
     }
-    else if (command == "scan") {
-        if (!isScanning && !isConnected) {
-            Serial.println("Starting BLE scan...");
-            startScanning();
-        } else if (isScanning) {
-            Serial.println("Already scanning...");
+}
+
+// 修改虚拟数据的基础功率/踏频，仅在未连接功率计时生效
+void PowerMeter::setBaseValue(const char* arg, bool isPower) {
+    uint32_t value;
+    if (isPower) {
+        if (!CommandLine::ParseUInt(arg, &value) || value == 0 || value >= 1000) {
+            PM_LOGLN(CMD, INFO, "Usage: power 1..999");
+            return;
+        }
+        basePower = (uint16_t)value;
+        PM_LOG(CMD, INFO, "Base power changed to: %luW\n", (unsigned long)value);
+    } else {
+        if (!CommandLine::ParseUInt(arg, &value) || value == 0 || value >= 200) {
+            PM_LOGLN(CMD, INFO, "Usage: cadence 1..199");
+            return;
+        }
+        baseCadence = (uint8_t)value;
+        PM_LOG(CMD, INFO, "Base cadence changed to: %luRPM\n", (unsigned long)value);
+    }
+}
+
+// 对所有已连接的功率计启用通知
+void PowerMeter::enableNotifications() {
+    if (connectedCount == 0) {
+        PM_LOGLN(CMD, INFO, "Error: Not connected to any device");
+        return;
+    }
+    
+    for (uint8_t i = 0; i < meterCount; i++) {
+        MeterLink& link = links[i];
+        if (!link.isConnected) continue;
+        
+        if (link.notificationsEnabled) {
+            PM_LOG(CMD, INFO, "%s: notifications are already enabled\n", link.pwr->getName());
+            continue;
+        }
+        
+        PM_LOG(CMD, INFO, "%s: enabling notifications...\n", link.pwr->getName());
+        
+        if (link.powerMeasurementChar.enableNotify()) {
+            link.notificationsEnabled = true;
+            PM_LOGLN(CMD, INFO, "✓ Notifications enabled successfully!");
         } else {
-            Serial.println("Already connected to a device");
+            PM_LOGLN(CMD, INFO, "✗ Failed to enable notifications");
         }
     }
-    else if (command == "disconnect" || command == "disc") {
-        if (isConnected) {
-            Serial.println("Disconnecting from device...");
-            Bluefruit.disconnect(connectionHandle);
+}
+
+// 对所有已连接的功率计禁用通知
+void PowerMeter::disableNotifications() {
+    if (connectedCount == 0) {
+        PM_LOGLN(CMD, INFO, "Error: Not connected to any device");
+        return;
+    }
+    
+    for (uint8_t i = 0; i < meterCount; i++) {
+        MeterLink& link = links[i];
+        if (!link.isConnected) continue;
+        
+        if (!link.notificationsEnabled) {
+            PM_LOG(CMD, INFO, "%s: notifications are already disabled\n", link.pwr->getName());
+            continue;
+        }
+        
+        PM_LOG(CMD, INFO, "%s: disabling notifications...\n", link.pwr->getName());
+        
+        if (link.powerMeasurementChar.disableNotify()) {
+            link.notificationsEnabled = false;
+            PM_LOGLN(CMD, INFO, "✓ Notifications disabled successfully!");
         } else {
-            Serial.println("Not connected to any device");
+            PM_LOGLN(CMD, INFO, "✗ Failed to disable notifications");
         }
     }
+}
+
+void PowerMeter::setPeriodMode(const char* arg) {
+    uint32_t hz = 0;
+    if (arg != NULL) CommandLine::ParseUInt(arg, &hz);
+    pwr_period_mode_t mode;
+    if (hz == 8) mode = PWR_PERIOD_8HZ;
+    else if (hz == 4) mode = PWR_PERIOD_4HZ;
+    else if (hz == 2) mode = PWR_PERIOD_2HZ;
     else {
-        Serial.printf("Unknown command: %s\n", command.c_str());
-        Serial.println("Type 'help' for available commands");
+        PM_LOG(CMD, INFO, "Current period: %d Hz. Usage: period 8|4|2\n", BicyclePower::RateForMode(config.periodMode));
+        return;
+    }
+    // 通道关闭后在ANT任务中切换周期并重新打开，期间会少发几帧
+    config.periodMode = mode;
+    for (uint8_t i = 0; i < meterCount; i++) {
+        uint32_t ret = links[i].pwr->SetPeriodMode(mode);
+        if (ret == NRF_SUCCESS) PM_LOG(CMD, INFO, "%s: ANT+ period set to %lu Hz\n", links[i].pwr->getName(), (unsigned long)hz);
+        else PM_LOG(CMD, ERROR, "%s: setting ANT+ period failed with code:%#x\n", links[i].pwr->getName(), (unsigned int)ret);
     }
-    Serial.println();
 }
 
-void PowerMeter::enableNotifications() {
-    if (!isConnected) {
-        Serial.println("Error: Not connected to any device");
+// ANT+瞬时功率来源：原始值或3/10 s滚动平均
+void PowerMeter::setPowerSmoothing(const char* arg) {
+    uint32_t seconds = 0;
+    if (arg == NULL || !CommandLine::ParseUInt(arg, &seconds) || (seconds != 0 && seconds != 3 && seconds != 10)) {
+        PM_LOG(CMD, INFO, "Current smoothing: %u s. Usage: smooth 0|3|10\n", config.powerSmoothing);
         return;
     }
-    
-    if (notificationsEnabled) {
-        Serial.println("Notifications are already enabled");
+    config.powerSmoothing = (uint8_t)seconds;
+    if (seconds == 0) PM_LOGLN(CMD, INFO, "Broadcasting raw instantaneous power");
+    else PM_LOG(CMD, INFO, "Broadcasting %lu s average power\n", (unsigned long)seconds);
+}
+
+// 虚拟训练：相同种子从头产生相同的样本序列，第i路使用 seed + i
+void PowerMeter::setWorkoutSeed(const char* arg) {
+    uint32_t seed = 0;
+    if (arg == NULL || !CommandLine::ParseUInt(arg, &seed)) {
+        for (uint8_t i = 0; i < meterCount; i++) {
+            const VirtualWorkout& w = links[i].workout;
+            PM_LOG(CMD, INFO, "%s workout: seed %lu, step %u at %lu s\n", links[i].pwr->getName(), (unsigned long)w.seed(),
+                         w.stepIndex(), (unsigned long)(w.stepElapsedMs() / 1000));
+        }
+        PM_LOGLN(CMD, INFO, "Usage: workout SEED");
         return;
     }
-    
-    Serial.println("Enabling notifications...");
-    
-    if (powerMeasurementChar.enableNotify()) {
-        notificationsEnabled = true;
-        Serial.println("✓ Notifications enabled successfully!");
-    } else {
-        Serial.println("✗ Failed to enable notifications");
+    config.workoutSeed = seed;
+    for (uint8_t i = 0; i < meterCount; i++) {
+        links[i].workout.Begin(config.workout, config.workoutStepCount, seed + i);
+        links[i].virtualPeriod = 0;     // 下一次生成时重新计时
     }
+    PM_LOG(CMD, INFO, "Virtual workout restarted with seed %lu\n", (unsigned long)seed);
 }
 
-void PowerMeter::disableNotifications() {
-    if (!isConnected) {
-        Serial.println("Error: Not connected to any device");
+// 骑行统计：读取前先关闭已结束的秒
+void PowerMeter::printMetrics(bool reset) {
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < meterCount; i++) {
+        RideMetrics& m = links[i].metrics;
+        m.advance(now);
+        uint32_t elapsed = m.elapsedSeconds();
+        PM_LOG(CMD, INFO, "--- %s: %lu:%02lu:%02lu ---\n", links[i].pwr->getName(), (unsigned long)(elapsed / 3600),
+                     (unsigned long)(elapsed / 60 % 60), (unsigned long)(elapsed % 60));
+        if (m.countedSeconds() != elapsed) {
+            PM_LOG(CMD, INFO, "Counted:             %lu s (gaps over %u s skipped)\n",
+                         (unsigned long)m.countedSeconds(), RIDE_WINDOW_S);
+        }
+        PM_LOG(CMD, INFO, "Average 3s/10s/30s:  %u / %u / %u W\n", m.average(3), m.average(10), m.average(30));
+        PM_LOG(CMD, INFO, "Normalized Power:    %u W\n", m.normalizedPower());
+        PM_LOG(CMD, INFO, "Work:                %lu.%lu kJ\n", (unsigned long)(m.workJoules() / 1000),
+                     (unsigned long)(m.workJoules() % 1000 / 100));
+        uint8_t left = m.leftBalancePercent();
+        if (left == 0xFF) PM_LOGLN(CMD, INFO, "L/R Balance:         n/a");
+        else PM_LOG(CMD, INFO, "L/R Balance:         %u / %u %%\n", left, 100 - left);
+        if (reset) m.Reset();
+    }
+    if (reset) PM_LOGLN(CMD, INFO, "Ride metrics reset");
+}
+
+// 会话记录开关；无参数时显示记录状态
+void PowerMeter::setRecording(const char* arg) {
+    if (CommandLine::Matches(arg, "on")) {
+        // 文件由记录任务打开，结果用 "rec" 查看
+        Recorder.Start();
+        PM_LOGLN(CMD, INFO, "Session recording requested, 'rec' shows the file");
         return;
     }
-    
-    if (!notificationsEnabled) {
-        Serial.println("Notifications are already disabled");
+    if (CommandLine::Matches(arg, "off")) {
+        Recorder.Stop();
+        PM_LOGLN(CMD, INFO, "Session recording stopped");
         return;
     }
-    
-    Serial.println("Disabling notifications...");
-    
-    if (powerMeasurementChar.disableNotify()) {
-        notificationsEnabled = false;
-        Serial.println("✓ Notifications disabled successfully!");
-    } else {
-        Serial.println("✗ Failed to disable notifications");
+    session_stats_t st;
+    Recorder.GetStats(&st);
+    PM_LOG(CMD, INFO, "Recording:           %s%s\n", Recorder.IsRecording() ? "YES " : "NO", Recorder.IsRecording() ? Recorder.GetFileName() : "");
+    PM_LOG(CMD, INFO, "Recorded:            %lu records, %lu bytes in %lu file(s)\n",
+                 (unsigned long)st.records, (unsigned long)st.bytes, (unsigned long)st.files);
+    PM_LOG(CMD, INFO, "Lost/Write Errors:   %lu/%lu (slowest write %lu us)\n",
+                 (unsigned long)st.lost, (unsigned long)st.write_errors, (unsigned long)st.max_write_us);
+    PM_LOGLN(CMD, INFO, "Usage: rec on|off");
+}
+
+// 重放记录文件：默认按原始时间注入在线通道；fast在当前任务中一次跑完并输出帧摘要和耗时
+void PowerMeter::replayCommand(uint8_t argc, char** argv) {
+    if (CommandLine::Matches(argv[0], "stop")) {
+        replay.Stop();
+        return;
+    }
+    bool fast = argc > 1 && CommandLine::Matches(argv[1], "fast");
+    if (argc > 1 && !fast) {
+        PM_LOGLN(CMD, INFO, "Usage: replay FILE [fast]|stop");
+        return;
+    }
+    replay.Start(*this, argv[0], fast ? TRACE_REPLAY_FAST : TRACE_REPLAY_REALTIME);
+}
+
+// 切换连接参数策略：新连接立即使用，已连接的功率计重新请求
+void PowerMeter::setConnPolicy(const char* arg) {
+    conn_policy_t policy;
+    if (CommandLine::Matches(arg, "latency")) policy = CONN_POLICY_LOW_LATENCY;
+    else if (CommandLine::Matches(arg, "power")) policy = CONN_POLICY_LOW_POWER;
+    else {
+        PM_LOG(CMD, INFO, "Current policy: %s. Usage: conn latency|power\n", connPolicies[config.connPolicy].name);
+        return;
+    }
+    config.connPolicy = policy;
+    const conn_policy_params_t& params = connPolicies[policy];
+    Bluefruit.Central.setConnInterval(params.interval, params.interval);
+    Bluefruit.Central.setConnSupervisionTimeout(params.supervisionTimeout);
+    PM_LOG(CMD, INFO, "Connection policy set to %s\n", params.name);
+    for (uint8_t i = 0; i < meterCount; i++) {
+        if (links[i].isConnected) {
+            links[i].connParamRetries = 0;
+            requestConnParams(links[i], millis());
+        }
     }
 }
 
 void PowerMeter::printHelp() {
-    Serial.println("Available Commands:");
-    Serial.println("==================");
-    Serial.println("help, h        - Show this help message");
-    Serial.println("status, s      - Show current status");
-    Serial.println("enable, en     - Enable notifications");
-    Serial.println("disable, dis   - Disable notifications");
-    Serial.println("scan           - Start BLE scanning");
-    Serial.println("disconnect, disc - Disconnect from device");
-    Serial.println("==================");
+    PM_LOGLN(CMD, INFO, "Available Commands:");
+    PM_LOGLN(CMD, INFO, "==================");
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        const PowerMeterCommand& cmd = commands[i];
+        char syntax[24];
+        snprintf(syntax, sizeof(syntax), "%s%s%s%s%s", cmd.name, cmd.alias ? ", " : "", cmd.alias ? cmd.alias : "",
+                 cmd.usage[0] ? " " : "", cmd.usage);
+        PM_LOG(CMD, INFO, "%-16s - %s\n", syntax, cmd.help);
+    }
+    PM_LOGLN(CMD, INFO, "==================");
 }
 
 void PowerMeter::printStatus() {
-    Serial.println("Current Status:");
-    Serial.println("===============");
-    Serial.printf("Connected:           %s\n", isConnected ? "YES" : "NO");
-    Serial.printf("Scanning:            %s\n", isScanning ? "YES" : "NO");
-    Serial.printf("Notifications:       %s\n", notificationsEnabled ? "ENABLED" : "DISABLED");
-    Serial.printf("Connection Handle:   %d\n", connectionHandle);
-    Serial.printf("Valid Data Count:    %d\n", validDataCount);
-    Serial.printf("Invalid Data Count:  %d\n", invalidDataCount);
-    Serial.printf("Data Quality:        %s\n", dataQualityGood ? "GOOD" : "POOR");
-    Serial.printf("Last Valid Data:     %lu ms ago\n", 
-                 lastValidDataTime > 0 ? (millis() - lastValidDataTime) : 0);
-    Serial.printf("Current Power:       %d W\n", instPWR);
-    Serial.printf("Current Cadence:     %d RPM\n", instCAD);
-    Serial.println("===============");
-}
\ No newline at end of file
+    PM_LOGLN(CMD, INFO, "Current Status:");
+    PM_LOGLN(CMD, INFO, "===============");
+    PM_LOG(CMD, INFO, "Connected Meters:    %d/%d\n", connectedCount, meterCount);
+    PM_LOG(CMD, INFO, "Scanning:            %s\n", isScanning ? (scanPhase == SCAN_PHASE_FAST ? "YES (fast)" : "YES (slow)") : "NO");
+    PM_LOG(CMD, INFO, "Allowlist:           %u address(es)%s\n", allowlistCount, allowlistCount ? "" : ", any XDS meter accepted");
+    static const char* const phaseNames[SCAN_PHASE_COUNT] = { "Scan Fast:", "Scan Slow:" };
+    for (uint8_t p = 0; p < SCAN_PHASE_COUNT; p++) {
+        const scan_phase_stats_t& st = scanStats[p];
+        PM_LOG(CMD, INFO, "%-21s%lu starts, %lu reports: %lu filtered, %lu miss, %lu hit\n", phaseNames[p],
+                     (unsigned long)st.starts, (unsigned long)st.reports, (unsigned long)st.filtered,
+                     (unsigned long)st.misses, (unsigned long)st.hits);
+    }
+    PM_LOG(CMD, INFO, "Rejected Filter:     %lu/%lu slots\n",
+                 (unsigned long)rejectedPeers.Size(), (unsigned long)rejectedPeers.Capacity());
+    PM_LOG(CMD, INFO, "ANT+ Period:         %d Hz\n", BicyclePower::RateForMode(config.periodMode));
+    sdant_dispatch_stats_t ant;
+    ANTplus.GetDispatchStats(&ant);
+    PM_LOG(CMD, INFO, "ANT EVENT_TX:        %lu (max %lu us)\n", (unsigned long)ant.tx_events, (unsigned long)ant.tx_max_us);
+    PM_LOG(CMD, INFO, "ANT Deferred Queue:  %lu/%lu (peak %lu), dropped %lu of %lu\n",
+                 (unsigned long)ant.queue_depth, (unsigned long)SDANT_DEFERRED_QUEUE_SIZE, (unsigned long)ant.queue_high_water,
+                 (unsigned long)ant.deferred_dropped, (unsigned long)(ant.deferred_events + ant.deferred_dropped));
+    PM_LOG(CMD, INFO, "ANT Deferred Delay:  %lu us (max %lu us)\n",
+                 (unsigned long)ant.deferred_last_latency_us, (unsigned long)ant.deferred_max_latency_us);
+    for (uint8_t i = 0; i < meterCount; i++) {
+        MeterLink& link = links[i];
+        BicyclePower* pwr = link.pwr;
+        PM_LOG(CMD, INFO, "--- %s (ANT+ device %u, channel %d) ---\n", pwr->getName(), pwr->GetDeviceNumber(), pwr->getChannelNumber());
+        PM_LOG(CMD, INFO, "Connected:           %s\n", link.isConnected ? "YES" : "NO");
+        PM_LOG(CMD, INFO, "Link State:          %s", linkStateName(link.state));
+        if (link.state == LINK_BACKOFF) PM_LOG(CMD, INFO, " (retry %u)", link.retryCount);
+        PM_LOGLN(CMD, INFO, "");
+        if (link.peerKnown && PM_LOG_ENABLED(CMD, INFO)) {
+            Serial.print("Peer Address:        ");
+            Serial.printBufferReverse(link.peerAddr.addr, BLE_GAP_ADDR_LEN, ':');
+            Serial.println();
+        }
+        PM_LOG(CMD, INFO, "Reconnects:          %u direct, %u via scan; %u timeouts, %u stall drops\n",
+                     link.directReconnects, link.scanReconnects, link.connectTimeouts, link.stallDisconnects);
+        PM_LOG(CMD, INFO, "Reconnect Gap:       p50 %lu / p99 %lu / max %lu ms (%lu)\n",
+                     (unsigned long)link.reconnectGaps.Percentile(50), (unsigned long)link.reconnectGaps.Percentile(99),
+                     (unsigned long)link.reconnectGaps.GetMax(), (unsigned long)link.reconnectGaps.GetCount());
+        PM_LOG(CMD, INFO, "Notifications:       %s\n", link.notificationsEnabled ? "ENABLED" : "DISABLED");
+        if (link.isConnected) {
+            uint32_t tenths = connIntervalTenthsMs(link.connInterval);
+            PM_LOG(CMD, INFO, "Conn Params:         %lu.%lu ms, latency %u, timeout %lu ms (%s %s)\n",
+                         (unsigned long)(tenths / 10), (unsigned long)(tenths % 10), link.connLatency,
+                         (unsigned long)link.connTimeout * 10, connPolicies[config.connPolicy].name,
+                         link.connParamRequestTime != 0 ? "pending" : (link.connParamsOk ? "granted" : "not granted"));
+        }
+        PM_LOG(CMD, INFO, "Connection Handle:   %d\n", link.isConnected ? link.connectionHandle : -1);
+        const XdsQuality& q = link.quality;
+        link.dataQualityGood = q.isGood();
+        PM_LOG(CMD, INFO, "Frames (window):     %lu ok, %lu error code, %lu malformed, %lu rejected\n",
+                     (unsigned long)q.outcomeCount(XDS_PARSE_OK), (unsigned long)q.outcomeCount(XDS_PARSE_ERROR_CODE),
+                     (unsigned long)q.outcomeCount(XDS_PARSE_MALFORMED), (unsigned long)q.outcomeCount(XDS_PARSE_REJECTED));
+        if (PM_LOG_ENABLED(CMD, INFO)) printValidatorCounters(link.validator);
+        PM_LOG(CMD, INFO, "Notify Interval:     p50 %lu / p99 %lu / max %lu ms\n",
+                     (unsigned long)q.intervals.Percentile(50), (unsigned long)q.intervals.Percentile(99),
+                     (unsigned long)q.intervals.GetMax());
+        PM_LOG(CMD, INFO, "Notify Jitter:       p50 %lu / p99 %lu / max %lu ms\n",
+                     (unsigned long)q.jitter.Percentile(50), (unsigned long)q.jitter.Percentile(99),
+                     (unsigned long)q.jitter.GetMax());
+        PM_LOG(CMD, INFO, "Sample Queue:        %lu/%lu (peak %lu)\n", 
+                     (unsigned long)link.sampleQueue.Size(), (unsigned long)link.sampleQueue.Capacity(),
+                     (unsigned long)link.sampleQueue.GetHighWater());
+        PM_LOG(CMD, INFO, "Queue Overflow/Drop: %lu/%lu\n", 
+                     (unsigned long)link.sampleQueue.GetOverflowCount(), (unsigned long)link.sampleDropCount);
+        PM_LOG(CMD, INFO, "Published Samples:   %lu\n", (unsigned long)pwr->GetPublishedSampleCount());
+        PM_LOG(CMD, INFO, "ANT+ Period:         %d Hz (%u/32768 s)%s\n", BicyclePower::RateForMode(pwr->GetPeriodMode()),
+                     pwr->GetChannelPeriod(), pwr->IsPeriodChangePending() ? " pending" : "");
+        PM_LOG(CMD, INFO, "Data Quality:        %s\n", link.dataQualityGood ? "GOOD" : "POOR");
+        PM_LOG(CMD, INFO, "Last Valid Data:     %lu ms ago\n", 
+                     (unsigned long)(link.lastValidDataTime > 0 ? millis() - link.lastValidDataTime : 0));
+        PM_LOG(CMD, INFO, "Current Power:       %d W\n", link.instPWR);
+        PM_LOG(CMD, INFO, "Current Cadence:     %d RPM\n", link.instCAD);
+    }
+    if (Crank.IsRunning()) {
+        crank_stats_t st;
+        Crank.GetStats(&st);
+        PM_LOG(CMD, INFO, "Hall Cadence:        %u RPM (pin %u)\n", crankCadence, config.hallPin);
+        PM_LOG(CMD, INFO, "Hall Edges:          %lu, %lu bounces, %lu revolutions, %lu lost\n", (unsigned long)st.edges,
+                     (unsigned long)st.bounces, (unsigned long)st.revolutions, (unsigned long)st.overflows);
+    }
+    PM_LOGLN(CMD, INFO, "===============");
+}
+
+// 打印BLE通知到ANT+发送各阶段的延迟分布 (p50/p99/max)，然后清零重新统计
+void PowerMeter::printPerf() {
+    if (!PM_LOG_ENABLED(CMD, INFO)) return;
+    PM_LOGLN(CMD, INFO, "BLE -> ANT+ latency since last 'perf':");
+    Perf.Print();
+}
+
+// 运行编解码/解析微基准测试，CSV结果直接输出到串口
+void PowerMeter::runBenchmarks() {
+    PM_LOGLN(CMD, INFO, "Running benchmarks, ANT+ output continues meanwhile...");
+    CodecBench::Run();
+}
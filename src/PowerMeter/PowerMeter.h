@@ -5,7 +5,19 @@
 
 
 #include "../sdant.h"
+#include "../SpscRing.h"
+#include "../DeferredLog.h"
+#include "../CommandLine.h"
+#include "../RecentAddrFilter.h"
+#include "../SessionRecorder.h"
+#include "../CrankCapture.h"
 #include "BicyclePower.h"
+#include "XdsFrameView.h"
+#include "XdsQuality.h"
+#include "XdsValidator.h"
+#include "RideMetrics.h"
+#include "TraceReplay.h"
+#include "VirtualWorkout.h"
 #include <bluefruit.h>
 #include "stdint-gcc.h"
 
@@ -15,30 +27,188 @@
 #define MESH_PROXY_SERVICE_UUID         0x1828
 #define CYCLING_POWER_MEASUREMENT_UUID  0x2A63
 
+// 通知回调与解析之间的样本队列
+#define XDS_SAMPLE_QUEUE_SIZE           16      // 必须为2的幂
+
+// 蓝牙回调投递给update()的连接事件
+#define PM_LINK_EVENT_QUEUE_SIZE        8       // 必须为2的幂
+
+// 网关模式：同时桥接的功率计数量上限 (BLE中心连接数 = ANT+通道数)
+#define PM_MAX_METERS                   4
+static_assert(PM_MAX_METERS <= SDANT_MAX_CHANNELS, "每路功率计需要一个ANT通道");
+
+// 重连策略：断开后先按缓存地址直连，失败按指数退避重试，多次失败后回到扫描
+#define PM_RECONNECT_MIN_MS             100     // 第一次重试前的等待
+#define PM_RECONNECT_MAX_MS             8000    // 退避上限
+#define PM_RECONNECT_DIRECT_TRIES       4       // 直连失败该次数后改为扫描
+#define PM_CONNECT_TIMEOUT_MS           3000    // 单次连接尝试超时，超时后取消
+#define PM_DATA_STALL_FACTOR            2       // 无数据超过dataTimeoutMs的该倍数时主动断开重连
+#define PM_VIRTUAL_RESYNC_MS            2000    // 虚拟样本落后超过该时间时重新计时，不再补发
+
+// 扫描：先以高占空比快速发现，PM_SCAN_FAST_MS后降为低占空比 (单位0.625 ms)
+#define PM_SCAN_FAST_INTERVAL           160     // 100 ms
+#define PM_SCAN_FAST_WINDOW             144     // 90 ms，占空比90%
+#define PM_SCAN_SLOW_INTERVAL           1600    // 1 s
+#define PM_SCAN_SLOW_WINDOW             48      // 30 ms，占空比3%
+#define PM_SCAN_FAST_MS                 30000   // 快速扫描阶段时长
+#define PM_SCAN_REJECT_SLOTS            64      // 已拒绝地址过滤表大小，必须为2的幂
+#define PM_SCAN_REJECT_TTL_MS           60000   // 过滤表定期清空，让误判的设备重新检查
+#define PM_ALLOWLIST_SIZE               8       // 已知喜德盛地址的最大数量
+
+typedef enum
+{
+    SCAN_PHASE_FAST,
+    SCAN_PHASE_SLOW,
+    SCAN_PHASE_COUNT
+} scan_phase_t;
+
+// 每个扫描阶段的广播报告统计，只在扫描回调中累加
+typedef struct
+{
+    uint32_t starts;        // 进入该阶段的次数
+    uint32_t reports;       // 收到的广播报告
+    uint32_t filtered;      // 不在白名单或已被拒绝，未解析直接丢弃
+    uint32_t misses;        // 解析后不是喜德盛功率计
+    uint32_t hits;          // 交给update()连接 (没有可用通道时恢复扫描)
+} scan_phase_stats_t;
+
+typedef enum
+{
+    LINK_EVT_FOUND,             // 扫描发现喜德盛功率计；扫描器保持暂停，由update()连接或恢复扫描
+    LINK_EVT_CONNECTED,
+    LINK_EVT_DISCONNECTED
+} link_event_type_t;
+
+// 回调只填写事件并入队，连接状态机的字段全部在update()中修改
+typedef struct
+{
+    uint8_t type;               // link_event_type_t
+    uint8_t reason;             // DISCONNECTED：断开原因
+    uint16_t connHandle;        // CONNECTED / DISCONNECTED
+    ble_gap_addr_t peerAddr;    // FOUND
+} LinkEvent;
+
+// 连接参数策略：发现服务后请求，PM_CONN_PARAM_VERIFY_MS后读回实际生效的参数核对
+#define PM_CONN_PARAM_VERIFY_MS         1000    // 请求后等待参数更新事件的时间
+#define PM_CONN_PARAM_RETRIES           2       // 未按请求生效时的重试次数
+
+typedef enum
+{
+    CONN_POLICY_LOW_LATENCY,    // 最短间隔、从机延迟0：连接间隔直接计入样本年龄
+    CONN_POLICY_LOW_POWER,      // 较长间隔并允许从机延迟，多路网关时减少射频占用
+    CONN_POLICY_COUNT
+} conn_policy_t;
+
+// 连接状态机，只在update()中推进：回调把事件入队，由processLinkEvents()切换状态
+typedef enum
+{
+    LINK_FREE,              // 空闲，等待扫描发现功率计
+    LINK_CONNECTING,        // 连接请求已发出 (直连或扫描发现后)
+    LINK_CONNECTED,         // 已连接
+    LINK_DISCONNECTING,     // 数据中断，已请求断开，等待断开事件
+    LINK_BACKOFF            // 断开或连接失败后等待下一次直连
+} link_state_t;
+
 typedef struct powermeter_config
 {
-    uint16_t profileUpdateCycle;
-    BicyclePower* p_power_profile;
+    BicyclePower* p_power_profile;      // 第0路的ANT+配置，由PowerMeter内部创建
+    pwr_period_mode_t periodMode;       // ANT+广播频率：8/4/2 Hz，ANT+默认4 Hz
+    uint8_t meterCount;                 // 同时桥接的功率计数量 1..PM_MAX_METERS，0或1为单车模式
+    uint16_t baseDeviceNumber;          // 第i路ANT+设备号 = baseDeviceNumber + i，0则使用PWR_DEVICE_NUMBER
+    const char* const* allowlist;       // 已知喜德盛地址 "AA:BB:CC:DD:EE:FF"，非空时只连接这些设备
+    uint8_t allowlistCount;             // allowlist条目数，最多PM_ALLOWLIST_SIZE，0则接受任何带服务的设备
+    conn_policy_t connPolicy;           // BLE连接参数策略，可用串口命令 "conn latency|power" 切换
+    uint8_t powerSmoothing;             // ANT+瞬时功率：0为原始值，3或10为该秒数的滚动平均 ("smooth" 命令)
+    bool recordSession;                 // 启动后即把原始BLE帧和ANT+帧记录到内部闪存 ("rec on|off" 命令)
+    const workout_step_t* workout;      // 单车模式未连接时的虚拟训练步骤表，NULL使用workoutDefaultSteps
+    uint8_t workoutStepCount;           // workout条目数
+    uint32_t workoutSeed;               // 虚拟训练随机种子，相同种子产生相同的数据 ("workout" 命令)
+    uint8_t hallPin;                    // 曲柄霍尔传感器输入引脚 (低电平有效)，踏频随第0路发送；CRANK_PIN_NONE不使用
 } powermeter_config;
 
-// 喜德盛功率计数据结构定义
-// 数据包格式：11字节
-// Byte 0-1:  总功率 (无符号16位，小端序)
-// Byte 2-3:  左腿功率 (有符号16位，小端序)
-// Byte 4-5:  右腿功率 (有符号16位，小端序)
-// Byte 6-7:  角度 (有符号16位，小端序)
-// Byte 8-9:  踏频 (无符号16位，小端序)
-// Byte 10:   错误代码 (8位)
-typedef struct XdsPowerMeasurementData
+class PowerMeter;
+
+// 串口命令表项：参数个数在分发前按minArgs/maxArgs检查，argv不含命令名
+struct PowerMeterCommand
+{
+    const char* name;
+    const char* alias;              // 无别名时为NULL
+    const char* usage;              // 参数说明，显示在help和用法提示中
+    uint8_t minArgs;
+    uint8_t maxArgs;
+    void (*handler)(PowerMeter& pm, uint8_t argc, char** argv);
+    const char* help;
+};
+
+// 通知回调入队的原始样本：XDS原始帧 + 到达时间
+typedef struct XdsSample
 {
-    uint16_t totalPower;    // 总功率 (瓦特)
-    int16_t leftPower;      // 左腿功率 (瓦特)
-    int16_t rightPower;     // 右腿功率 (瓦特)
-    int16_t angle;          // 角度 (度)
-    uint16_t cadence;       // 踏频 (RPM)
-    uint8_t errorCode;      // 错误代码
-    bool isValid;           // 数据有效性标志
-} XdsPowerMeasurementData;
+    uint32_t arrivalTick;           // 到达时间 (millis)
+    uint32_t arrivalCycles;         // 通知回调入口的PerfTrace时间戳
+    uint8_t len;                    // 有效字节数
+    uint8_t data[XDS_FRAME_SIZE];   // 原始XDS帧
+} XdsSample;
+
+// 一路功率计：一个BLE连接 -> 一个ANT+功率通道，状态互相独立
+struct MeterLink
+{
+    MeterLink();
+
+    uint8_t index;                  // 通道序号，也决定ANT+设备号
+    BicyclePower* pwr;
+    bool replay;                    // 快速重放的私有链路：不记入Perf，平滑固定为TRACE_REPLAY_SMOOTHING
+    BLEClientService meshProxyService;
+    BLEClientCharacteristic powerMeasurementChar;
+    bool isConnected;
+    uint16_t connectionHandle;
+    bool notificationsEnabled;      // 通知启用状态
+
+    // 连接状态机与重连
+    link_state_t state;
+    uint32_t stateSince;            // 进入当前状态的时间 (millis)
+    uint32_t retryAt;               // BACKOFF结束时间 (millis)
+    uint8_t retryCount;             // 连续失败次数，决定退避时长
+    bool connectDirect;             // 当前连接请求是否为按缓存地址直连
+    bool peerKnown;                 // peerAddr是否来自一次成功的连接
+    ble_gap_addr_t peerAddr;        // 本通道功率计的地址，重连时直连
+    uint32_t disconnectTime;        // 本次中断开始时间，收到首个有效数据后清零
+    bool dataTimeoutWarned;         // 本次数据超时已告警
+
+    // 重连统计 (启动以来累计)
+    uint16_t directReconnects;      // 直连成功次数
+    uint16_t scanReconnects;        // 扫描后重连成功次数
+    uint16_t connectTimeouts;       // 连接尝试超时次数
+    uint16_t stallDisconnects;      // 因数据中断主动断开次数
+    XdsIntervalHistogram reconnectGaps; // 断开到首个有效数据的时间 (ms)
+
+    // 连接参数 (间隔单位1.25 ms，超时单位10 ms)
+    uint32_t connParamRequestTime;  // 最近一次请求时间，0表示没有待核对的请求
+    uint8_t connParamRetries;
+    bool connParamsOk;              // 实际参数与策略一致
+    uint16_t connInterval;          // 核对时读到的实际参数
+    uint16_t connLatency;
+    uint16_t connTimeout;
+
+    uint16_t accPWR, instPWR;
+    uint8_t instCAD, PWREventCount;
+    RideMetrics metrics;            // 滚动平均/NP/做功/左右平衡，启动或 "metrics reset" 以来
+
+    // 虚拟训练：每个ANT+周期一个样本，样本时刻由virtualStart和样本序号推算，不随update()抖动
+    VirtualWorkout workout;
+    uint32_t virtualStart;          // 当前虚拟样本序列的起点 (millis)，0表示需要重新同步
+    uint32_t virtualSamples;        // 自virtualStart以来产生的样本数
+    uint16_t virtualPeriod;         // 产生样本时的ANT+周期 (1/32768 s)
+
+    // 错误处理和数据质量监控
+    XdsQuality quality;             // 通知间隔/抖动/解析结果/错误码分布，每次质量报告后清零
+    XdsValidator validator;         // 规则校验与尖峰滤波，计数启动以来累计
+    uint32_t lastValidDataTime;     // 最后一次有效数据时间
+    bool dataQualityGood;           // 数据质量状态，由质量报告和status命令按quality更新
+
+    // 样本队列：通知回调(生产者) -> update()(消费者)
+    SpscRing<XdsSample, XDS_SAMPLE_QUEUE_SIZE> sampleQueue;
+    uint32_t sampleDropCount;       // 长度异常被丢弃的帧数
+};
 
 class PowerMeter
 {
@@ -49,79 +219,119 @@ public:
     PowerMeter(powermeter_config*);
     void begin();
     void update();
-    void generateVirtualData();
-    void simulateHallInterrupt();
+    void generateVirtualData(MeterLink& link);
+    void processCrankEvents(uint32_t now);
     
     // 蓝牙客户端相关方法
     void initBLEClient();
     void startScanning();
     void connectToPowerMeter();
+    // 连接事件的处理，在update()中由processLinkEvents()调用
     void onConnect(uint16_t conn_handle);
     void onDisconnect(uint16_t conn_handle, uint8_t reason);
-    void onPowerMeasurementNotify(BLEClientCharacteristic* chr, uint8_t* data, uint16_t len);
-    void parsePowerData(uint8_t* data, uint16_t len);
+    void onPowerMeasurementNotify(MeterLink& link, uint8_t* data, uint16_t len);
+    void processSampleQueue(MeterLink& link);
+    void publishSample(MeterLink& link, uint32_t originCycles, bool fromWorkout);
+    void parsePowerData(MeterLink& link, uint8_t* data, uint16_t len, uint32_t arrivalTick, uint32_t arrivalCycles);
     
-    // 喜德盛功率计数据解析相关函数
-    XdsPowerMeasurementData parseXdsData(uint8_t* data, uint16_t len);
-    uint16_t getUnsignedValue(uint8_t* data, uint16_t offset);
-    int16_t getSignedValue(uint8_t* data, uint16_t offset);
-    bool validateXdsData(const XdsPowerMeasurementData& data);
-    void printXdsDataDetails(const XdsPowerMeasurementData& data, uint8_t* rawData);
+    // 喜德盛功率计数据输出 (帧由XdsFrameView解码，MeterLink::validator校验)
+    void printXdsDataDetails(const XdsFrameView& frame);
+    void printValidatorCounters(const XdsValidator& validator);
+    void printQualityReport(MeterLink& link);
     
     // 串口命令处理相关函数
     void processSerialCommands();
-    void handleSerialCommand(String command);
+    void handleSerialCommand(const char* command);
     void enableNotifications();
     void disableNotifications();
+    void scanCommand();
+    void disconnectAll();
     void printHelp();
+    void setPeriodMode(const char* arg);
+    void setBaseValue(const char* arg, bool isPower);
+    void setConnPolicy(const char* arg);
+    void setPowerSmoothing(const char* arg);
+    void setWorkoutSeed(const char* arg);
+    void printMetrics(bool reset);
+    void setRecording(const char* arg);
+    void replayCommand(uint8_t argc, char** argv);
     void printStatus();
+    void printPerf();
+    void runBenchmarks();
 
-    void SetAccPWR(uint16_t val)        { accPWR = val; }
-    void SetInstPWR(uint16_t val)       { instPWR = val; }
-    void SetInstCAD(uint8_t val)        { instCAD = val; }
-    void SetPWREventCount(uint8_t val)  { PWREventCount = val; }
-    
     // 获取连接状态
-    bool getConnectionStatus() const    { return isConnected; }
+    bool getConnectionStatus() const    { return connectedCount > 0; }
     bool getScanningStatus() const      { return isScanning; }
+    uint8_t getMeterCount() const       { return meterCount; }
+    uint8_t getConnectedCount() const   { return connectedCount; }
+    MeterLink* getLink(uint8_t index)   { return index < meterCount ? &links[index] : NULL; }
+    TraceReplay& getReplay()            { return replay; }
 
 private:
-    BicyclePower* pwr;
+    powermeter_config* configSource;   // begin()时读取，setup()之前可修改
     powermeter_config config;
-    uint16_t accPWR, instPWR;
-    uint8_t instCAD, PWREventCount;
+    MeterLink links[PM_MAX_METERS];
+    TraceReplay replay;                 // 记录文件重放，实时模式期间不生成虚拟数据
+    uint8_t meterCount;
+    uint8_t connectedCount;
 
-    uint32_t nextProfileUpdate;
-    uint32_t lastVirtualDataUpdate;
-    uint32_t lastCadenceUpdate;
+    MeterLink* findFreeLink();
+    MeterLink* findLinkForPeer(const ble_gap_addr_t& addr);
+    bool isKnownPeer(const ble_gap_addr_t& addr) const;
+    void onScanReport(ble_gap_evt_adv_report_t* report);
+    void onPeerFound(const ble_gap_addr_t& addr, uint32_t now);
+    void postLinkEvent(SpscRing<LinkEvent, PM_LINK_EVENT_QUEUE_SIZE>& queue, const LinkEvent& event);
+    void processLinkEvents(uint32_t now);
+    void startScanPhase(scan_phase_t phase, uint32_t now);
+    void serviceConnections(uint32_t now);
+    void beginDirectConnect(MeterLink& link, uint32_t now);
+    void enterBackoff(MeterLink& link, uint32_t now);
+    void setLinkState(MeterLink& link, link_state_t state, uint32_t now);
+    void requestConnParams(MeterLink& link, uint32_t now);
+    void verifyConnParams(MeterLink& link, uint32_t now);
+    void bindLink(MeterLink& link, uint16_t conn_handle);
+    void unbindLink(MeterLink& link);
+    void resumeScanIfFree();
+
+    // 串口命令：逐字节组装行，静态表分发
+    CommandLine console;
+    static const PowerMeterCommand commands[];
+    void executeCommand(char* line);
+
+    // 霍尔传感器踏频，由processCrankEvents()更新
+    uint8_t crankCadence;           // rpm，停止后为0
+    uint32_t crankLastRevolution;   // 最近一圈被取出的时间 (millis)
+    uint32_t crankPeriodUs;         // 最近一圈的周期，0表示停止后的第一圈
     
     // 虚拟数据生成相关变量
-    uint16_t basePower;      // 基础功率 (约100W)
-    uint8_t baseCadence;     // 基础踏频 (约70RPM)
-    uint32_t virtualDataInterval;  // 虚拟数据更新间隔
+    uint16_t basePower;      // 参考功率，虚拟训练各步骤按其百分比 (默认100W)
+    uint8_t baseCadence;     // 参考踏频，步骤未指定踏频时使用 (默认70RPM)
     
-    // 蓝牙客户端相关变量
-    BLEClientService meshProxyService;
-    BLEClientCharacteristic powerMeasurementChar;
-    bool isConnected;
     bool isScanning;
-    uint16_t connectionHandle;
-    
-    // 错误处理和数据质量监控
-    uint16_t invalidDataCount;      // 无效数据包计数
-    uint16_t validDataCount;        // 有效数据包计数
-    uint32_t lastValidDataTime;     // 最后一次有效数据时间
+    scan_phase_t scanPhase;
+    uint32_t scanPhaseSince;        // 当前扫描阶段开始时间 (millis)
+    scan_phase_stats_t scanStats[SCAN_PHASE_COUNT];
+    uint8_t allowlist[PM_ALLOWLIST_SIZE][BLE_GAP_ADDR_LEN];  // 与peer_addr.addr同序 (低字节在前)
+    uint8_t allowlistCount;
+    // 已拒绝地址：只在扫描回调中读写，回调内按PM_SCAN_REJECT_TTL_MS清空
+    RecentAddrFilter<PM_SCAN_REJECT_SLOTS> rejectedPeers;
+    uint32_t rejectedSince;
+    MeterLink* connectingLink;      // 正在连接的通道，同一时间只有一个连接请求
+    MeterLink* cancelledLink;       // 最近一次超时取消的连接请求，取消时连接可能已经建立
+    // 扫描回调和连接/断开回调各一个队列，每个队列只有一个生产者，消费者是update()
+    SpscRing<LinkEvent, PM_LINK_EVENT_QUEUE_SIZE> scanEvents;
+    SpscRing<LinkEvent, PM_LINK_EVENT_QUEUE_SIZE> connEvents;
     uint32_t dataTimeoutMs;         // 数据超时时间 (毫秒)
-    bool dataQualityGood;           // 数据质量状态
-    bool notificationsEnabled;      // 通知启用状态
     
-    // 静态回调函数
+    // 静态回调函数：Bluefruit回调不带上下文指针
     static void staticPowerMeasurementNotify(BLEClientCharacteristic* chr, uint8_t* data, uint16_t len);
     static void staticConnectCallback(uint16_t conn_handle);
     static void staticDisconnectCallback(uint16_t conn_handle, uint8_t reason);
     static void staticScanCallback(ble_gap_evt_adv_report_t* report);
     
-    // 静态实例指针，用于在静态回调中访问实例
+    // 按conn_handle直接索引的连接表，通知/断开回调O(1)找到所属通道
+    static MeterLink* linkByConn[BLE_MAX_CONNECTION];
+    // 网关实例，仅用于尚无连接的扫描/连接回调
     static PowerMeter* instance;
 
 };
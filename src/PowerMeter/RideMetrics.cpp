@@ -0,0 +1,119 @@
+#include "RideMetrics.h"
+#include "../DspMath.h"
+
+static_assert((RIDE_WINDOW_S + 1) * ((1u << RIDE_POWER_BITS) - 1u) <= 0xFFFFu, "30 s和必须在16位以内");
+
+void RideMetrics::Reset()
+{
+    for (uint8_t i = 0; i < RIDE_WINDOW_S; i++) ring[i] = 0;
+    head = 0;
+    filled = 0;
+    sums3and10 = 0;
+    sum30 = 0;
+    started = false;
+    currentSecond = 0;
+    binSum = 0;
+    binCount = 0;
+    lastWatts = 0;
+    emptySeconds = 0;
+    np4Sum = 0;
+    npCount = 0;
+    joules = 0;
+    seconds = 0;
+    elapsed = 0;
+    leftSum = 0;
+    rightSum = 0;
+}
+
+void RideMetrics::addSample(uint32_t tick, uint16_t watts)
+{
+    advance(tick);
+    if (!started) {
+        started = true;
+        currentSecond = tick / 1000;
+    }
+    binSum += watts;
+    binCount++;
+}
+
+void RideMetrics::addBalance(int16_t leftWatts, int16_t rightWatts)
+{
+    leftSum += Dsp::SaturateUnsigned<16>(leftWatts);
+    rightSum += Dsp::SaturateUnsigned<16>(rightWatts);
+}
+
+void RideMetrics::advance(uint32_t tick)
+{
+    if (!started) return;
+    uint32_t second = tick / 1000;
+    if (second <= currentSecond) return;
+
+    // 断线等长间隔最多补一个完整窗口的空秒，之后的秒不计入统计，但计入墙钟时间
+    uint32_t closed = second - currentSecond;
+    elapsed += closed;
+    if (closed > RIDE_WINDOW_S) closed = RIDE_WINDOW_S;
+    for (uint32_t i = 0; i < closed; i++) {
+        uint16_t watts;
+        if (binCount > 0) {
+            watts = (uint16_t)(binSum / binCount);
+            emptySeconds = 0;
+        } else {
+            watts = ++emptySeconds <= RIDE_HOLD_S ? lastWatts : 0;
+        }
+        closeSecond(watts);
+        binSum = 0;
+        binCount = 0;
+    }
+    currentSecond = second;
+}
+
+void RideMetrics::closeSecond(uint16_t watts)
+{
+    lastWatts = watts;
+    uint32_t w = Dsp::SaturateUnsigned<RIDE_POWER_BITS>(watts);
+
+    // 先取出离开各窗口的值，再覆盖最旧的一格
+    uint16_t leave3 = filled >= 3 ? ring[(head + RIDE_WINDOW_S - 3) % RIDE_WINDOW_S] : 0;
+    uint16_t leave10 = filled >= 10 ? ring[(head + RIDE_WINDOW_S - 10) % RIDE_WINDOW_S] : 0;
+    uint16_t leave30 = filled >= RIDE_WINDOW_S ? ring[head] : 0;
+    sums3and10 = Dsp::SubPacked16(Dsp::AddPacked16(sums3and10, Dsp::Pack16(w, w)), Dsp::Pack16(leave10, leave3));
+    sum30 += w - leave30;
+    ring[head] = (uint16_t)w;
+    head = (uint8_t)((head + 1) % RIDE_WINDOW_S);
+    if (filled < RIDE_WINDOW_S) filled++;
+
+    joules += w;
+    seconds++;
+
+    // NP：30 s窗口填满后每秒累加一次平均功率的四次方
+    if (filled == RIDE_WINDOW_S) {
+        uint32_t avg30 = sum30 / RIDE_WINDOW_S;
+        uint32_t square = avg30 * avg30;
+        np4Sum += (uint64_t)square * square;
+        npCount++;
+    }
+}
+
+uint16_t RideMetrics::average(uint8_t seconds) const
+{
+    uint8_t count = seconds < filled ? seconds : filled;
+    if (count == 0) return 0;
+    uint32_t sum;
+    if (seconds <= 3) sum = sums3and10 & 0xFFFFu;
+    else if (seconds <= 10) sum = sums3and10 >> 16;
+    else sum = sum30;
+    return (uint16_t)((sum + count / 2) / count);
+}
+
+uint16_t RideMetrics::normalizedPower() const
+{
+    if (npCount == 0) return 0;
+    return (uint16_t)Dsp::Isqrt64(Dsp::Isqrt64(np4Sum / npCount));
+}
+
+uint8_t RideMetrics::leftBalancePercent() const
+{
+    uint32_t total = leftSum + rightSum;
+    if (total == 0) return 0xFF;
+    return (uint8_t)(((uint64_t)leftSum * 100 + total / 2) / total);
+}
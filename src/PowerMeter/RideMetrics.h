@@ -0,0 +1,65 @@
+#ifndef RideMetrics_h
+#define RideMetrics_h
+
+#include <stdint.h>
+
+#define RIDE_WINDOW_S           30      // 最长滚动窗口 (秒)，也是NP的平滑窗口
+#define RIDE_HOLD_S             2       // 没有样本的秒沿用上一秒功率的最长秒数，之后按0 W计
+#define RIDE_POWER_BITS         11      // 每秒功率饱和到2047 W，30 s和仍在16位以内
+
+// 一路功率计的骑行统计：固定内存，每个样本O(1)更新。
+// 样本先按millis()归入整秒，每秒结束时更新3/10/30 s滚动和 (3 s与10 s和打包在
+// 一个32位字中，用DSP的16位SIMD加减同时更新)、NP的四次方和与做功。
+// 只在update()所在任务中使用，无需加锁。
+class RideMetrics
+{
+public:
+    RideMetrics() { Reset(); }
+
+    void Reset();
+
+    // 每个有效样本调用一次，tick为样本到达时间 (millis)
+    void addSample(uint32_t tick, uint16_t watts);
+    // 左右腿功率，只用于平衡统计，负值按0计
+    void addBalance(int16_t leftWatts, int16_t rightWatts);
+    // 关闭tick之前已经结束的秒；读取前调用，使停止踩踏后平均值也能回落
+    void advance(uint32_t tick);
+
+    // 最近seconds秒 (3、10或30) 的平均功率；不足时按已有秒数平均
+    uint16_t average(uint8_t seconds) const;
+    // 骑行以来的标准化功率 (30 s滚动平均的四次方均值再开四次方)，不足30 s时为0
+    uint16_t normalizedPower() const;
+    uint32_t workJoules() const         { return joules; }
+    // 第一个样本以来的墙钟秒数，断线间隔也计入
+    uint32_t elapsedSeconds() const     { return elapsed; }
+    // 计入滚动平均、NP和做功的秒数；长间隔只补RIDE_WINDOW_S秒，可能少于elapsedSeconds()
+    uint32_t countedSeconds() const     { return seconds; }
+    // 左腿占比 (%)，没有左右数据时为0xFF
+    uint8_t leftBalancePercent() const;
+
+private:
+    void closeSecond(uint16_t watts);
+
+    uint16_t ring[RIDE_WINDOW_S];       // 每秒平均功率
+    uint8_t head;                       // 下一次写入位置
+    uint8_t filled;                     // 有效秒数，最多RIDE_WINDOW_S
+    uint32_t sums3and10;                // 低16位：3 s和，高16位：10 s和
+    uint32_t sum30;
+
+    bool started;
+    uint32_t currentSecond;             // 正在累计的秒 (tick / 1000)
+    uint32_t binSum;                    // 本秒样本功率和
+    uint16_t binCount;                  // 本秒样本数
+    uint16_t lastWatts;                 // 上一秒功率，空秒时沿用
+    uint8_t emptySeconds;               // 连续空秒数
+
+    uint64_t np4Sum;                    // 30 s平均功率四次方之和
+    uint32_t npCount;
+    uint32_t joules;
+    uint32_t seconds;                   // 已关闭的统计秒
+    uint32_t elapsed;                   // 已关闭的墙钟秒，不受RIDE_WINDOW_S限制
+    uint32_t leftSum;
+    uint32_t rightSum;
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include "TraceReplay.h"
+#include "PowerMeter.h"
+#include "../CycleCounter.h"
+#include "../Log.h"
+
+using namespace Adafruit_LittleFS_Namespace;
+
+static_assert(TRACE_REPLAY_MAX_STREAMS == PM_MAX_METERS, "每路功率计对应一路轨迹");
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+TraceReplay::TraceReplay() :
+    file(InternalFS),
+    reader(file),
+    haveNext(false),
+    firstTick(0),
+    lastTick(0),
+    active(false),
+    mode(TRACE_REPLAY_REALTIME),
+    startTime(0),
+    frameSink(NULL),
+    records(0),
+    skipped(0),
+    frames(0),
+    digest(FNV_OFFSET_BASIS),
+    pipelineCycles(0)
+{
+    memset(results, 0, sizeof(results));
+}
+
+bool TraceReplay::Start(PowerMeter& pm, const char* fileName, trace_replay_mode_t replayMode)
+{
+    Stop();
+    // 实时重放与通知回调写同一个样本队列，SpscRing只允许一个生产者
+    if (replayMode == TRACE_REPLAY_REALTIME) {
+        for (uint8_t i = 0; i < pm.getMeterCount(); i++) {
+            if (pm.getLink(i)->isConnected) {
+                PM_LOG(CMD, WARN, "Meter %u is connected; real-time replay needs every meter disconnected\n", i);
+                return false;
+            }
+        }
+    }
+    if (!file.open(fileName, FILE_O_READ)) {
+        PM_LOG(CMD, ERROR, "Cannot open trace %s\n", fileName);
+        return false;
+    }
+    if (!reader.Restart()) {
+        PM_LOG(CMD, ERROR, "%s is not a session recording\n", fileName);
+        file.close();
+        return false;
+    }
+
+    records = 0;
+    skipped = 0;
+    frames = 0;
+    digest = FNV_OFFSET_BASIS;
+    pipelineCycles = 0;
+    parseCycles.Reset();
+    encodeCycles.Reset();
+    lateMs.Reset();
+    memset(results, 0, sizeof(results));
+    lastTick = 0;
+
+    haveNext = readNextBle();
+    if (!haveNext) {
+        PM_LOG(CMD, WARN, "%s holds no BLE frames\n", fileName);
+        file.close();
+        return false;
+    }
+    firstTick = next.tick;
+    mode = replayMode;
+    active = true;
+    PM_LOG(CMD, INFO, "Replaying %s (%s)\n", fileName, mode == TRACE_REPLAY_FAST ? "as fast as possible" : "real time");
+
+    if (mode == TRACE_REPLAY_FAST) {
+        runFast(pm);
+        finish();
+    } else {
+        startTime = millis();
+    }
+    return true;
+}
+
+void TraceReplay::Stop()
+{
+    if (!active) return;
+    PM_LOGLN(CMD, INFO, "Replay stopped");
+    finish();
+}
+
+void TraceReplay::finish()
+{
+    file.close();
+    active = false;
+    haveNext = false;
+    printStats();
+}
+
+// 跳过ANT和GAP记录，只返回XDS通知
+bool TraceReplay::readNextBle()
+{
+    while (reader.Next(next)) {
+        if (next.type == SESSION_REC_BLE) return true;
+    }
+    return false;
+}
+
+void TraceReplay::Service(PowerMeter& pm, uint32_t now)
+{
+    if (!active || mode != TRACE_REPLAY_REALTIME) return;
+    uint32_t elapsed = now - startTime;
+    while (haveNext && next.tick - firstTick <= elapsed) {
+        lastTick = next.tick - firstTick;
+        MeterLink* link = pm.getLink(next.stream);
+        // isConnected在启用通知之前置位，此时回调还不会入队
+        if (link != NULL && link->isConnected) {
+            PM_LOG(CMD, WARN, "Meter %u connected during replay\n", next.stream);
+            Stop();
+            return;
+        }
+        if (link != NULL) {
+            // 与蓝牙通知回调相同的入口：入队后由update()解析并发布
+            pm.onPowerMeasurementNotify(*link, next.data, next.len);
+            lateMs.Record(elapsed - lastTick);
+            records++;
+        } else {
+            skipped++;
+        }
+        haveNext = readNextBle();
+    }
+    if (!haveNext) finish();
+}
+
+void TraceReplay::runFast(PowerMeter& pm)
+{
+    // 每路独立的链路和ANT+配置，页面轮换从头开始，结果只取决于轨迹和周期
+    MeterLink* links[TRACE_REPLAY_MAX_STREAMS] = { NULL };
+    pwr_period_mode_t periodMode = pm.getLink(0)->pwr->GetPeriodMode();
+    uint64_t period = BicyclePower::PeriodForMode(periodMode);
+    uint32_t frameIndex = 1;
+    uint32_t frameTick = (uint32_t)(period * 1000 / 32768);
+
+    while (haveNext) {
+        uint32_t tick = next.tick - firstTick;
+        while (frameTick <= tick) {
+            emitFrames(links, frameTick);
+            frameIndex++;
+            frameTick = (uint32_t)(frameIndex * period * 1000 / 32768);
+        }
+
+        if (next.stream < TRACE_REPLAY_MAX_STREAMS) {
+            MeterLink*& link = links[next.stream];
+            if (link == NULL) {
+                link = new MeterLink();
+                link->index = next.stream;
+                link->replay = true;
+                link->pwr = new BicyclePower(TX);
+                link->pwr->SetPeriodMode(periodMode);
+            }
+            uint32_t start = CycleCounter::Now();
+            pm.parsePowerData(*link, next.data, next.len, next.tick, PerfTrace::Now());
+            uint32_t cycles = CycleCounter::Now() - start;
+            parseCycles.Record(cycles);
+            pipelineCycles += cycles;
+            records++;
+            results[next.stream].records++;
+        } else {
+            skipped++;
+        }
+        lastTick = tick;
+        haveNext = readNextBle();
+    }
+    // 再推进一个周期，让最后一个样本也发出去
+    emitFrames(links, frameTick);
+
+    for (uint8_t i = 0; i < TRACE_REPLAY_MAX_STREAMS; i++) {
+        if (links[i] == NULL) continue;
+        RideMetrics& m = links[i]->metrics;
+        m.advance(firstTick + lastTick + 1000);     // 关闭最后一秒
+        results[i].rejected = links[i]->validator.rejectedCount() + links[i]->quality.outcomeCount(XDS_PARSE_MALFORMED);
+        results[i].normalizedPower = m.normalizedPower();
+        results[i].workJoules = m.workJoules();
+        delete links[i]->pwr;
+        delete links[i];
+    }
+}
+
+// 一次虚拟EVENT_TX：与ANTProfile::ProcessTimeCritical相同的编码顺序，不经过无线电
+void TraceReplay::emitFrames(MeterLink** links, uint32_t tick)
+{
+    for (uint8_t i = 0; i < TRACE_REPLAY_MAX_STREAMS; i++) {
+        if (links[i] == NULL) continue;
+        BicyclePower* pwr = links[i]->pwr;
+        trace_frame_t frame;
+        uint32_t start = CycleCounter::Now();
+        memcpy(frame.payload, pwr->FinalizeTxFrame(), ANT_STANDARD_DATA_PAYLOAD_SIZE);
+        pwr->PrepareNextMessage();
+        uint32_t cycles = CycleCounter::Now() - start;
+        encodeCycles.Record(cycles);
+        pipelineCycles += cycles;
+
+        frame.tick = tick;
+        frame.stream = i;
+        digest = (digest ^ i) * FNV_PRIME;
+        for (uint8_t b = 0; b < ANT_STANDARD_DATA_PAYLOAD_SIZE; b++) {
+            digest = (digest ^ frame.payload[b]) * FNV_PRIME;
+        }
+        frames++;
+        results[i].frames++;
+        if (frameSink) frameSink(frame);
+    }
+}
+
+void TraceReplay::printStats() const
+{
+    if (!PM_LOG_ENABLED(CMD, INFO)) return;
+    PM_LOG(CMD, INFO, "Replayed:            %lu XDS frames over %lu.%03lu s, %lu skipped\n", (unsigned long)records,
+                 (unsigned long)(lastTick / 1000), (unsigned long)(lastTick % 1000), (unsigned long)skipped);
+    if (mode == TRACE_REPLAY_REALTIME) {
+        PM_LOG(CMD, INFO, "Injection Delay:     p50 %lu / p99 %lu / max %lu ms\n",
+                     (unsigned long)lateMs.Percentile(50), (unsigned long)lateMs.Percentile(99), (unsigned long)lateMs.GetMax());
+        return;
+    }
+
+    PM_LOG(CMD, INFO, "ANT+ Frames:         %lu, digest %08lX (smoothing %u s)\n", (unsigned long)frames,
+                 (unsigned long)digest, TRACE_REPLAY_SMOOTHING);
+    for (uint8_t i = 0; i < TRACE_REPLAY_MAX_STREAMS; i++) {
+        const trace_stream_result_t& r = results[i];
+        if (r.records == 0) continue;
+        PM_LOG(CMD, INFO, "  Stream %u:          %lu frames in, %lu rejected, %lu frames out, NP %u W, %lu.%lu kJ\n", i,
+                     (unsigned long)r.records, (unsigned long)r.rejected, (unsigned long)r.frames, r.normalizedPower,
+                     (unsigned long)(r.workJoules / 1000), (unsigned long)(r.workJoules % 1000 / 100));
+    }
+    // 主机上CycleCounter以纳秒计数，统一换算为纳秒输出
+    PM_LOG(CMD, INFO, "Parse:               p50 %lu / p99 %lu / max %lu ns\n",
+                 (unsigned long)CycleCounter::ToNanos(parseCycles.Percentile(50)),
+                 (unsigned long)CycleCounter::ToNanos(parseCycles.Percentile(99)),
+                 (unsigned long)CycleCounter::ToNanos(parseCycles.GetMax()));
+    PM_LOG(CMD, INFO, "Encode:              p50 %lu / p99 %lu / max %lu ns\n",
+                 (unsigned long)CycleCounter::ToNanos(encodeCycles.Percentile(50)),
+                 (unsigned long)CycleCounter::ToNanos(encodeCycles.Percentile(99)),
+                 (unsigned long)CycleCounter::ToNanos(encodeCycles.GetMax()));
+    uint64_t us = pipelineCycles * 1000000u / CycleCounter::GetHz();
+    uint64_t perSecond = us > 0 ? (uint64_t)(records + frames) * 1000000u / us : 0;
+    PM_LOG(CMD, INFO, "Pipeline Time:       %lu us, %lu frames in+out per second\n", (unsigned long)us, (unsigned long)perSecond);
+}
@@ -0,0 +1,101 @@
+#ifndef TraceReplay_h
+#define TraceReplay_h
+
+#include <stdint.h>
+#include "../SessionRecorder.h"
+#include "../PerfTrace.h"
+#include "BicyclePower.h"
+#include "XdsQuality.h"
+
+#define TRACE_REPLAY_MAX_STREAMS        4       // 与PM_MAX_METERS一致，轨迹中更多的路被跳过
+#define TRACE_REPLAY_SMOOTHING          0       // 快速重放的功率平滑秒数，与 "smooth" 设置无关
+
+class PowerMeter;
+struct MeterLink;
+
+typedef enum
+{
+    TRACE_REPLAY_REALTIME,      // 按原始到达间隔注入实际通道，由ANT任务照常发送
+    TRACE_REPLAY_FAST           // 在调用者上下文中尽快解析和编码，ANT+帧交给frameSink
+} trace_replay_mode_t;
+
+// 快速重放产生的一帧ANT+数据
+typedef struct
+{
+    uint32_t tick;              // 虚拟EVENT_TX时刻，相对轨迹第一条记录 (ms)
+    uint8_t stream;             // 第几路功率计
+    uint8_t payload[ANT_STANDARD_DATA_PAYLOAD_SIZE];
+} trace_frame_t;
+
+// 快速重放中每路的结果，用于与客户骑行记录的预期值比较
+typedef struct
+{
+    uint32_t records;           // 本路重放的XDS帧
+    uint32_t rejected;          // 校验未通过或格式错误的帧
+    uint32_t frames;            // 本路产生的ANT+帧
+    uint16_t normalizedPower;
+    uint32_t workJoules;
+} trace_stream_result_t;
+
+// 喜德盛通知轨迹重放：读取SessionRecorder记录的文件中的BLE帧，送入
+// PowerMeter::parsePowerData和BicyclePower的EVENT_TX编码路径。
+//   实时模式：update()中按原始间隔把到期的帧注入对应通道的样本队列，之后
+//             与真实通知走完全相同的路径；统计注入相对原定时刻的延迟。
+//             样本队列只允许一个生产者，所以只在所有功率计断开时开始，
+//             重放中有功率计连上时停止。
+//   快速模式：每路使用独立的MeterLink和BicyclePower (不影响在线通道，
+//             不记入Perf统计，平滑固定为TRACE_REPLAY_SMOOTHING)，按ANT+
+//             周期推进虚拟时钟，产生确定的帧序列；统计每帧解析和编码的
+//             耗时。相同轨迹和周期总是产生相同的帧和摘要。
+// 轨迹中的ANT记录被忽略。只在update()所在任务中使用。
+class TraceReplay
+{
+public:
+    TraceReplay();
+
+    // 打开轨迹文件开始重放；快速模式在返回前完成
+    bool Start(PowerMeter& pm, const char* fileName, trace_replay_mode_t mode);
+    void Stop();
+    // 实时模式：注入所有已到期的帧，轨迹结束时打印统计
+    void Service(PowerMeter& pm, uint32_t now);
+    bool IsActive() const               { return active; }
+
+    // 快速模式的帧输出，为NULL时只计数和计算摘要
+    void setFrameSink(void (*fp)(const trace_frame_t& frame)) { frameSink = fp; }
+
+    void printStats() const;
+    uint32_t frameDigest() const        { return digest; }
+    uint32_t frameCount() const         { return frames; }
+    const trace_stream_result_t& streamResult(uint8_t stream) const { return results[stream]; }
+
+private:
+    bool readNextBle();
+    void runFast(PowerMeter& pm);
+    void emitFrames(MeterLink** links, uint32_t tick);
+    void finish();
+
+    Adafruit_LittleFS_Namespace::File file;
+    SessionReader reader;
+    session_record_t next;
+    bool haveNext;
+    uint32_t firstTick;             // 轨迹第一条BLE记录的时间
+    uint32_t lastTick;              // 已重放的最后一条记录，相对firstTick
+
+    bool active;
+    trace_replay_mode_t mode;
+    uint32_t startTime;             // 实时模式开始时的millis()
+    void (*frameSink)(const trace_frame_t& frame);
+
+    // 统计，每次Start()清零
+    uint32_t records;
+    uint32_t skipped;               // 路数超出的记录
+    uint32_t frames;
+    uint32_t digest;                // 所有ANT+帧的FNV-1a摘要
+    uint64_t pipelineCycles;        // 快速模式：解析和编码的总耗时 (CycleCounter)
+    PerfHistogram parseCycles;      // 每帧parsePowerData耗时
+    PerfHistogram encodeCycles;     // 每帧FinalizeTxFrame + PrepareNextMessage耗时
+    XdsIntervalHistogram lateMs;    // 实时模式：注入比原定时刻晚的毫秒数
+    trace_stream_result_t results[TRACE_REPLAY_MAX_STREAMS];
+};
+
+#endif
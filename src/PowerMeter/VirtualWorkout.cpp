@@ -0,0 +1,137 @@
+#include "VirtualWorkout.h"
+
+const workout_step_t workoutDefaultSteps[] = {
+    { WORKOUT_RAMP,    0,   300, 50,  90 },     // 5 min热身
+    { WORKOUT_STEADY,  95,  180, 110, 110 },    // 3 min阈值以上
+    { WORKOUT_STEADY,  0,   120, 60,  60 },     // 2 min恢复
+    { WORKOUT_REPEAT,  2,   3,   0,   0 },      // 共4组
+    { WORKOUT_SPRINT,  115, 12,  250, 250 },    // 冲刺
+    { WORKOUT_COAST,   0,   20,  0,   0 },      // 滑行
+    { WORKOUT_STEADY,  0,   90,  70,  70 },
+    { WORKOUT_REPEAT,  3,   2,   0,   0 },      // 共3次冲刺
+    { WORKOUT_RAMP,    0,   240, 80,  40 },     // 放松
+};
+const uint8_t workoutDefaultStepCount = sizeof(workoutDefaultSteps) / sizeof(workoutDefaultSteps[0]);
+
+VirtualWorkout::VirtualWorkout()
+{
+    Begin(NULL, 0, 1);
+}
+
+void VirtualWorkout::Begin(const workout_step_t* table, uint8_t stepCount, uint32_t seed)
+{
+    if (table == NULL || stepCount == 0) {
+        table = workoutDefaultSteps;
+        stepCount = workoutDefaultStepCount;
+    }
+    steps = table;
+    count = stepCount;
+    seedValue = seed != 0 ? seed : 1;
+    state = seedValue;
+    repeatsDone = 0;
+    powerQ8 = 0;
+    noiseQ8 = 0;
+    cadenceQ8 = 0;
+    enterStep(0);
+}
+
+// xorshift32 (Marsaglia)，周期2^32-1
+uint32_t VirtualWorkout::nextRandom()
+{
+    uint32_t x = state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state = x;
+    return x;
+}
+
+// [-amplitude, amplitude]内的均匀分布，用乘法代替取模
+int32_t VirtualWorkout::uniform(int32_t amplitude)
+{
+    if (amplitude <= 0) return 0;
+    uint32_t range = (uint32_t)amplitude * 2 + 1;
+    return (int32_t)(((uint64_t)nextRandom() * range) >> 32) - amplitude;
+}
+
+// 进入第next步；REPEAT在这里展开为跳转，表中全是REPEAT时停在第0步
+void VirtualWorkout::enterStep(uint8_t next)
+{
+    stepTicks = 0;
+    for (uint8_t guard = 0; guard <= count; guard++) {
+        if (next >= count) next = 0;
+        const workout_step_t& step = steps[next];
+        if (step.kind != WORKOUT_REPEAT) {
+            index = next;
+            return;
+        }
+        if (repeatsDone < step.seconds && step.cadence > 0 && step.cadence <= next) {
+            repeatsDone++;
+            next = (uint8_t)(next - step.cadence);
+        } else {
+            repeatsDone = 0;
+            next++;
+        }
+    }
+    index = 0;
+}
+
+void VirtualWorkout::nextStep()
+{
+    enterStep((uint8_t)(index + 1));
+}
+
+workout_sample_t VirtualWorkout::Next(uint16_t period, uint16_t refWatts, uint8_t refCadence)
+{
+    stepTicks += period;
+    while (stepTicks >= (uint32_t)steps[index].seconds * WORKOUT_TICK_HZ) {
+        uint32_t overrun = stepTicks - (uint32_t)steps[index].seconds * WORKOUT_TICK_HZ;
+        uint8_t before = index;
+        nextStep();
+        stepTicks = overrun;
+        if (index == before && steps[index].seconds == 0) break;    // 表中只有零时长的步骤
+    }
+    const workout_step_t& step = steps[index];
+
+    // 目标功率：按步骤内已过时间在startPct与endPct之间线性插值
+    int32_t targetQ8 = 0;
+    int32_t targetCadence = step.cadence != 0 ? step.cadence : refCadence;
+    uint32_t tauMs = WORKOUT_POWER_TAU_MS;
+    if (step.kind == WORKOUT_COAST) {
+        targetCadence = 0;
+    } else {
+        uint32_t duration = (uint32_t)step.seconds * WORKOUT_TICK_HZ;
+        int32_t pct = step.startPct;
+        if (step.kind != WORKOUT_STEADY && duration > 0) {
+            pct += (int32_t)(((int64_t)((int32_t)step.endPct - (int32_t)step.startPct) * stepTicks) / duration);
+        }
+        targetQ8 = (int32_t)(((uint32_t)refWatts * (uint32_t)pct << 8) / 100);
+        if (step.kind == WORKOUT_SPRINT) tauMs = WORKOUT_SPRINT_TAU_MS;
+    }
+
+    // 一阶惯性：x += (target - x) * dt / (tau + dt)，系数为Q16
+    uint32_t tauTicks = tauMs * WORKOUT_TICK_HZ / 1000;
+    int32_t alpha = (int32_t)(((uint32_t)period << 16) / (tauTicks + period));
+    powerQ8 += (int32_t)(((int64_t)(targetQ8 - powerQ8) * alpha) >> 16);
+
+    // 低通噪声：每周期衰减1/8，加入目标功率百分之几的均匀噪声
+    noiseQ8 -= noiseQ8 / 8;
+    noiseQ8 += uniform(targetQ8 * WORKOUT_NOISE_PERCENT / 100);
+    int32_t wattsQ8 = powerQ8 + noiseQ8;
+    if (wattsQ8 < 0) wattsQ8 = 0;
+
+    // 踏频随功率高出目标的部分上升，滑行时随功率一起回落
+    if (targetCadence > 0) targetCadence += (wattsQ8 - targetQ8) / (WORKOUT_CADENCE_COUPLING << 8);
+    if (targetCadence < 0) targetCadence = 0;
+    uint32_t cadTauTicks = (uint32_t)WORKOUT_CADENCE_TAU_MS * WORKOUT_TICK_HZ / 1000;
+    int32_t cadAlpha = (int32_t)(((uint32_t)period << 16) / (cadTauTicks + period));
+    cadenceQ8 += (int32_t)(((int64_t)((targetCadence << 8) - cadenceQ8) * cadAlpha) >> 16);
+    int32_t cadence = (cadenceQ8 + (targetCadence > 0 ? uniform(256) : 0)) >> 8;
+    if (cadence < 0) cadence = 0;
+    if (cadence > 254) cadence = 254;       // 0xFF表示无踏频
+
+    workout_sample_t sample;
+    sample.watts = (uint16_t)((wattsQ8 >> 8) > 4000 ? 4000 : (wattsQ8 >> 8));
+    sample.cadence = (uint8_t)cadence;
+    return sample;
+}
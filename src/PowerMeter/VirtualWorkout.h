@@ -0,0 +1,81 @@
+#ifndef VirtualWorkout_h
+#define VirtualWorkout_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WORKOUT_TICK_HZ             32768   // 时间单位与ANT+信道周期相同 (1/32768 s)
+#define WORKOUT_POWER_TAU_MS        2000    // 功率跟随目标的时间常数
+#define WORKOUT_SPRINT_TAU_MS       300     // 冲刺步的功率时间常数
+#define WORKOUT_CADENCE_TAU_MS      1500    // 踏频跟随目标的时间常数
+#define WORKOUT_NOISE_PERCENT       3       // 功率噪声幅度 (目标功率的百分比)
+#define WORKOUT_CADENCE_COUPLING    16      // 功率每高出目标该瓦数，踏频目标加1 rpm
+
+typedef enum
+{
+    WORKOUT_STEADY,             // 恒定功率 (startPct)
+    WORKOUT_RAMP,               // 功率在时长内从startPct线性变到endPct
+    WORKOUT_SPRINT,             // 同RAMP，但功率快速响应
+    WORKOUT_COAST,              // 停止踩踏：功率和踏频趋于0
+    WORKOUT_REPEAT              // 把前cadence步再执行seconds次 (不支持嵌套)
+} workout_kind_t;
+
+// 训练步骤表的一项 (8字节)。功率为参考功率 ("power" 命令) 的百分比，
+// 踏频为0时使用参考踏频 ("cadence" 命令)
+typedef struct
+{
+    uint8_t kind;               // workout_kind_t
+    uint8_t cadence;            // 目标踏频 rpm；REPEAT：向前重复的步数
+    uint16_t seconds;           // 时长；REPEAT：重复次数
+    uint16_t startPct;
+    uint16_t endPct;
+} workout_step_t;
+
+// 默认训练：热身、4组间歇、冲刺、放松，结束后从头循环
+extern const workout_step_t workoutDefaultSteps[];
+extern const uint8_t workoutDefaultStepCount;
+
+typedef struct
+{
+    uint16_t watts;
+    uint8_t cadence;
+} workout_sample_t;
+
+// 确定性的虚拟骑行：步骤表给出目标功率，实际功率和踏频以一阶惯性跟随
+// 目标，叠加xorshift32驱动的低通噪声；踏频随功率高出目标的部分上升。
+// 全部为整数运算 (功率和踏频为Q8定点)，每个样本只有几次乘除，状态约
+// 30字节，可以同时运行几十路。相同的步骤表、种子和周期序列产生相同的样本。
+class VirtualWorkout
+{
+public:
+    VirtualWorkout();
+
+    // steps须在使用期间有效；为NULL时使用默认训练。seed为0时按1处理
+    void Begin(const workout_step_t* steps, uint8_t count, uint32_t seed);
+
+    // 前进period (1/32768 s，即ANT+信道周期)，返回该时刻的功率和踏频
+    workout_sample_t Next(uint16_t period, uint16_t refWatts, uint8_t refCadence);
+
+    uint8_t stepIndex() const           { return index; }
+    uint32_t stepElapsedMs() const      { return (uint32_t)((uint64_t)stepTicks * 1000 / WORKOUT_TICK_HZ); }
+    uint32_t seed() const               { return seedValue; }
+
+private:
+    uint32_t nextRandom();
+    int32_t uniform(int32_t amplitude);
+    void enterStep(uint8_t next);
+    void nextStep();
+
+    const workout_step_t* steps;
+    uint8_t count;
+    uint8_t index;                      // 当前步骤
+    uint8_t repeatsDone;                // 当前REPEAT已执行的次数
+    uint32_t stepTicks;                 // 当前步骤已经过的时间 (1/32768 s)
+    uint32_t state;                     // xorshift32状态，不为0
+    uint32_t seedValue;
+    int32_t powerQ8;                    // 惯性滤波后的功率 (W * 256)
+    int32_t noiseQ8;                    // 低通噪声 (W * 256)
+    int32_t cadenceQ8;                  // rpm * 256
+};
+
+#endif
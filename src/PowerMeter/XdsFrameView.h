@@ -0,0 +1,57 @@
+#ifndef XdsFrameView_h
+#define XdsFrameView_h
+
+#include <stdint.h>
+
+// 喜德盛功率计数据包格式：11字节
+// Byte 0-1:  总功率 (无符号16位，小端序)
+// Byte 2-3:  左腿功率 (有符号16位，小端序)
+// Byte 4-5:  右腿功率 (有符号16位，小端序)
+// Byte 6-7:  角度 (有符号16位，小端序)
+// Byte 8-9:  踏频 (无符号16位，小端序)
+// Byte 10:   错误代码 (8位)
+#define XDS_FRAME_SIZE                  11
+
+// XDS帧的非拥有视图：直接从通知缓冲区按编译期偏移解码，不复制数据。
+// 长度只在构造时检查一次；isValid()为false时不得调用字段访问函数。
+// 视图不延长缓冲区生命周期，调用方须保证缓冲区在使用期间有效。
+class XdsFrameView
+{
+public:
+    static constexpr uint8_t TOTAL_POWER_OFFSET = 0;
+    static constexpr uint8_t LEFT_POWER_OFFSET  = 2;
+    static constexpr uint8_t RIGHT_POWER_OFFSET = 4;
+    static constexpr uint8_t ANGLE_OFFSET       = 6;
+    static constexpr uint8_t CADENCE_OFFSET     = 8;
+    static constexpr uint8_t ERROR_CODE_OFFSET  = 10;
+
+    XdsFrameView(const uint8_t* data, uint16_t len)
+        : frame((data != nullptr && len >= XDS_FRAME_SIZE) ? data : nullptr) {}
+
+    bool isValid() const                { return frame != nullptr; }
+
+    uint16_t totalPower() const         { return u16<TOTAL_POWER_OFFSET>(); }   // 瓦特
+    int16_t leftPower() const           { return s16<LEFT_POWER_OFFSET>(); }    // 瓦特
+    int16_t rightPower() const          { return s16<RIGHT_POWER_OFFSET>(); }   // 瓦特
+    int16_t angle() const               { return s16<ANGLE_OFFSET>(); }         // 度
+    uint16_t cadence() const            { return u16<CADENCE_OFFSET>(); }       // RPM
+    uint8_t errorCode() const           { return frame[ERROR_CODE_OFFSET]; }
+
+    const uint8_t* raw() const          { return frame; }
+
+private:
+    // 小端序16位读取，偏移在编译期检查不越过帧尾
+    template <uint8_t OFFSET>
+    uint16_t u16() const
+    {
+        static_assert(OFFSET + 2 <= XDS_FRAME_SIZE, "XDS field beyond frame end");
+        return (uint16_t)(frame[OFFSET] | (frame[OFFSET + 1] << 8));
+    }
+
+    template <uint8_t OFFSET>
+    int16_t s16() const { return (int16_t)u16<OFFSET>(); }
+
+    const uint8_t* frame;
+};
+
+#endif
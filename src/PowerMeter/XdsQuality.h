@@ -0,0 +1,98 @@
+#ifndef XdsQuality_h
+#define XdsQuality_h
+
+#include <stdint.h>
+#include "../LogHistogram.h"
+
+// 数据质量判定阈值
+#define XDS_QUALITY_MAX_ERROR_PERCENT   10      // 无效帧比例上限 (%)
+#define XDS_QUALITY_MAX_GAP_FACTOR      3       // 通知间隔p99超过p50的该倍数即视为卡顿
+
+// 每帧的解析结果
+typedef enum
+{
+    XDS_PARSE_OK,               // 正常帧
+    XDS_PARSE_ERROR_CODE,       // 帧完整但errorCode非0
+    XDS_PARSE_MALFORMED,        // 长度不足，无法解码
+    XDS_PARSE_REJECTED,         // 违反XdsValidator的REJECT规则
+    XDS_PARSE_OUTCOME_COUNT
+} xds_parse_outcome_t;
+
+typedef LogHistogram<2, 16> XdsIntervalHistogram;   // 毫秒，每倍程4格，最长65 s
+typedef LogHistogram<3, 8>  XdsErrorCodeHistogram;  // 0..15逐个计数，之后每倍程8格
+
+// 一路功率计的数据质量统计：固定内存，每帧O(1)更新，不分配内存。
+// 只在update()所在任务中记录和读取 (到达时间由通知回调随样本入队)，
+// 因此无需加锁。Reset()开始新的统计窗口，Restart()用于新连接。
+class XdsQuality
+{
+public:
+    XdsQuality() : hasLastArrival(false), lastArrival(0), avgIntervalX8(0) { Reset(); }
+
+    // 每个出队的帧调用一次，arrivalTick为通知回调时的millis()
+    void recordArrival(uint32_t arrivalTick)
+    {
+        if (hasLastArrival) {
+            uint32_t interval = arrivalTick - lastArrival;
+            intervals.Record(interval);
+            // 抖动：本次间隔与平滑间隔 (EWMA, 权重1/8) 的偏差
+            if (avgIntervalX8 == 0) avgIntervalX8 = interval << 3;
+            int32_t deviation = (int32_t)interval - (int32_t)((avgIntervalX8 + 4) >> 3);
+            jitter.Record((uint32_t)(deviation < 0 ? -deviation : deviation));
+            avgIntervalX8 = avgIntervalX8 + interval - (avgIntervalX8 >> 3);
+        }
+        lastArrival = arrivalTick;
+        hasLastArrival = true;
+    }
+
+    void recordOutcome(xds_parse_outcome_t outcome)   { outcomes[outcome]++; }
+    void recordErrorCode(uint8_t code)                { errorCodes.Record(code); }
+
+    uint32_t outcomeCount(xds_parse_outcome_t outcome) const { return outcomes[outcome]; }
+    uint32_t frameCount() const
+    {
+        return outcomes[XDS_PARSE_OK] + badCount();
+    }
+    uint32_t badCount() const
+    {
+        return outcomes[XDS_PARSE_ERROR_CODE] + outcomes[XDS_PARSE_MALFORMED] + outcomes[XDS_PARSE_REJECTED];
+    }
+    uint32_t smoothedInterval() const { return (avgIntervalX8 + 4) >> 3; }
+
+    // 窗口内无效帧比例和间隔长尾都在阈值内时为好；O(桶数)，不要每帧调用
+    bool isGood() const
+    {
+        uint32_t frames = frameCount();
+        if (frames > 0 && badCount() * 100 > frames * XDS_QUALITY_MAX_ERROR_PERCENT) return false;
+        uint32_t p50 = intervals.Percentile(50);
+        return intervals.GetCount() == 0 || intervals.Percentile(99) <= p50 * XDS_QUALITY_MAX_GAP_FACTOR;
+    }
+
+    void Reset()
+    {
+        intervals.Reset();
+        jitter.Reset();
+        errorCodes.Reset();
+        for (uint8_t i = 0; i < XDS_PARSE_OUTCOME_COUNT; i++) outcomes[i] = 0;
+    }
+
+    // 新连接：断开期间的间隔不计入
+    void Restart()
+    {
+        Reset();
+        hasLastArrival = false;
+        avgIntervalX8 = 0;
+    }
+
+    XdsIntervalHistogram intervals;     // BLE通知间隔 (ms)
+    XdsIntervalHistogram jitter;        // 通知抖动 (ms)
+    XdsErrorCodeHistogram errorCodes;   // XDS errorCode分布
+
+private:
+    uint32_t outcomes[XDS_PARSE_OUTCOME_COUNT];
+    bool hasLastArrival;
+    uint32_t lastArrival;
+    uint32_t avgIntervalX8;             // 平滑间隔 x8 (ms)
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "XdsValidator.h"
+
+static_assert(XDS_SPIKE_WINDOW == 5, "median5()按5帧窗口展开");
+
+// 与原validateXdsData()的判定一致：errorCode大于10为严重错误，1..10只计数
+const xds_rule_t xdsDefaultRules[] = {
+    { "total power",    XDS_FIELD_TOTAL_POWER,  XDS_RULE_REJECT, 0,    2000 },
+    { "cadence",        XDS_FIELD_CADENCE,      XDS_RULE_REJECT, 0,    200 },
+    { "angle",          XDS_FIELD_ANGLE,        XDS_RULE_REJECT, -180, 180 },
+    { "left power",     XDS_FIELD_LEFT_POWER,   XDS_RULE_REJECT, -100, 1500 },
+    { "right power",    XDS_FIELD_RIGHT_POWER,  XDS_RULE_REJECT, -100, 1500 },
+    { "severe error",   XDS_FIELD_ERROR_CODE,   XDS_RULE_REJECT, 0,    10 },
+    { "minor error",    XDS_FIELD_ERROR_CODE,   XDS_RULE_WARN,   0,    0 },
+    { "L+R mismatch",   XDS_FIELD_LR_MISMATCH,  XDS_RULE_WARN,   0,    15 },
+    { "high power",     XDS_FIELD_TOTAL_POWER,  XDS_RULE_WARN,   0,    1000 },
+};
+const uint8_t xdsDefaultRuleCount = sizeof(xdsDefaultRules) / sizeof(xdsDefaultRules[0]);
+
+// 5个数的中值：固定的比较交换序列，无循环
+static inline void sort2(int32_t& a, int32_t& b)
+{
+    int32_t lo = a < b ? a : b;
+    int32_t hi = a < b ? b : a;
+    a = lo;
+    b = hi;
+}
+
+static int32_t median5(const uint16_t* v)
+{
+    int32_t a = v[0], b = v[1], c = v[2], d = v[3], e = v[4];
+    sort2(a, b);
+    sort2(d, e);
+    sort2(a, d);    // a为前四个中的最小值，不可能是中值
+    sort2(b, e);    // e为后四个中的最大值，不可能是中值
+    sort2(b, c);
+    sort2(c, d);
+    sort2(b, c);
+    return c;
+}
+
+XdsValidator::XdsValidator() :
+    rules(xdsDefaultRules),
+    count(0),
+    rejectMask(0),
+    ringHead(0),
+    ringFilled(0)
+{
+    setRules(xdsDefaultRules, xdsDefaultRuleCount);
+}
+
+bool XdsValidator::setRules(const xds_rule_t* table, uint8_t ruleCount)
+{
+    if (table == nullptr || ruleCount > XDS_MAX_RULES) return false;
+    rules = table;
+    count = ruleCount;
+    rejectMask = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (rules[i].action == XDS_RULE_REJECT) rejectMask |= 1u << i;
+    }
+    ResetCounters();
+    return true;
+}
+
+void XdsValidator::ResetCounters()
+{
+    for (uint8_t i = 0; i < XDS_MAX_RULES; i++) hits[i] = 0;
+    checked = 0;
+    rejected = 0;
+    spikes = 0;
+}
+
+bool XdsValidator::check(const XdsFrameView& frame)
+{
+    int32_t fields[XDS_FIELD_COUNT];
+    int32_t total = frame.totalPower();
+    fields[XDS_FIELD_TOTAL_POWER] = total;
+    fields[XDS_FIELD_LEFT_POWER] = frame.leftPower();
+    fields[XDS_FIELD_RIGHT_POWER] = frame.rightPower();
+    fields[XDS_FIELD_ANGLE] = frame.angle();
+    fields[XDS_FIELD_CADENCE] = frame.cadence();
+    fields[XDS_FIELD_ERROR_CODE] = frame.errorCode();
+    int32_t diff = fields[XDS_FIELD_LEFT_POWER] + fields[XDS_FIELD_RIGHT_POWER] - total;
+    fields[XDS_FIELD_LR_MISMATCH] = total > 10 ? (diff < 0 ? -diff : diff) * 100 / total : 0;
+
+    // 无符号比较一次完成 min <= v <= max 的检查
+    uint32_t violated = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const xds_rule_t& r = rules[i];
+        uint32_t outside = (uint32_t)(fields[r.field] - r.min) > (uint32_t)(r.max - r.min);
+        violated |= outside << i;
+    }
+
+    checked++;
+    if (violated == 0) return true;
+    for (uint8_t i = 0; i < count; i++) {
+        hits[i] += (violated >> i) & 1u;
+    }
+    if ((violated & rejectMask) == 0) return true;
+    rejected++;
+    return false;
+}
+
+uint16_t XdsValidator::filterPower(uint16_t watts)
+{
+    ring[ringHead] = watts;
+    ringHead = (uint8_t)((ringHead + 1) % XDS_SPIKE_WINDOW);
+    if (ringFilled < XDS_SPIKE_WINDOW) {
+        ringFilled++;
+        return watts;
+    }
+
+    // 窗口含当前帧，单个尖峰不会成为中值；窗口保存原始值，真实的阶跃随后通过
+    int32_t median = median5(ring);
+    int32_t delta = (int32_t)watts - median;
+    if (delta < 0) delta = -delta;
+    int32_t limit = median > XDS_SPIKE_MIN_DELTA_W ? median : XDS_SPIKE_MIN_DELTA_W;
+    if (delta > limit) {
+        spikes++;
+        return (uint16_t)median;
+    }
+    return watts;
+}
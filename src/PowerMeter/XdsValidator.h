@@ -0,0 +1,86 @@
+#ifndef XdsValidator_h
+#define XdsValidator_h
+
+#include <stdint.h>
+#include "XdsFrameView.h"
+
+#define XDS_MAX_RULES                   16      // 规则表长度上限 (违反位图为32位)
+#define XDS_SPIKE_WINDOW                5       // 尖峰滤波的中值窗口 (帧)
+#define XDS_SPIKE_MIN_DELTA_W           300     // 偏离中值超过max(该值, 中值)才视为尖峰
+
+// 规则检查的帧字段，每帧解码一次
+typedef enum
+{
+    XDS_FIELD_TOTAL_POWER,
+    XDS_FIELD_LEFT_POWER,
+    XDS_FIELD_RIGHT_POWER,
+    XDS_FIELD_ANGLE,
+    XDS_FIELD_CADENCE,
+    XDS_FIELD_ERROR_CODE,
+    XDS_FIELD_LR_MISMATCH,      // |左+右-总功率|占总功率的百分比，总功率不超过10 W时为0
+    XDS_FIELD_COUNT
+} xds_field_t;
+
+typedef enum
+{
+    XDS_RULE_REJECT,            // 超出范围的帧被丢弃
+    XDS_RULE_WARN               // 只计数，帧照常使用
+} xds_rule_action_t;
+
+// 一条范围规则：字段值在[min, max]之外即违反
+typedef struct
+{
+    const char* name;
+    uint8_t field;              // xds_field_t
+    uint8_t action;             // xds_rule_action_t
+    int32_t min;
+    int32_t max;
+} xds_rule_t;
+
+// 默认规则表：总功率/踏频/角度/左右功率范围、左右和与总功率误差、errorCode严重程度
+extern const xds_rule_t xdsDefaultRules[];
+extern const uint8_t xdsDefaultRuleCount;
+
+// 喜德盛帧校验：按规则表逐条做无分支的范围比较，违反的规则计数而不打印；
+// 通过校验的总功率再经中值尖峰滤波。只在update()所在任务中使用。
+class XdsValidator
+{
+public:
+    XdsValidator();
+
+    // 规则表须在使用期间有效；条数超过XDS_MAX_RULES时返回false并保留原表
+    bool setRules(const xds_rule_t* table, uint8_t count);
+
+    // 帧通过所有REJECT规则时返回true；REJECT与WARN规则的违反都计入ruleHits()
+    bool check(const XdsFrameView& frame);
+
+    // 中值尖峰滤波：窗口内单帧 (或连续两帧) 的突变返回窗口中值，持续的变化
+    // 在第三帧后通过。窗口未满时原样返回。
+    uint16_t filterPower(uint16_t watts);
+
+    // 新连接：清空尖峰窗口，计数保留
+    void Restart()                      { ringFilled = 0; ringHead = 0; }
+    void ResetCounters();
+
+    uint8_t ruleCount() const           { return count; }
+    const xds_rule_t& rule(uint8_t i) const { return rules[i]; }
+    uint32_t ruleHits(uint8_t i) const  { return hits[i]; }
+    uint32_t checkedCount() const       { return checked; }
+    uint32_t rejectedCount() const      { return rejected; }
+    uint32_t spikeCount() const         { return spikes; }
+
+private:
+    const xds_rule_t* rules;
+    uint8_t count;
+    uint32_t rejectMask;                // REJECT规则的位
+    uint32_t hits[XDS_MAX_RULES];
+    uint32_t checked;
+    uint32_t rejected;
+    uint32_t spikes;
+
+    uint16_t ring[XDS_SPIKE_WINDOW];    // 最近几帧的原始总功率
+    uint8_t ringHead;
+    uint8_t ringFilled;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef RECENTADDRFILTER_H
+#define RECENTADDRFILTER_H
+
+#include <stdint.h>
+
+/**@brief Fixed-RAM set of recently seen 6-byte BLE addresses.
+ *
+ * Each address is reduced to a 32-bit FNV-1a tag stored in a direct-mapped
+ * table, so Contains() and Insert() are a hash and one compare. A colliding
+ * insert simply evicts the older tag (the evicted address is checked the
+ * slow way again), and two addresses with the same tag are treated as one,
+ * which Clear() bounds to the owner's aging period. Not thread safe.
+ *
+ * @tparam SLOTS  Table size, must be a power of two.
+ */
+template <uint32_t SLOTS>
+class RecentAddrFilter
+{
+public:
+   RecentAddrFilter() : m_inserts(0) { Clear(); }
+
+   bool Contains(const uint8_t* addr) const
+   {
+      uint32_t tag = Tag(addr);
+      return m_tags[tag & (SLOTS - 1)] == tag;
+   }
+
+   void Insert(const uint8_t* addr)
+   {
+      uint32_t tag = Tag(addr);
+      m_tags[tag & (SLOTS - 1)] = tag;
+      m_inserts++;
+   }
+
+   void Clear()
+   {
+      for (uint32_t i = 0; i < SLOTS; i++) m_tags[i] = 0;
+   }
+
+   /**@brief Number of occupied slots, O(SLOTS). */
+   uint32_t Size() const
+   {
+      uint32_t used = 0;
+      for (uint32_t i = 0; i < SLOTS; i++) used += m_tags[i] != 0;
+      return used;
+   }
+
+   uint32_t GetInsertCount() const { return m_inserts; }
+   static uint32_t Capacity() { return SLOTS; }
+
+private:
+   static_assert(SLOTS != 0 && (SLOTS & (SLOTS - 1)) == 0, "RecentAddrFilter: SLOTS must be a power of two");
+
+   /// FNV-1a over the 6 address bytes; 0 marks an empty slot.
+   static uint32_t Tag(const uint8_t* addr)
+   {
+      uint32_t h = 2166136261u;
+      for (uint8_t i = 0; i < 6; i++)
+      {
+         h ^= addr[i];
+         h *= 16777619u;
+      }
+      return h != 0 ? h : 1;
+   }
+
+   uint32_t m_tags[SLOTS];
+   uint32_t m_inserts;
+};
+
+#endif
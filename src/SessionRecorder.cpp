@@ -0,0 +1,479 @@
+#include "SessionRecorder.h"
+#include "ANTProfile.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Adafruit_LittleFS_Namespace;
+
+static_assert(SESSION_MAX_PAYLOAD <= 16, "the BLE change mask is 16 bits");
+static_assert(SESSION_MAX_STREAMS <= 64, "the stream number has 6 bits in the tag");
+
+#define SESSION_HEADER_SIZE   8
+#define SESSION_MAX_RECORD    (1 + 5 + 2 + SESSION_MAX_PAYLOAD)   ///< Tag, dt varint, mask, bytes.
+
+static const uint8_t s_magic[4] = { 'P', 'M', 'R', '1' };
+
+SessionRecorder Recorder;
+
+static void session_task(void* arg);
+static void session_tx_tap(uint8_t channel, uint8_t const* payload);
+
+SessionRecorder::SessionRecorder() :
+   m_lost_seen(0),
+   m_active(false),
+   m_request(SESSION_REQUEST_NONE),
+   m_file(InternalFS),
+   m_file_open(false),
+   m_file_index(1),
+   m_oldest_index(1),
+   m_file_bytes(0),
+   m_staged(0),
+   m_pages_since_sync(0),
+   m_last_tick(0)
+{
+   m_file_name[0] = '\0';
+   memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool SessionRecorder::begin(void)
+{
+   if (!InternalFS.begin()) return false;
+   if (!InternalFS.exists(SESSION_DIR) && !InternalFS.mkdir(SESSION_DIR)) return false;
+
+   // Continue numbering after the newest file left by a previous session.
+   uint32_t newest = 0;
+   uint32_t oldest = UINT32_MAX;
+   File dir = InternalFS.open(SESSION_DIR, FILE_O_READ);
+   if (dir)
+   {
+      File entry = dir.openNextFile();
+      while (entry)
+      {
+         const char* name = entry.name();
+         const char* slash = strrchr(name, '/');
+         if (slash) name = slash + 1;
+         if (name[0] == 's' && !entry.isDirectory())
+         {
+            uint32_t index = (uint32_t)strtoul(name + 1, NULL, 10);
+            if (index > newest) newest = index;
+            if (index != 0 && index < oldest) oldest = index;
+         }
+         entry.close();
+         entry = dir.openNextFile();
+      }
+      dir.close();
+   }
+   m_file_index = newest + 1;
+   m_oldest_index = oldest == UINT32_MAX ? m_file_index : oldest;
+
+   ANTProfile::SetTxTap(session_tx_tap);
+
+   TaskHandle_t rec_task_hdl;
+   return xTaskCreate(session_task, "REC", CFG_SESSION_TASK_STACKSIZE, NULL, TASK_PRIO_LOWEST, &rec_task_hdl) == pdPASS;
+}
+
+void SessionRecorder::Start(void)
+{
+   __atomic_store_n(&m_request, (uint8_t)SESSION_REQUEST_START, __ATOMIC_RELEASE);
+}
+
+void SessionRecorder::Stop(void)
+{
+   // Producers stop at once; Service() still writes what is queued.
+   __atomic_store_n(&m_active, false, __ATOMIC_RELEASE);
+   __atomic_store_n(&m_request, (uint8_t)SESSION_REQUEST_STOP, __ATOMIC_RELEASE);
+}
+
+void SessionRecorder::RecordBle(uint8_t stream, uint32_t tick, const uint8_t* data, uint8_t len)
+{
+   if (!IsRecording() || stream >= SESSION_MAX_STREAMS) return;
+   session_record_t rec;
+   rec.tick = tick;
+   rec.type = SESSION_REC_BLE;
+   rec.stream = stream;
+   rec.len = len > SESSION_MAX_PAYLOAD ? SESSION_MAX_PAYLOAD : len;
+   memcpy(rec.data, data, rec.len);
+   rec.lost = 0;
+   m_ble_queue.Push(rec);
+}
+
+void SessionRecorder::RecordAnt(uint8_t channel, const uint8_t* payload)
+{
+   if (!IsRecording() || channel >= SESSION_MAX_STREAMS) return;
+   session_record_t rec;
+   rec.tick = millis();
+   rec.type = SESSION_REC_ANT;
+   rec.stream = channel;
+   rec.len = 8;
+   memcpy(rec.data, payload, 8);
+   rec.lost = 0;
+   m_ant_queue.Push(rec);
+}
+
+uint32_t SessionRecorder::Service(void)
+{
+   uint8_t request = __atomic_exchange_n(&m_request, (uint8_t)SESSION_REQUEST_NONE, __ATOMIC_ACQ_REL);
+   if (request == SESSION_REQUEST_START)
+   {
+      if (m_file_open) CloseFile();
+      memset(&m_stats, 0, sizeof(m_stats));
+      m_lost_seen = m_ble_queue.GetOverflowCount() + m_ant_queue.GetOverflowCount();
+      if (OpenNextFile()) __atomic_store_n(&m_active, true, __ATOMIC_RELEASE);
+   }
+
+   // Merge both queues oldest first. Records queued while no file is open
+   // (just after Stop()) are consumed and discarded.
+   uint32_t count = 0;
+   session_record_t ble;
+   session_record_t ant;
+   bool have_ble = m_ble_queue.Peek(ble);
+   bool have_ant = m_ant_queue.Peek(ant);
+   while (have_ble || have_ant)
+   {
+      bool take_ble = have_ble && (!have_ant || (int32_t)(ble.tick - ant.tick) <= 0);
+      if (m_file_open) Encode(take_ble ? ble : ant);
+      if (take_ble)
+      {
+         m_ble_queue.Pop(ble);
+         have_ble = m_ble_queue.Peek(ble);
+      }
+      else
+      {
+         m_ant_queue.Pop(ant);
+         have_ant = m_ant_queue.Peek(ant);
+      }
+      count++;
+   }
+
+   uint32_t lost = m_ble_queue.GetOverflowCount() + m_ant_queue.GetOverflowCount();
+   if (lost != m_lost_seen)
+   {
+      session_record_t gap;
+      memset(&gap, 0, sizeof(gap));
+      gap.tick = millis();
+      gap.type = SESSION_REC_GAP;
+      gap.lost = lost - m_lost_seen;
+      m_stats.lost += gap.lost;
+      m_lost_seen = lost;
+      if (m_file_open) Encode(gap);
+   }
+
+   // After the queues are drained, so what was recorded before Stop() is kept.
+   if (request == SESSION_REQUEST_STOP)
+   {
+      __atomic_store_n(&m_active, false, __ATOMIC_RELEASE);
+      if (m_file_open) CloseFile();
+   }
+   return count;
+}
+
+void SessionRecorder::FileName(char* buf, size_t size, uint32_t index)
+{
+   snprintf(buf, size, SESSION_DIR "/s%05lu.bin", (unsigned long)index);
+}
+
+void SessionRecorder::DeleteOldFiles(void)
+{
+   // Files are capped at SESSION_FILE_MAX_BYTES, so a file count bounds the bytes.
+   char name[sizeof(m_file_name)];
+   while (m_file_index - m_oldest_index >= SESSION_MAX_FILES)
+   {
+      FileName(name, sizeof(name), m_oldest_index);
+      if (InternalFS.exists(name)) InternalFS.remove(name);
+      m_oldest_index++;
+   }
+}
+
+bool SessionRecorder::DeleteOldestFile(void)
+{
+   // Never the open file: m_file_index already points past it.
+   char name[sizeof(m_file_name)];
+   uint32_t current = m_file_open ? m_file_index - 1 : m_file_index;
+   while (m_oldest_index < current)
+   {
+      FileName(name, sizeof(name), m_oldest_index++);
+      if (InternalFS.exists(name) && InternalFS.remove(name)) return true;
+   }
+   return false;
+}
+
+bool SessionRecorder::OpenNextFile(void)
+{
+   DeleteOldFiles();
+   FileName(m_file_name, sizeof(m_file_name), m_file_index);
+   if (InternalFS.exists(m_file_name)) InternalFS.remove(m_file_name);
+   if (!m_file.open(m_file_name, FILE_O_WRITE))
+   {
+      m_stats.write_errors++;
+      __atomic_store_n(&m_active, false, __ATOMIC_RELEASE);
+      return false;
+   }
+   m_file_index++;
+   m_file_open = true;
+   m_file_bytes = 0;
+   m_pages_since_sync = 0;
+   m_stats.files++;
+
+   // Each file starts from empty delta state so it decodes on its own.
+   memset(m_ble_prev, 0, sizeof(m_ble_prev));
+   memset(m_ble_prev_len, 0, sizeof(m_ble_prev_len));
+   memset(m_ant_prev, 0, sizeof(m_ant_prev));
+   m_last_tick = millis();
+   memcpy(m_staging, s_magic, sizeof(s_magic));
+   for (uint8_t i = 0; i < 4; i++) m_staging[4 + i] = (uint8_t)(m_last_tick >> (8 * i));
+   m_staged = SESSION_HEADER_SIZE;
+   return true;
+}
+
+bool SessionRecorder::CloseFile(void)
+{
+   bool ok = m_staged == 0 || WriteStaged(m_staged);
+   m_file.close();
+   m_file_open = false;
+   return ok;
+}
+
+bool SessionRecorder::WriteStaged(uint32_t len)
+{
+   uint32_t start = micros();
+   size_t written = m_file.write(m_staging, len);
+   if (written < len && DeleteOldestFile()) written += m_file.write(m_staging + written, len - written);
+   uint32_t elapsed = micros() - start;
+   if (elapsed > m_stats.max_write_us) m_stats.max_write_us = elapsed;
+   m_stats.bytes += written;
+   m_file_bytes += written;
+
+   if (written != len)
+   {
+      // The file ends in a truncated record, which SessionReader treats as
+      // the end. Appending more would desynchronise it, so stop here.
+      m_stats.write_errors++;
+      m_staged = 0;
+      m_file.close();
+      m_file_open = false;
+      __atomic_store_n(&m_active, false, __ATOMIC_RELEASE);
+      return false;
+   }
+
+   m_staged -= len;
+   memmove(m_staging, m_staging + len, m_staged);
+
+   // LittleFS commits file metadata on flush(); until then a reset loses
+   // the data written since the previous one.
+   if (++m_pages_since_sync >= SESSION_SYNC_PAGES)
+   {
+      m_file.flush();
+      m_pages_since_sync = 0;
+   }
+   return true;
+}
+
+void SessionRecorder::PutVarint(uint32_t value)
+{
+   while (value >= 0x80)
+   {
+      m_staging[m_staged++] = (uint8_t)(value | 0x80);
+      value >>= 7;
+   }
+   m_staging[m_staged++] = (uint8_t)value;
+}
+
+void SessionRecorder::Encode(const session_record_t& rec)
+{
+   if (m_file_bytes + m_staged + SESSION_MAX_RECORD > SESSION_FILE_MAX_BYTES)
+   {
+      if (!CloseFile() || !OpenNextFile()) return;
+   }
+
+   // Records reach the queues slightly out of order (BLE samples carry
+   // their notification time); the file stores them in service order.
+   uint32_t dt = (int32_t)(rec.tick - m_last_tick) > 0 ? rec.tick - m_last_tick : 0;
+   m_last_tick += dt;
+
+   uint8_t type = rec.type;
+   if (type == SESSION_REC_BLE && rec.len != m_ble_prev_len[rec.stream]) type = SESSION_REC_BLE_RAW;
+   m_staging[m_staged++] = (uint8_t)(type << 6 | rec.stream);
+   PutVarint(dt);
+
+   switch (type)
+   {
+      case SESSION_REC_BLE:
+      {
+         uint8_t* prev = m_ble_prev[rec.stream];
+         uint32_t mask_pos = m_staged;
+         m_staged += 2;
+         uint16_t mask = 0;
+         for (uint8_t i = 0; i < rec.len; i++)
+         {
+            if (rec.data[i] == prev[i]) continue;
+            mask |= (uint16_t)(1u << i);
+            m_staging[m_staged++] = rec.data[i];
+            prev[i] = rec.data[i];
+         }
+         m_staging[mask_pos] = (uint8_t)mask;
+         m_staging[mask_pos + 1] = (uint8_t)(mask >> 8);
+         break;
+      }
+
+      case SESSION_REC_BLE_RAW:
+         m_staging[m_staged++] = rec.len;
+         memcpy(&m_staging[m_staged], rec.data, rec.len);
+         m_staged += rec.len;
+         memcpy(m_ble_prev[rec.stream], rec.data, rec.len);
+         m_ble_prev_len[rec.stream] = rec.len;
+         break;
+
+      case SESSION_REC_ANT:
+      {
+         uint8_t* prev = m_ant_prev[rec.stream];
+         uint32_t mask_pos = m_staged++;
+         uint8_t mask = 0;
+         for (uint8_t i = 0; i < 8; i++)
+         {
+            if (rec.data[i] == prev[i]) continue;
+            mask |= (uint8_t)(1u << i);
+            m_staging[m_staged++] = rec.data[i];
+            prev[i] = rec.data[i];
+         }
+         m_staging[mask_pos] = mask;
+         break;
+      }
+
+      case SESSION_REC_GAP:
+         PutVarint(rec.lost);
+         break;
+   }
+   m_stats.records++;
+
+   if (m_staged >= SESSION_PAGE_SIZE) WriteStaged(SESSION_PAGE_SIZE);
+}
+
+static void session_task(void* arg)
+{
+   (void)arg;
+   while (1)
+   {
+      if (Recorder.Service() == 0) vTaskDelay(pdMS_TO_TICKS(50));
+   }
+}
+
+static void session_tx_tap(uint8_t channel, uint8_t const* payload)
+{
+   Recorder.RecordAnt(channel, payload);
+}
+
+SessionReader::SessionReader(File& file) :
+   m_file(file)
+{
+   Restart();
+}
+
+bool SessionReader::Restart(void)
+{
+   m_len = 0;
+   m_pos = 0;
+   m_valid = false;
+   m_tick = 0;
+   memset(m_ble_prev, 0, sizeof(m_ble_prev));
+   memset(m_ble_prev_len, 0, sizeof(m_ble_prev_len));
+   memset(m_ant_prev, 0, sizeof(m_ant_prev));
+
+   uint8_t header[SESSION_HEADER_SIZE];
+   for (uint8_t i = 0; i < SESSION_HEADER_SIZE; i++)
+   {
+      if (!GetByte(header[i])) return false;
+   }
+   if (memcmp(header, s_magic, sizeof(s_magic)) != 0) return false;
+   for (uint8_t i = 0; i < 4; i++) m_tick |= (uint32_t)header[4 + i] << (8 * i);
+   m_valid = true;
+   return true;
+}
+
+bool SessionReader::GetByte(uint8_t& b)
+{
+   if (m_pos == m_len)
+   {
+      if (!m_file) return false;
+      int got = m_file.read(m_buffer, sizeof(m_buffer));
+      if (got <= 0) return false;
+      m_len = (uint16_t)got;
+      m_pos = 0;
+   }
+   b = m_buffer[m_pos++];
+   return true;
+}
+
+bool SessionReader::GetVarint(uint32_t& value)
+{
+   value = 0;
+   for (uint8_t shift = 0; shift < 35; shift += 7)
+   {
+      uint8_t b;
+      if (!GetByte(b)) return false;
+      value |= (uint32_t)(b & 0x7F) << shift;
+      if ((b & 0x80) == 0) return true;
+   }
+   return false;
+}
+
+bool SessionReader::Next(session_record_t& rec)
+{
+   uint8_t tag;
+   uint32_t dt;
+   if (!m_valid || !GetByte(tag) || !GetVarint(dt)) return false;
+   m_tick += dt;
+   memset(&rec, 0, sizeof(rec));
+   rec.tick = m_tick;
+   rec.type = tag >> 6;
+   rec.stream = tag & 0x3F;
+   if (rec.type != SESSION_REC_GAP && rec.stream >= SESSION_MAX_STREAMS) return false;
+
+   switch (rec.type)
+   {
+      case SESSION_REC_BLE:
+      {
+         uint8_t lo, hi;
+         if (!GetByte(lo) || !GetByte(hi)) return false;
+         uint16_t mask = (uint16_t)(lo | hi << 8);
+         uint8_t* prev = m_ble_prev[rec.stream];
+         rec.len = m_ble_prev_len[rec.stream];
+         for (uint8_t i = 0; i < rec.len; i++)
+         {
+            if ((mask >> i) & 1u && !GetByte(prev[i])) return false;
+         }
+         memcpy(rec.data, prev, rec.len);
+         break;
+      }
+
+      case SESSION_REC_BLE_RAW:
+         if (!GetByte(rec.len) || rec.len > SESSION_MAX_PAYLOAD) return false;
+         for (uint8_t i = 0; i < rec.len; i++)
+         {
+            if (!GetByte(rec.data[i])) return false;
+         }
+         memcpy(m_ble_prev[rec.stream], rec.data, rec.len);
+         m_ble_prev_len[rec.stream] = rec.len;
+         rec.type = SESSION_REC_BLE;
+         break;
+
+      case SESSION_REC_ANT:
+      {
+         uint8_t mask;
+         if (!GetByte(mask)) return false;
+         uint8_t* prev = m_ant_prev[rec.stream];
+         for (uint8_t i = 0; i < 8; i++)
+         {
+            if ((mask >> i) & 1u && !GetByte(prev[i])) return false;
+         }
+         rec.len = 8;
+         memcpy(rec.data, prev, 8);
+         break;
+      }
+
+      case SESSION_REC_GAP:
+         if (!GetVarint(rec.lost)) return false;
+         break;
+   }
+   return true;
+}
@@ -0,0 +1,200 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <stdint.h>
+#include <Arduino.h>
+#include <InternalFileSystem.h>
+#include "SpscRing.h"
+
+#define SESSION_DIR                 "/rec"
+#define SESSION_PAGE_SIZE           256     ///< Bytes per flash write.
+#define SESSION_STAGING_SIZE        (2 * SESSION_PAGE_SIZE)
+#define SESSION_SYNC_PAGES          8       ///< File::flush() (metadata commit) every N pages.
+#ifndef LFS_FLASH_TOTAL_SIZE
+#define LFS_FLASH_TOTAL_SIZE        (7 * 4096)  ///< InternalFS partition of the nRF52 core.
+#endif
+#define SESSION_FS_RESERVE_BYTES    (8 * 1024)  ///< Left for bonds, LittleFS metadata and copy-on-write blocks.
+#define SESSION_FILE_MAX_BYTES      (4 * 1024)
+#define SESSION_BUDGET_BYTES        (LFS_FLASH_TOTAL_SIZE - SESSION_FS_RESERVE_BYTES)   ///< Oldest files are deleted beyond this.
+#define SESSION_MAX_FILES           (SESSION_BUDGET_BYTES / SESSION_FILE_MAX_BYTES)
+#define SESSION_MAX_PAYLOAD         16      ///< Largest BLE notification recorded byte for byte.
+#define SESSION_MAX_STREAMS         8       ///< Per-type delta state (links / ANT channels).
+#define SESSION_BLE_QUEUE_SIZE      16      ///< Must be a power of two.
+#define SESSION_ANT_QUEUE_SIZE      32      ///< Must be a power of two.
+
+#ifndef CFG_SESSION_TASK_STACKSIZE
+#define CFG_SESSION_TASK_STACKSIZE  (256 * 4)
+#endif
+
+typedef enum
+{
+   SESSION_REQUEST_NONE,
+   SESSION_REQUEST_START,
+   SESSION_REQUEST_STOP
+} session_request_t;
+
+/**@brief Record types, stored in the top two bits of each record's tag.
+ *
+ * File layout: an 8-byte header ("PMR1", then the millis() at which the
+ * file was opened, little endian) followed by records:
+ *
+ *   tag       type << 6 | stream (0..63)
+ *   dt        unsigned LEB128 varint, ms since the previous record (or the header)
+ *   body      SESSION_REC_BLE: u16 LE change mask, then the changed bytes;
+ *                             the length is that of the stream's previous frame
+ *             SESSION_REC_ANT: u8 change mask, then the changed bytes (8-byte payload)
+ *             SESSION_REC_BLE_RAW: u8 length, then every byte (length changed)
+ *             SESSION_REC_GAP: varint count of records lost to full queues
+ *
+ * The change mask has bit i set when byte i differs from the same stream's
+ * previous payload in this file. Delta state starts at all zero and empty
+ * in every file, so each file decodes on its own.
+ */
+typedef enum
+{
+   SESSION_REC_BLE = 0,
+   SESSION_REC_ANT = 1,
+   SESSION_REC_BLE_RAW = 2,
+   SESSION_REC_GAP = 3
+} session_rec_type_t;
+
+/**@brief One decoded record; also the queue element between producers and the writer. */
+typedef struct
+{
+   uint32_t tick;                       ///< millis() when captured.
+   uint8_t  type;                       ///< session_rec_type_t; SESSION_REC_BLE_RAW decodes as SESSION_REC_BLE.
+   uint8_t  stream;                     ///< Link index for BLE, channel number for ANT.
+   uint8_t  len;
+   uint8_t  data[SESSION_MAX_PAYLOAD];
+   uint32_t lost;                       ///< SESSION_REC_GAP only.
+} session_record_t;
+
+typedef struct
+{
+   uint32_t records;                    ///< Records encoded since Start().
+   uint32_t bytes;                      ///< Bytes written to flash since Start().
+   uint32_t lost;                       ///< Records dropped because a queue was full.
+   uint32_t files;                      ///< Files opened since Start().
+   uint32_t write_errors;               ///< Failed opens and short writes; either stops recording.
+   uint32_t max_write_us;               ///< Slowest page write.
+} session_stats_t;
+
+/**@brief Appends raw BLE notifications and transmitted ANT payloads to a
+ *        compact binary log on the internal LittleFS.
+ *
+ * RecordBle() and RecordAnt() only copy into lock-free rings and never
+ * touch flash, so the ANT task is never blocked; each has exactly one
+ * producer context (the loop and the ANT task respectively). Service()
+ * merges both rings in time order, delta-encodes into a RAM staging buffer
+ * and writes it out in SESSION_PAGE_SIZE pages. It runs in its own
+ * lowest-priority task on target and from the host loop. Files rotate at
+ * SESSION_FILE_MAX_BYTES and at most SESSION_MAX_FILES are kept. A short
+ * write (LittleFS reports LFS_ERR_NOSPC that way) deletes the oldest file
+ * and retries once; if that fails too the file is closed where it stands
+ * and recording stops.
+ */
+class SessionRecorder
+{
+public:
+   SessionRecorder();
+
+   /**@brief Mounts the file system and starts the writer task. */
+   bool begin(void);
+
+   /**@brief Requests a new recording file; takes effect in Service().
+    *        Start() and Stop() overwrite one request word, so when both
+    *        come before the next Service() the later call wins.
+    */
+   void Start(void);
+   /**@brief Requests the current file be flushed and closed. */
+   void Stop(void);
+   bool IsRecording(void) const { return __atomic_load_n(&m_active, __ATOMIC_ACQUIRE); }
+
+   void RecordBle(uint8_t stream, uint32_t tick, const uint8_t* data, uint8_t len);
+   void RecordAnt(uint8_t channel, const uint8_t* payload);
+
+   /**@brief Encodes pending records and writes full pages.
+    * @return Number of records encoded.
+    */
+   uint32_t Service(void);
+
+   void GetStats(session_stats_t* stats) const { *stats = m_stats; }
+   const char* GetFileName(void) const { return m_file_name; }
+   uint32_t GetFileIndex(void) const { return m_file_index; }
+
+private:
+   bool OpenNextFile(void);
+   bool CloseFile(void);
+   void Encode(const session_record_t& rec);
+   bool WriteStaged(uint32_t len);
+   void PutVarint(uint32_t value);
+   void DeleteOldFiles(void);
+   bool DeleteOldestFile(void);
+   static void FileName(char* buf, size_t size, uint32_t index);
+
+   SpscRing<session_record_t, SESSION_BLE_QUEUE_SIZE> m_ble_queue;
+   SpscRing<session_record_t, SESSION_ANT_QUEUE_SIZE> m_ant_queue;
+   uint32_t m_lost_seen;                ///< Overflow total already written as a GAP record.
+
+   bool m_active;                       ///< Producers record while set.
+   uint8_t m_request;                   ///< session_request_t, written by Start()/Stop(), taken by Service().
+
+   Adafruit_LittleFS_Namespace::File m_file;
+   bool m_file_open;
+   char m_file_name[24];
+   uint32_t m_file_index;               ///< Index of the current (or next) file.
+   uint32_t m_oldest_index;             ///< Oldest file still on flash.
+   uint32_t m_file_bytes;
+
+   uint8_t m_staging[SESSION_STAGING_SIZE];
+   uint32_t m_staged;
+   uint32_t m_pages_since_sync;
+   uint32_t m_last_tick;
+
+   uint8_t m_ble_prev[SESSION_MAX_STREAMS][SESSION_MAX_PAYLOAD];
+   uint8_t m_ble_prev_len[SESSION_MAX_STREAMS];
+   uint8_t m_ant_prev[SESSION_MAX_STREAMS][8];
+
+   session_stats_t m_stats;
+};
+
+/**@brief Decodes a file written by SessionRecorder, one record at a time. */
+class SessionReader
+{
+public:
+   /**@brief Binds to file and reads the header at its current position. */
+   explicit SessionReader(Adafruit_LittleFS_Namespace::File& file);
+
+   /**@brief Forgets all state and reads a header again, e.g. after the
+    *        bound File was reopened on another recording.
+    * @return IsValid().
+    */
+   bool Restart(void);
+
+   /**@brief False when the header is missing or wrong. */
+   bool IsValid(void) const { return m_valid; }
+   uint32_t GetStartTick(void) const { return m_tick; }
+
+   /**@brief Next record, with delta and time decoding applied.
+    * @return False at the end of the file or on a truncated record.
+    */
+   bool Next(session_record_t& rec);
+
+private:
+   bool GetByte(uint8_t& b);
+   bool GetVarint(uint32_t& value);
+
+   Adafruit_LittleFS_Namespace::File& m_file;
+   uint8_t m_buffer[64];
+   uint16_t m_len;
+   uint16_t m_pos;
+   bool m_valid;
+   uint32_t m_tick;
+   uint8_t m_ble_prev[SESSION_MAX_STREAMS][SESSION_MAX_PAYLOAD];
+   uint8_t m_ble_prev_len[SESSION_MAX_STREAMS];
+   uint8_t m_ant_prev[SESSION_MAX_STREAMS][8];
+};
+
+extern SessionRecorder Recorder;
+
+#endif
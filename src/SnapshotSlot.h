@@ -0,0 +1,58 @@
+#ifndef SNAPSHOTSLOT_H
+#define SNAPSHOTSLOT_H
+
+#include <stdint.h>
+
+/**@brief Single-writer "latest value" slot that readers copy without locks.
+ *
+ * Double-buffered sequence lock: Write() bumps the sequence before updating
+ * each of the two copies, so whichever copy the sequence currently points a
+ * reader at is never the one being modified. A reader that preempts the
+ * writer (the ANT task preempting loop()) therefore always gets a
+ * consistent value on its first attempt and never waits for the writer;
+ * Read() only retries if a write completed while the reader itself was
+ * preempted.
+ *
+ * @tparam T  Trivially copyable value type.
+ */
+template <typename T>
+class SnapshotSlot
+{
+public:
+   SnapshotSlot() : m_sequence(0) { m_copies[0] = T(); m_copies[1] = T(); }
+
+   /**@brief Writer side; only one context may write. */
+   void Write(const T& value)
+   {
+      uint32_t seq = m_sequence;
+      __atomic_store_n(&m_sequence, seq + 1, __ATOMIC_RELEASE);   // readers move to copy 1
+      __atomic_thread_fence(__ATOMIC_RELEASE);
+      m_copies[0] = value;
+      __atomic_store_n(&m_sequence, seq + 2, __ATOMIC_RELEASE);   // readers move back to copy 0
+      __atomic_thread_fence(__ATOMIC_RELEASE);
+      m_copies[1] = value;
+   }
+
+   /**@brief Reader side; any number of contexts may read. */
+   T Read() const
+   {
+      T value;
+      uint32_t seq;
+      do
+      {
+         seq = __atomic_load_n(&m_sequence, __ATOMIC_ACQUIRE);
+         value = m_copies[seq & 1u];
+         __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      } while (seq != __atomic_load_n(&m_sequence, __ATOMIC_RELAXED));
+      return value;
+   }
+
+   /// Number of completed writes.
+   uint32_t GetWriteCount() const { return __atomic_load_n(&m_sequence, __ATOMIC_ACQUIRE) >> 1; }
+
+private:
+   T m_copies[2];
+   uint32_t m_sequence;        ///< Odd while copy 0 is being written.
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <stdint.h>
+
+/**@brief Fixed-capacity, lock-free single-producer/single-consumer ring.
+ *
+ * One context may call Push(), exactly one other may call Pop()/Peek().
+ * The indices are free-running 32-bit counters published with
+ * acquire/release semantics, so no critical section is ever taken and a
+ * full ring simply rejects the push (counted in GetOverflowCount()).
+ *
+ * @tparam T     Element type, copied by value.
+ * @tparam SIZE  Capacity, must be a power of two.
+ */
+template <typename T, uint32_t SIZE>
+class SpscRing
+{
+public:
+   SpscRing() : m_head(0), m_tail(0), m_overflow_count(0), m_high_water(0) {}
+
+   /**@brief Producer side. Returns false (and counts an overflow) when full. */
+   bool Push(const T& item)
+   {
+      uint32_t head = m_head;
+      uint32_t tail = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+      uint32_t used = head - tail;
+      if (used >= SIZE)
+      {
+         m_overflow_count++;
+         return false;
+      }
+      m_items[head & (SIZE - 1)] = item;
+      __atomic_store_n(&m_head, head + 1, __ATOMIC_RELEASE);
+      if (used + 1 > m_high_water) m_high_water = used + 1;
+      return true;
+   }
+
+   /**@brief Consumer side. Returns false when empty. */
+   bool Pop(T& item)
+   {
+      uint32_t tail = m_tail;
+      if (__atomic_load_n(&m_head, __ATOMIC_ACQUIRE) == tail) return false;
+      item = m_items[tail & (SIZE - 1)];
+      __atomic_store_n(&m_tail, tail + 1, __ATOMIC_RELEASE);
+      return true;
+   }
+
+   /**@brief Consumer side. Copies the oldest item without removing it. */
+   bool Peek(T& item) const
+   {
+      uint32_t tail = m_tail;
+      if (__atomic_load_n(&m_head, __ATOMIC_ACQUIRE) == tail) return false;
+      item = m_items[tail & (SIZE - 1)];
+      return true;
+   }
+
+   uint32_t Size() const { return __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE); }
+   bool IsEmpty() const { return Size() == 0; }
+   static uint32_t Capacity() { return SIZE; }
+
+   /// Number of successful pushes since construction.
+   uint32_t GetPushCount() const { return __atomic_load_n(&m_head, __ATOMIC_ACQUIRE); }
+   uint32_t GetOverflowCount() const { return m_overflow_count; }
+   uint32_t GetHighWater() const { return m_high_water; }
+
+private:
+   static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "SpscRing size must be a power of two");
+
+   T m_items[SIZE];
+   uint32_t m_head;            ///< Written by the producer only.
+   uint32_t m_tail;            ///< Written by the consumer only.
+   uint32_t m_overflow_count;  ///< Producer-owned statistics.
+   uint32_t m_high_water;
+};
+
+#endif
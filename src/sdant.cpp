@@ -49,10 +49,14 @@ SOFTWARE.
 #ifndef CFG_ANT_TASK_STACKSIZE
 #define CFG_ANT_TASK_STACKSIZE (256 * 5)
 #endif
+#ifndef CFG_ANT_WORKER_TASK_STACKSIZE
+#define CFG_ANT_WORKER_TASK_STACKSIZE (256 * 4)
+#endif
 
 SdAnt ANTplus;
 
 void adafruit_ant_task(void *arg);
+void adafruit_ant_worker_task(void *arg);
 
 #if CFG_DEBUG
 static void nrf_error_cb(uint32_t id, uint32_t pc, uint32_t info)
@@ -83,7 +87,13 @@ static void nrf_error_cb(uint32_t id, uint32_t pc, uint32_t info)
 SdAnt::SdAnt(void)
 {
   _ant_event_sem = NULL;
+  _ant_worker_sem = NULL;
   _ant_event_cb = NULL;
+  m_profile_count = 0;
+  m_tx_events = 0;
+  m_tx_max_us = 0;
+  m_deferred_last_latency_us = 0;
+  m_deferred_max_latency_us = 0;
 }
 
 bool SdAnt::begin(uint8_t ant_count)
@@ -129,16 +139,20 @@ bool SdAnt::begin(uint8_t ant_count)
   //    sd_ant_network_address_set(0, m_ant_fs_network_key);
   // #endif
 
-  uint8_t channel = 0;
-  // do setup of registered profiles
-  for (ANTProfileEntry *entry = m_profile_list.m_head; entry != NULL; entry = entry->m_next)
+  // do setup of registered profiles, the table index is the channel number
+  for (uint8_t channel = 0; channel < m_profile_count; channel++)
   {
-    entry->m_entry->Setup(channel);
-    channel++;
+    m_profiles[channel]->Setup(channel);
   }
   // Create RTOS Semaphore & Task for ANT Event
   _ant_event_sem = xSemaphoreCreateBinary();
   if (_ant_event_sem == NULL) return false;
+  _ant_worker_sem = xSemaphoreCreateBinary();
+  if (_ant_worker_sem == NULL) return false;
+
+  // The worker only runs once the ANT task has nothing left to broadcast
+  TaskHandle_t ant_worker_hdl;
+  xTaskCreate(adafruit_ant_worker_task, "ANTW", CFG_ANT_WORKER_TASK_STACKSIZE, NULL, TASK_PRIO_LOW, &ant_worker_hdl);
 
   TaskHandle_t ant_task_hdl;
   xTaskCreate(adafruit_ant_task, "ANT", CFG_ANT_TASK_STACKSIZE, NULL, TASK_PRIO_HIGH, &ant_task_hdl);
@@ -174,23 +188,93 @@ void adafruit_ant_task(void *arg)
         if (ret == NRF_SUCCESS)
           ANTplus._ant_handler(ant_evt);
       }
+      if (!ANTplus.m_deferred.IsEmpty())
+        xSemaphoreGive(ANTplus._ant_worker_sem);
+    }
+  }
+}
+
+/*------------------------------------------------------------------*/
+/* ANT worker: everything that may print or wait
+ *------------------------------------------------------------------*/
+void adafruit_ant_worker_task(void *arg)
+{
+  (void)arg;
+
+  while (1)
+  {
+    if (xSemaphoreTake(ANTplus._ant_worker_sem, portMAX_DELAY))
+    {
+      while (ANTplus.ProcessDeferredEvents() > 0)
+      {
+      }
     }
   }
 }
 
 /**
- * ANT event handler
+ * ANT event handler. Serves EVENT_TX right away and queues the rest for
+ * the worker, so a slow listener never delays the next broadcast frame.
  * @param evt event
  */
 void SdAnt::_ant_handler(ant_evt_t *evt)
 {
-  for (ANTProfileEntry *entry = m_profile_list.m_head; entry != NULL; entry = entry->m_next)
+  ANTProfile *profile = getAntProfileByChNum(evt->channel);
+  if (profile == NULL)
+    return;
+
+  uint32_t start_us = micros();
+  if (profile->ProcessTimeCritical(evt))
+  {
+    if (evt->event == EVENT_TX)
+    {
+      uint32_t elapsed_us = micros() - start_us;
+      m_tx_events++;
+      if (elapsed_us > m_tx_max_us) m_tx_max_us = elapsed_us;
+    }
+    return;
+  }
+
+  sdant_deferred_evt_t item;
+  item.evt = *evt;
+  item.queued_us = start_us;
+  m_deferred.Push(item);   // a full queue counts the drop
+}
+
+uint32_t SdAnt::ProcessDeferredEvents(uint32_t max_events)
+{
+  uint32_t count = 0;
+  sdant_deferred_evt_t item;
+  while (count < max_events && m_deferred.Pop(item))
   {
-    entry->m_entry->ProcessMessage(evt);
+    uint32_t latency_us = micros() - item.queued_us;
+    m_deferred_last_latency_us = latency_us;
+    if (latency_us > m_deferred_max_latency_us) m_deferred_max_latency_us = latency_us;
+
+    ANTProfile *profile = getAntProfileByChNum(item.evt.channel);
+    if (profile != NULL)
+      profile->ProcessDeferred(&item.evt);
+    count++;
   }
+  return count;
 }
 
-void SdAnt::AddProfile(ANTProfile *p)
+void SdAnt::GetDispatchStats(sdant_dispatch_stats_t *stats)
 {
-  m_profile_list.AddProfile(p);
+  stats->tx_events = m_tx_events;
+  stats->tx_max_us = m_tx_max_us;
+  stats->deferred_dropped = m_deferred.GetOverflowCount();
+  stats->queue_depth = m_deferred.Size();
+  stats->deferred_events = m_deferred.GetPushCount();
+  stats->queue_high_water = m_deferred.GetHighWater();
+  stats->deferred_last_latency_us = m_deferred_last_latency_us;
+  stats->deferred_max_latency_us = m_deferred_max_latency_us;
+}
+
+bool SdAnt::AddProfile(ANTProfile *p)
+{
+  if (p == NULL || m_profile_count >= SDANT_MAX_CHANNELS)
+    return false;
+  m_profiles[m_profile_count++] = p;
+  return true;
 }
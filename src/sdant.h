@@ -49,6 +49,34 @@ SOFTWARE.
 
 #include <bluefruit.h>
 #include "ANTProfile.h"
+#include "SpscRing.h"
+
+#ifndef SDANT_MAX_CHANNELS
+#define SDANT_MAX_CHANNELS 8    ///< Capacity of the profile table; profile i runs on channel i.
+#endif
+#ifndef SDANT_DEFERRED_QUEUE_SIZE
+#define SDANT_DEFERRED_QUEUE_SIZE 16    ///< Events waiting for the ANT worker task, must be a power of two.
+#endif
+
+/**@brief An event the ANT task handed to the worker, with its hand-over time. */
+typedef struct
+{
+   ant_evt_t evt;
+   uint32_t  queued_us;                 ///< micros() when the ANT task queued it.
+} sdant_deferred_evt_t;
+
+/**@brief Counters of the split ANT event dispatch, see SdAnt::GetDispatchStats(). */
+typedef struct
+{
+   uint32_t tx_events;                  ///< EVENT_TX served directly in the ANT task.
+   uint32_t tx_max_us;                  ///< Longest EVENT_TX service time.
+   uint32_t deferred_events;            ///< Events queued for the worker.
+   uint32_t deferred_dropped;           ///< Events lost because the queue was full.
+   uint32_t queue_depth;                ///< Events queued right now.
+   uint32_t queue_high_water;
+   uint32_t deferred_last_latency_us;   ///< Queue-to-service delay of the last worker event.
+   uint32_t deferred_max_latency_us;
+} sdant_dispatch_stats_t;
 
 //NOTE ANT network key settings moved to "ant/ANTProfile.h"
 //#ifndef ANT_PLUS_NETWORK_KEY
@@ -73,26 +101,41 @@ class SdAnt
      *------------------------------------------------------------------*/
     void setANTEventCallback( void (*fp) (ant_evt_t*) );
 
-   void AddProfile(ANTProfile* p);
+   /**@brief Registers a profile; it gets the next channel number in begin().
+    * @return false if the table already holds SDANT_MAX_CHANNELS profiles.
+    */
+   bool AddProfile(ANTProfile* p);
    ANTProfile* getAntProfileByChNum(uint8_t ch) {
-      for (ANTProfileEntry* entry = m_profile_list.m_head; entry != NULL; entry = entry->m_next)
-      {
-         if (entry->m_entry->getChannelNumber() == ch)  return entry->m_entry;
-      }
-      return NULL;
+      return ch < m_profile_count ? m_profiles[ch] : NULL;
    }
+   uint8_t getProfileCount(void) { return m_profile_count; }
+
+   /**@brief Serves up to max_events queued events in the calling context.
+    *        The worker task does this on target; the host calls it directly.
+    * @return Number of events served.
+    */
+   uint32_t ProcessDeferredEvents(uint32_t max_events = SDANT_DEFERRED_QUEUE_SIZE);
+   void GetDispatchStats(sdant_dispatch_stats_t* stats);
 
   private:
     /*------------- SoftDevice Configuration -------------*/
 
     // This semaphore is moved to Bluefruit, see https://github.com/adafruit/Adafruit_nRF52_Arduino/pull/501
     SemaphoreHandle_t _ant_event_sem;
+    SemaphoreHandle_t _ant_worker_sem;
     void (*_ant_event_cb) (ant_evt_t*);
 
    uint8_t m_ant_plus_network_key[8];
    uint8_t m_ant_fs_network_key[8];
 
-   ANTProfileList m_profile_list;
+   ANTProfile* m_profiles[SDANT_MAX_CHANNELS];   ///< Indexed by channel number.
+   uint8_t m_profile_count;
+   // EVENT_TX is served in the ANT task, everything else waits here.
+   SpscRing<sdant_deferred_evt_t, SDANT_DEFERRED_QUEUE_SIZE> m_deferred;
+   uint32_t m_tx_events;               ///< Written by the ANT task.
+   uint32_t m_tx_max_us;
+   uint32_t m_deferred_last_latency_us; ///< Written by the worker.
+   uint32_t m_deferred_max_latency_us;
    // Memory buffer provided in order to support channel configuration.
    __ALIGN(4) uint8_t* m_ant_stack_buffer;
 
@@ -102,6 +145,7 @@ class SdAnt
     void _ant_handler(ant_evt_t* evt);
     friend void SD_EVT_IRQHandler(void);
     friend void adafruit_ant_task(void* arg);
+    friend void adafruit_ant_worker_task(void* arg);
 };
 
 extern SdAnt ANTplus;